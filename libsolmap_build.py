@@ -0,0 +1,26 @@
+#!/usr/bin/env python3
+
+from cffi import FFI
+ffibuilder = FFI()
+
+# The declarations of the C interface, without the preprocessor
+# lines and the C++ guards.
+with open('src-host/solmap.h') as f:
+    cdef = []
+    in_guard = False
+    for line in f:
+        if line.startswith('#ifdef __cplusplus'):
+            in_guard = True
+        elif line.startswith('#endif') and in_guard:
+            in_guard = False
+        elif not in_guard and not line.startswith('#'):
+            cdef.append(line)
+    ffibuilder.cdef(''.join(cdef))
+
+ffibuilder.set_source("solmap_ffi", r"""
+    #include "solmap.h"
+    """,
+    libraries=['solmap'], library_dirs=['build'], include_dirs=['src-host'])
+
+if __name__ == "__main__":
+    ffibuilder.emit_c_code("build/solmap_ffi.c")
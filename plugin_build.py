@@ -37,7 +37,7 @@ ffibuilder.embedding_init_code("""
     @ffi.def_extern()
     def next_pos_over_year(iter, ret):
         try:
-            ret.coefficient, ret.pos.az, ret.pos.alt, ret.direct_power, ret.indirect_power = next(ffi.from_handle(iter))
+            ret.coefficient, ret.pos.az, ret.pos.alt, ret.direct_power, ret.indirect_power, ret.month, ret.hour = next(ffi.from_handle(iter))
             return True
         except StopIteration:
             return False
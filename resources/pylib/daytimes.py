@@ -139,6 +139,12 @@ def daytimes_over_range(altitude_func, longitude, ref_start, num_days):
         daytime = (daytime_start, daytime_finish) if daytime_start else None
         yield day_start, lowest, daytime
 
+# Hour of the year of the given time, in UTC, clamped to the year,
+# as the first and last days may start and end outside it.
+def hour_of_year(time):
+    hour = int((time - ref_start).total_seconds() // 3600)
+    return min(max(hour, 0), 8759)
+
 def sun_pos(obs, time):
     obs.date = time.strftime('%Y/%m/%d %H:%M:%S')
     v = ephem.Sun(obs)
@@ -166,9 +172,8 @@ def quantize_year(latitude, longitude, elevation, max_dt):
         if not daytime:
             pass
 
-        direct_power, indirect_power = incidence_calculator(
-            first_day + datetime.timedelta(days=i)
-        )
+        date = first_day + datetime.timedelta(days=i)
+        direct_power, indirect_power = incidence_calculator(date)
 
         delta = (daytime[1] - daytime[0]).total_seconds()
         n = max(2, int(math.ceil(delta / max_dt)))
@@ -179,19 +184,20 @@ def quantize_year(latitude, longitude, elevation, max_dt):
         az, alt = sun_pos(obs, daytime[0])
 
         # Coefficient for the first term of trapezoidal rule: dt/2
-        yield (dt*0.5, az, alt, direct_power, indirect_power)
+        yield (dt*0.5, az, alt, direct_power, indirect_power, date.month,
+            hour_of_year(daytime[0]))
 
         # Middle terms for trapezoidal rule:
         for i in range(1, n):
-            az, alt = sun_pos(
-                obs,
-                daytime[0] + datetime.timedelta(seconds=i*dt)
-            )
-            yield (dt, az, alt, direct_power, indirect_power)
+            time = daytime[0] + datetime.timedelta(seconds=i*dt)
+            az, alt = sun_pos(obs, time)
+            yield (dt, az, alt, direct_power, indirect_power, date.month,
+                hour_of_year(time))
 
         # Last term for trapezoidal rule (it uses n+1 points for n chunks):
         az, alt = sun_pos(obs, daytime[1])
-        yield (dt*0.5, az, alt, direct_power, indirect_power)
+        yield (dt*0.5, az, alt, direct_power, indirect_power, date.month,
+            hour_of_year(daytime[1]))
 
 if __name__ == '__main__':
     import sys
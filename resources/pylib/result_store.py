@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+
+# Reader of the columnar result file written by solmap's --store option,
+# whose layout is described in src-host/result_store.hpp. Columns are
+# mapped into numpy arrays without copying.
+
+import json
+import mmap
+import struct
+import numpy as np
+
+MAGIC = b'SOLMAPRS'
+VERSION = 1
+
+HEADER = struct.Struct('<8sIIQQ')
+ENTRY = struct.Struct('<32sIIQQ')
+
+DTYPES = {
+    0: np.dtype('<f4'),
+    1: np.dtype('<u4'),
+    2: np.dtype('<f8'),
+    3: np.dtype('<i4'),
+}
+
+class ResultStore:
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        magic, version, num_columns, meta_offset, meta_size = \
+            HEADER.unpack_from(self.map, 0)
+        if magic != MAGIC:
+            raise ValueError('Not a solmap result file.')
+        if version != VERSION:
+            raise ValueError('Unsupported result file version {}.'.format(version))
+
+        self.metadata = json.loads(
+            self.map[meta_offset:meta_offset + meta_size].decode('utf-8')
+        )
+
+        self.columns = {}
+        for i in range(num_columns):
+            name, dtype, components, rows, offset = ENTRY.unpack_from(
+                self.map, HEADER.size + i * ENTRY.size
+            )
+            name = name.rstrip(b'\0').decode('utf-8')
+
+            shape = (rows, components) if components > 1 else (rows,)
+            self.columns[name] = np.frombuffer(
+                self.map, dtype=DTYPES[dtype], count=rows * components,
+                offset=offset
+            ).reshape(shape)
+
+    def __getitem__(self, name):
+        return self.columns[name]
+
+    def __contains__(self, name):
+        return name in self.columns
+
+    def keys(self):
+        return self.columns.keys()
+
+def open_store(filename):
+    return ResultStore(filename)
+
+if __name__ == '__main__':
+    import sys
+    store = open_store(sys.argv[1])
+    print(json.dumps(store.metadata, indent=2))
+    for name, col in store.columns.items():
+        print('{}: {} {}'.format(name, col.dtype, col.shape))
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+
+# Bindings of libsolmap, whose C interface is described in src-host/solmap.h,
+# built by libsolmap_build.py. Arrays are passed to and from the library
+# as numpy arrays, without copies, as long as they are contiguous and of
+# the expected type.
+
+import os
+import sys
+import numpy as np
+
+sys.path.append(os.path.join(
+    os.path.dirname(os.path.realpath(__file__)), '..', '..', 'build'
+))
+
+from solmap_ffi import ffi, lib
+
+def _pointer(ctype, array):
+    return ffi.from_buffer(ctype + '[]', array)
+
+def _contiguous(array, dtype):
+    return np.ascontiguousarray(array, dtype=dtype)
+
+class Solmap:
+    def __init__(self):
+        self.handle = lib.solmap_create()
+        if self.handle == ffi.NULL:
+            raise RuntimeError('Could not initialize Vulkan.')
+        self.num_vertices = 0
+
+    def close(self):
+        if self.handle is not None:
+            lib.solmap_destroy(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def _check(self, ret):
+        if ret != 0:
+            raise RuntimeError(
+                ffi.string(lib.solmap_last_error(self.handle)).decode('utf-8')
+            )
+
+    def set_mesh(self, positions, normals, triangles):
+        """Positions and normals are arrays of shape (n, 3), in meters,
+        with +y up, -z north and +x east. Triangles has shape (m, 3)."""
+        positions = _contiguous(positions, np.float32)
+        normals = _contiguous(normals, np.float32)
+        triangles = _contiguous(triangles, np.uint32)
+        if positions.shape != normals.shape or positions.shape[-1] != 3:
+            raise ValueError('Positions and normals must have shape (n, 3).')
+
+        self._check(lib.solmap_set_mesh(self.handle,
+            len(positions), _pointer('float', positions),
+            _pointer('float', normals),
+            triangles.size, _pointer('uint32_t', triangles)
+        ))
+        self.num_vertices = len(positions)
+
+    def set_site(self, latitude, longitude):
+        self._check(lib.solmap_set_site(self.handle, latitude, longitude))
+
+    def run(self):
+        self._check(lib.solmap_run(self.handle))
+
+    def incidence(self, out=None):
+        """Yearly incidence of each vertex, in kWh/m²."""
+        if out is None:
+            out = np.empty(self.num_vertices, dtype=np.float32)
+        self._check_out(out, (self.num_vertices,))
+        self._check(lib.solmap_get_incidence(self.handle,
+            _pointer('float', out)))
+        return out
+
+    def directional(self, out=None):
+        """Lit direct energy vector of each vertex, and its projection on
+        the vertex normal, in kWh/m², as an array of shape (n, 4)."""
+        if out is None:
+            out = np.empty((self.num_vertices, 4), dtype=np.float32)
+        self._check_out(out, (self.num_vertices, 4))
+        self._check(lib.solmap_get_directional(self.handle,
+            _pointer('float', out)))
+        return out
+
+    def totals(self):
+        """Diffuse and direct yearly energy of an unobstructed point."""
+        diffuse = ffi.new('double *')
+        direct = ffi.new('double *')
+        self._check(lib.solmap_get_totals(self.handle, diffuse, direct))
+        return diffuse[0], direct[0]
+
+    @staticmethod
+    def _check_out(out, shape):
+        if out.shape != shape or out.dtype != np.float32 \
+                or not out.flags['C_CONTIGUOUS']:
+            raise ValueError('Output must be a contiguous float32 array '
+                'of shape {}.'.format(shape))
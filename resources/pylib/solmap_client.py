@@ -0,0 +1,45 @@
+#!/usr/bin/env python3
+
+# Client of solmap's --daemon mode, whose protocol is described in
+# src-host/daemon.hpp. Jobs take the same arguments as solmap itself,
+# and relative paths are taken from the current directory.
+
+import os
+import socket
+import sys
+
+def submit(socket_path, args, out=None):
+    """Runs a job on the daemon, writing its output to out as it comes,
+    if given, and returns the exit status and the whole output."""
+    request = b''.join(
+        s.encode('utf-8') + b'\0' for s in [os.getcwd()] + list(args)
+    )
+
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(socket_path)
+        sock.sendall(request)
+        sock.shutdown(socket.SHUT_WR)
+
+        output = b''
+        while True:
+            data = sock.recv(4096)
+            if not data:
+                break
+            output += data
+            if out is not None:
+                out.write(data.decode('utf-8', 'replace'))
+                out.flush()
+
+    text = output.decode('utf-8', 'replace')
+    body, _, last = text.rstrip('\n').rpartition('\n')
+    if not last.startswith('exit '):
+        raise ConnectionError('Job was interrupted.')
+    return int(last[5:]), body
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print('Usage: {} socket [solmap arguments...]'.format(sys.argv[0]))
+        sys.exit(1)
+
+    status, _ = submit(sys.argv[1], sys.argv[2:], sys.stdout)
+    sys.exit(status)
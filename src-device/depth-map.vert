@@ -6,20 +6,48 @@ layout(binding = 0) uniform InputData
 	// This orientation is given as a normalized quaternion,
 	// where the scalar component is w.
 	vec4 to_sun_rotation;
+
+	// See incidence-calc.comp.
+	vec3 dir_energy;
+
+	// Unit vector pointing to the sun, for the trackers.
 	vec3 sun_direction;
+
+	// From 0 to 11, for the vegetation.
+	uint month;
 };
 
 layout(location = 0) in vec3 inPosition;
 
+// Transform of the instance:
+layout(location = 2) in vec4 inTransform0;
+layout(location = 3) in vec4 inTransform1;
+layout(location = 4) in vec4 inTransform2;
+
+// Tracker group of the instance, see tracker.glsl:
+layout(location = 8) in uint inTracker;
+
+// Vegetation group of the instance, for opacity-map.frag:
+layout(location = 9) in uint inVegetation;
+layout(location = 0) flat out uint vegetation;
+
 out gl_PerVertex {
 	vec4 gl_Position;
 };
 
 #include "quaternion.glsl"
+#include "transform.glsl"
+#include "tracker.glsl"
 
 void main()
 {
-	vec3 pos = quat_rot_vec(to_sun_rotation, inPosition);
+	vegetation = inVegetation;
+
+	vec3 pos = quat_rot_vec(to_sun_rotation, track_point(
+		tracker_rotation(inTracker, sun_direction),
+		inTransform0, inTransform1, inTransform2,
+		transform_point(inTransform0, inTransform1, inTransform2,
+			inPosition)));
 
 	// For some silly reason, Vulkan decided to support D3D,
 	// cliping range [0, 1], instead of the naturally
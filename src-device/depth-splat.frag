@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) flat in vec3 viewNormal;
+layout(location = 1) flat in float centerDepth;
+layout(location = 2) flat in float spriteHalfSize;
+layout(location = 3) flat in float radius;
+
+void main()
+{
+	// Offset from the splat center, in view space. Both gl_PointCoord
+	// and view space y grows downwards in the framebuffer.
+	vec2 d = (gl_PointCoord * 2.0 - 1.0) * spriteHalfSize;
+
+	// Depth offset to the plane of the splat. Limit the slope,
+	// so splats seen edge-on don't blow up.
+	float nz = viewNormal.z >= 0.0
+		? max(viewNormal.z, 1e-3)
+		: min(viewNormal.z, -1e-3);
+	float dz = -dot(viewNormal.xy, d) / nz;
+
+	// Cut the disk out of the sprite.
+	if(dot(d, d) + dz * dz > radius * radius) {
+		discard;
+	}
+
+	gl_FragDepth = (centerDepth + dz) * 0.5 + 0.5;
+}
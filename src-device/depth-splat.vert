@@ -0,0 +1,89 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Variant of depth-map.vert for point clouds: each point
+// is drawn as a point sprite covering its splat, which is
+// then shaped into an oriented disk by depth-splat.frag.
+
+// Width and height of the depth map, in pixels.
+layout(constant_id = 0) const float FRAME_SIZE = 2048.0;
+
+// Largest point size supported by the device.
+layout(constant_id = 1) const float MAX_POINT_SIZE = 64.0;
+
+layout(binding = 0) uniform InputData
+{
+	// This orientation is given as a normalized quaternion,
+	// where the scalar component is w.
+	vec4 to_sun_rotation;
+
+	// See incidence-calc.comp.
+	vec3 dir_energy;
+
+	// Unit vector pointing to the sun, for the trackers.
+	vec3 sun_direction;
+
+	// From 0 to 11, for the vegetation.
+	uint month;
+};
+
+// Splat radius is given in w.
+layout(location = 0) in vec4 inPositionRadius;
+layout(location = 1) in vec3 inNormal;
+
+// Transform of the instance, and of its normals:
+layout(location = 2) in vec4 inTransform0;
+layout(location = 3) in vec4 inTransform1;
+layout(location = 4) in vec4 inTransform2;
+layout(location = 5) in vec4 inNormalTransform0;
+layout(location = 6) in vec4 inNormalTransform1;
+layout(location = 7) in vec4 inNormalTransform2;
+
+// Tracker group of the instance, see tracker.glsl:
+layout(location = 8) in uint inTracker;
+
+layout(location = 0) flat out vec3 viewNormal;
+layout(location = 1) flat out float centerDepth;
+layout(location = 2) flat out float spriteHalfSize;
+layout(location = 3) flat out float radius;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+	float gl_PointSize;
+};
+
+#include "quaternion.glsl"
+#include "transform.glsl"
+#include "tracker.glsl"
+
+void main()
+{
+	const mat3 tracking = tracker_rotation(inTracker, sun_direction);
+
+	vec3 pos = quat_rot_vec(to_sun_rotation, track_point(tracking,
+		inTransform0, inTransform1, inTransform2,
+		transform_point(inTransform0, inTransform1, inTransform2,
+			inPositionRadius.xyz)));
+	viewNormal = quat_rot_vec(to_sun_rotation, normalize(tracking
+		* transform_normal(inNormalTransform0, inNormalTransform1,
+			inNormalTransform2, inNormal)));
+	centerDepth = pos.z;
+
+	// Splats scale with the instance, assuming the scale is uniform.
+	float world_radius = inPositionRadius.w * length(vec3(
+		inTransform0.x, inTransform1.x, inTransform2.x));
+
+	// The frame spans 2 units in view space, so the disk diameter in
+	// pixels is radius * FRAME_SIZE. The sprite must also cover the
+	// pixel centers around it, thus the extra pixel.
+	float size = clamp(world_radius * FRAME_SIZE + 1.0,
+		1.0, MAX_POINT_SIZE);
+	gl_PointSize = size;
+	spriteHalfSize = size / FRAME_SIZE;
+
+	// If the sprite was clamped, shrink the disk along with it.
+	radius = min(world_radius, spriteHalfSize);
+
+	// See depth-map.vert for the depth transformation.
+	gl_Position = vec4(pos.xy, pos.z * 0.5 + 0.5, 1.0);
+}
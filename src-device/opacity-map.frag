@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Draws the vegetation into the opacity map, with additive blending
+// on rgb and min blending on alpha. Each pixel ends up with the total
+// optical depth in r, the optical depth weighted sum of the depths in
+// g, and the depth of the nearest vegetation in a. That is enough for
+// the compute shader to estimate how much of the vegetation is in front
+// of a point, in the same render pass as the depth map.
+
+layout(binding = 0) uniform InputData
+{
+	vec4 to_sun_rotation;
+	vec3 dir_energy;
+	vec3 sun_direction;
+
+	// From 0 to 11.
+	uint month;
+};
+
+// Optical depth of each crossed surface of the crown, for each month.
+struct VegetationGroup
+{
+	float optical_depth[12];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Vegetation
+{
+	VegetationGroup vegetation_group[];
+};
+
+// 1-based vegetation group.
+layout(location = 0) flat in uint vegetation;
+
+layout(location = 0) out vec4 outOpacity;
+
+void main()
+{
+	const float tau = vegetation_group[vegetation - 1].optical_depth[month];
+	const float depth = gl_FragCoord.z;
+
+	outOpacity = vec4(tau, tau * depth, 0.0, depth);
+}
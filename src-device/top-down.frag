@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Point clouds are drawn as sprites, cut into disks.
+layout(constant_id = 0) const bool POINT_CLOUD = false;
+
+layout(location = 0) in float value;
+layout(location = 1) flat in float spriteHalfSize;
+layout(location = 2) flat in float radius;
+
+layout(location = 0) out float outValue;
+
+void main()
+{
+	if(POINT_CLOUD) {
+		// Offset from the splat center, in model units.
+		vec2 d = (gl_PointCoord * 2.0 - 1.0) * spriteHalfSize;
+		if(dot(d, d) > radius * radius) {
+			discard;
+		}
+	}
+
+	outValue = value;
+}
@@ -0,0 +1,58 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Draws the model seen from above, orthographically, carrying
+// the value of each vertex, for the raster export. The highest
+// surface is the nearest, so it is the one kept in each cell.
+// For point clouds, each point is a sprite covering its splat,
+// which is cut into a horizontal disk by top-down.frag.
+
+// Largest point size supported by the device.
+layout(constant_id = 0) const float MAX_POINT_SIZE = 64.0;
+
+// Part of the raster drawn, in the output model frame.
+layout(push_constant) uniform Tile
+{
+	// x and z of the north west corner, and the size
+	// of the tile along them.
+	vec2 corner;
+	vec2 size;
+
+	// Height of the highest point, and the depth per height unit.
+	float top;
+	float depth_scale;
+
+	// Side of the square cell.
+	float cell_size;
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in float inValue;
+layout(location = 2) in float inRadius;
+
+layout(location = 0) out float value;
+layout(location = 1) flat out float spriteHalfSize;
+layout(location = 2) flat out float radius;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+	float gl_PointSize;
+};
+
+void main()
+{
+	value = inValue;
+
+	// Both framebuffer y and model z grow southwards,
+	// so the first row of the tile is the northernmost.
+	vec2 ndc = (inPosition.xz - corner) / size * 2.0 - 1.0;
+	gl_Position = vec4(ndc, (top - inPosition.y) * depth_scale, 1.0);
+
+	// As in depth-splat.vert, the sprite has an extra
+	// pixel to cover the cell centers around the disk.
+	float sprite = clamp(2.0 * inRadius / cell_size + 1.0,
+		1.0, MAX_POINT_SIZE);
+	gl_PointSize = sprite;
+	spriteHalfSize = 0.5 * sprite * cell_size;
+	radius = min(inRadius, spriteHalfSize);
+}
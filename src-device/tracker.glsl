@@ -0,0 +1,86 @@
+// Sun tracking groups, see tracker.hpp.
+// Instances in a group are rotated around their origin.
+
+const uint SINGLE_AXIS = 0;
+const uint DUAL_AXIS = 1;
+
+struct TrackerGroup
+{
+	// Rotation axis in xyz, maximum rotation in w.
+	vec4 axis_max_angle;
+
+	// Normal at rest in xyz, ground coverage ratio in w.
+	vec4 rest_normal_gcr;
+
+	uint type;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Trackers
+{
+	TrackerGroup tracker_group[];
+};
+
+mat3 axis_angle_rotation(vec3 k, float angle)
+{
+	float c = cos(angle);
+	float s = sin(angle);
+
+	// Rodrigues' formula, with the cross product matrix of k:
+	mat3 cross_k = mat3(
+		0.0, k.z, -k.y,
+		-k.z, 0.0, k.x,
+		k.y, -k.x, 0.0
+	);
+	return c * mat3(1.0) + s * cross_k + (1.0 - c) * outerProduct(k, k);
+}
+
+// Rotation of the trackers in a group, for the given sun direction.
+// Group is 1-based, 0 means the instance is fixed.
+mat3 tracker_rotation(uint group, vec3 sun)
+{
+	if(group == 0) {
+		return mat3(1.0);
+	}
+
+	const TrackerGroup g = tracker_group[group - 1];
+	const vec3 rest = g.rest_normal_gcr.xyz;
+	const float max_angle = g.axis_max_angle.w;
+
+	if(g.type == DUAL_AXIS) {
+		vec3 k = cross(rest, sun);
+		float len = length(k);
+		if(len < 1e-6) {
+			return mat3(1.0);
+		}
+
+		float angle = min(acos(clamp(dot(rest, sun), -1.0, 1.0)),
+			max_angle);
+		return axis_angle_rotation(k / len, angle);
+	}
+
+	// Single axis: the ideal angle makes the normal point to the
+	// projection of the sun on the plane perpendicular to the axis.
+	const vec3 axis = g.axis_max_angle.xyz;
+	float ideal = atan(dot(sun, cross(axis, rest)), dot(sun, rest));
+	float angle = ideal;
+
+	// Backtracking, as in pvlib's singleaxis(), for horizontal
+	// ground: rotate back just enough to avoid row-to-row shading.
+	const float gcr = g.rest_normal_gcr.w;
+	if(gcr > 0.0) {
+		float temp = abs(cos(ideal)) / gcr;
+		if(temp < 1.0) {
+			angle = ideal - sign(ideal) * acos(temp);
+		}
+	}
+
+	return axis_angle_rotation(axis, clamp(angle, -max_angle, max_angle));
+}
+
+// Rotates a point placed by the instance around the instance origin,
+// given by the translation column of the instance transform.
+vec3 track_point(mat3 rotation, vec4 row0, vec4 row1, vec4 row2, vec3 p)
+{
+	vec3 pivot = vec3(row0.w, row1.w, row2.w);
+	return pivot + rotation * (p - pivot);
+}
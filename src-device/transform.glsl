@@ -0,0 +1,13 @@
+// Affine transforms of instances are given by the first three rows
+// of their matrices, and so are the matrices that transform normals.
+
+vec3 transform_point(vec4 row0, vec4 row1, vec4 row2, vec3 p)
+{
+	vec4 h = vec4(p, 1.0);
+	return vec3(dot(row0, h), dot(row1, h), dot(row2, h));
+}
+
+vec3 transform_normal(vec4 row0, vec4 row1, vec4 row2, vec3 n)
+{
+	return vec3(dot(row0.xyz, n), dot(row1.xyz, n), dot(row2.xyz, n));
+}
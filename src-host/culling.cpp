@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+
+namespace {
+
+struct CubeCell
+{
+	unsigned face;
+	unsigned i, j;
+};
+
+// Face is the major axis times 2, plus 1 if negative.
+template<unsigned RES>
+CubeCell cube_cell(const Vec3& d)
+{
+	const Vec3 a = glm::abs(d);
+	const unsigned axis = (a.x >= a.y && a.x >= a.z) ? 0
+		: (a.y >= a.z ? 1 : 2);
+
+	const real inv = 1.0 / a[axis];
+	const real u = d[(axis + 1) % 3] * inv;
+	const real v = d[(axis + 2) % 3] * inv;
+
+	auto to_idx = [](real c) {
+		return std::min(RES - 1,
+			unsigned(std::max(0.0, (c + 1.0) * 0.5 * RES)));
+	};
+
+	return {axis * 2 + (d[axis] < 0.0), to_idx(u), to_idx(v)};
+}
+
+// Direction at the given cube face coordinates, in [-1, 1].
+Vec3 cube_dir(unsigned face, real u, real v)
+{
+	const unsigned axis = face / 2;
+
+	Vec3 ret;
+	ret[axis] = (face % 2) ? -1.0 : 1.0;
+	ret[(axis + 1) % 3] = u;
+	ret[(axis + 2) % 3] = v;
+
+	return glm::normalize(ret);
+}
+
+// Bounding cone of some directions.
+struct Cone
+{
+	Vec3 axis;
+
+	// Half angle, in radians.
+	real angle;
+};
+
+// Bounding cone of a cube map cell. The farthest
+// points from the center are at the corners.
+template<unsigned RES>
+Cone cell_cone(unsigned face, unsigned i, unsigned j)
+{
+	const real step = 2.0 / RES;
+	const real u = -1.0 + i * step;
+	const real v = -1.0 + j * step;
+
+	Cone ret{cube_dir(face, u + 0.5 * step, v + 0.5 * step), 0.0};
+	for(uint8_t k = 0; k < 4; ++k) {
+		const Vec3 corner = cube_dir(face,
+			u + (k & 1) * step, v + (k >> 1) * step);
+		ret.angle = std::max(ret.angle, real(std::acos(std::clamp(
+			real(glm::dot(ret.axis, corner)),
+			real(-1.0), real(1.0)))));
+	}
+
+	return ret;
+}
+
+template<unsigned RES>
+size_t cell_index(const CubeCell& c)
+{
+	return (c.face * RES + c.i) * RES + c.j;
+}
+
+}
+
+SunCone::SunCone(const std::vector<Vec3>& suns)
+{
+	// Group the sun directions in bins, and find
+	// the cone bounding the directions of each bin.
+	std::vector<Vec3> sum(6 * RES * RES, Vec3{0.0, 0.0, 0.0});
+	for(const Vec3& s: suns) {
+		sum[cell_index<RES>(cube_cell<RES>(s))] += s;
+	}
+
+	std::vector<Cone> sun_cones;
+	std::vector<size_t> bin_to_cone(sum.size());
+	for(size_t i = 0; i < sum.size(); ++i) {
+		const real len = glm::length(sum[i]);
+		if(len > 0.0) {
+			bin_to_cone[i] = sun_cones.size();
+			sun_cones.push_back({sum[i] / float(len), 0.0});
+		}
+	}
+
+	for(const Vec3& s: suns) {
+		Cone& c = sun_cones[
+			bin_to_cone[cell_index<RES>(cube_cell<RES>(s))]];
+		c.angle = std::max(c.angle, real(std::acos(std::clamp(
+			real(glm::dot(c.axis, s)), real(-1.0), real(1.0)))));
+	}
+
+	// A normal bin may face the sun if any of its normals is less than
+	// 90° apart from any sun direction. Being conservative, this is
+	// true if the cones of the bins are less than 90° apart.
+	facing.resize(6 * RES * RES, false);
+	for(unsigned f = 0; f < 6; ++f) {
+		for(unsigned i = 0; i < RES; ++i) {
+			for(unsigned j = 0; j < RES; ++j) {
+				const Cone n = cell_cone<RES>(f, i, j);
+				for(const Cone& s: sun_cones) {
+					const real slack = std::min(
+						real(M_PI * 0.5),
+						n.angle + s.angle);
+					if(glm::dot(n.axis, s.axis)
+						> -std::sin(slack))
+					{
+						facing[cell_index<RES>(
+							{f, i, j})] = true;
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+bool SunCone::may_face(const Vec3& normal) const
+{
+	// Without a direction, we can't tell.
+	if(glm::dot(normal, normal) == 0.0) {
+		return true;
+	}
+
+	return facing[cell_index<RES>(cube_cell<RES>(normal))];
+}
+
+ReceiverSelection select_receivers(const Scene& scene, real scale,
+	const Vec3& unit_up, const RegionOfInterest& roi, const SunCone& cone)
+{
+	auto selected_name = [&](const std::string& name) {
+		return std::find(roi.submeshes.begin(), roi.submeshes.end(),
+			name) != roi.submeshes.end();
+	};
+
+	const real cos_min_tilt = std::cos(roi.min_tilt * M_PI / 180.0);
+	const real cos_max_tilt = std::cos(roi.max_tilt * M_PI / 180.0);
+
+	const Mesh& geom = scene.geometry;
+
+	ReceiverSelection ret;
+	uint32_t flat_idx = 0;
+	for(uint32_t inst_idx = 0; inst_idx < scene.instances.size();
+		++inst_idx)
+	{
+		const auto& inst = scene.instances[inst_idx];
+		const auto& sm = geom.submeshes[inst.submesh];
+
+		const bool in_submesh = roi.submeshes.empty()
+			|| selected_name(sm.name) || selected_name(inst.name);
+
+		const glm::mat3 nmat =
+			glm::transpose(glm::inverse(glm::mat3{inst.transform}));
+
+		for(uint32_t i = 0; i < sm.num_vertices; ++i, ++flat_idx) {
+			const uint32_t vidx = sm.first_vertex + i;
+			const VertexData& v = geom.vertices[vidx];
+			const Vec3 normal = nmat * v.normal;
+
+			bool inside = in_submesh;
+
+			if(inside && roi.has_box) {
+				const Vec3 p = scale * Vec3{inst.transform
+					* Vec4{v.position, 1.0f}};
+				inside = glm::all(glm::greaterThanEqual(p, roi.box_lo))
+					&& glm::all(glm::lessThanEqual(p, roi.box_hi));
+			}
+
+			if(inside) {
+				const real len = glm::length(normal);
+				const real c = len > 0.0
+					? glm::dot(normal, unit_up) / len : 1.0;
+				// Some leeway for the rounding errors:
+				inside = c <= cos_min_tilt + 1e-6
+					&& c >= cos_max_tilt - 1e-6;
+			}
+
+			// Trackers change orientation, so the rest normal
+			// can't tell if they are ever sunlit.
+			if(!inside) {
+				++ret.outside_roi;
+			} else if(!inst.tracker && !cone.may_face(normal)) {
+				++ret.never_sunlit;
+			} else {
+				ret.receivers.push_back({vidx, inst_idx});
+				ret.indices.push_back(flat_idx);
+			}
+		}
+	}
+
+	return ret;
+}
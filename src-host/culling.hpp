@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "float.hpp"
+#include "mesh_tools.hpp"
+
+// Conservative set of directions the sun comes from over the year.
+// Directions are binned in a cube map, each bin being a cone
+// that bounds the directions inside it.
+class SunCone
+{
+public:
+	SunCone(const std::vector<Vec3>& suns);
+
+	// False only if a surface with this normal
+	// never faces any of the sun directions.
+	bool may_face(const Vec3& normal) const;
+
+private:
+	// Cube map resolution, per face side.
+	static const unsigned RES = 64;
+
+	// One entry per normal bin.
+	std::vector<bool> facing;
+};
+
+// User selection of the receivers to evaluate.
+struct RegionOfInterest
+{
+	// Box, in the same coordinates of the output model.
+	bool has_box = false;
+	Vec3 box_lo{0.0f};
+	Vec3 box_hi{0.0f};
+
+	// Range of angles between the normal and up, in degrees.
+	real min_tilt = 0.0;
+	real max_tilt = 180.0;
+
+	// If not empty, only receivers in the meshes
+	// or instances with these names.
+	std::vector<std::string> submeshes;
+};
+
+struct ReceiverSelection
+{
+	std::vector<Receiver> receivers;
+
+	// Index of each selected receiver in the flattened scene.
+	std::vector<uint32_t> indices;
+
+	size_t outside_roi = 0;
+	size_t never_sunlit = 0;
+};
+
+ReceiverSelection select_receivers(const Scene& scene, real scale,
+	const Vec3& unit_up, const RegionOfInterest& roi, const SunCone& cone);
@@ -0,0 +1,200 @@
+#include <iostream>
+#include <streambuf>
+#include <stdexcept>
+#include <cstring>
+#include <csignal>
+#include <cstdlib>
+#include <chrono>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.hpp"
+
+namespace {
+
+// Writes to a file descriptor, ignoring failures, as
+// the client may go away before the job is done.
+class FdBuf: public std::streambuf
+{
+public:
+	FdBuf(int fd):
+		fd{fd}
+	{
+		setp(buf, buf + sizeof buf);
+	}
+
+	~FdBuf()
+	{
+		sync();
+	}
+
+protected:
+	int_type overflow(int_type c) override
+	{
+		sync();
+		if(c != traits_type::eof()) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	int sync() override
+	{
+		write_all(pbase(), pptr() - pbase());
+		setp(buf, buf + sizeof buf);
+		return 0;
+	}
+
+private:
+	void write_all(const char* data, size_t size)
+	{
+		while(size > 0) {
+			const ssize_t n = write(fd, data, size);
+			if(n <= 0) {
+				return;
+			}
+			data += n;
+			size -= n;
+		}
+	}
+
+	int fd;
+	char buf[4096];
+};
+
+// Time a client has to send its whole request, so that one that never
+// stops writing can't block the jobs of the others.
+const std::chrono::seconds REQUEST_TIMEOUT{10};
+
+// Reads the null terminated strings until the client stops writing.
+// Returns false if the client took too long, or the connection failed.
+bool read_request(int fd, std::vector<std::string>& ret)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto deadline = Clock::now() + REQUEST_TIMEOUT;
+
+	std::string data;
+	char buf[4096];
+	for(;;) {
+		const auto left = std::chrono::duration_cast<
+			std::chrono::milliseconds>(deadline - Clock::now()).count();
+		pollfd pfd{fd, POLLIN, 0};
+		if(left <= 0 || poll(&pfd, 1, int(left)) <= 0) {
+			return false;
+		}
+
+		const ssize_t n = read(fd, buf, sizeof buf);
+		if(n < 0) {
+			return false;
+		}
+		if(n == 0) {
+			break;
+		}
+		data.append(buf, n);
+	}
+
+	size_t start = 0;
+	for(size_t end; (end = data.find('\0', start)) != std::string::npos;
+		start = end + 1)
+	{
+		ret.push_back(data.substr(start, end - start));
+	}
+	return true;
+}
+
+int run_job(const std::vector<std::string>& request,
+	const std::function<int(const std::vector<std::string>&)>& job)
+{
+	if(request.empty() || chdir(request[0].c_str()) != 0) {
+		std::cout << "Error: Invalid working directory." << std::endl;
+		return 1;
+	}
+
+	try {
+		return job(std::vector<std::string>(
+			request.begin() + 1, request.end()));
+	} catch(const std::exception& e) {
+		std::cout << "Error: " << e.what() << std::flush;
+		return 1;
+	}
+}
+
+}
+
+void serve(const std::string& socket_path,
+	const std::function<int(const std::vector<std::string>&)>& job)
+{
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if(socket_path.size() >= sizeof addr.sun_path) {
+		throw std::runtime_error("Socket path is too long.\n");
+	}
+	std::strcpy(addr.sun_path, socket_path.c_str());
+
+	const int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path.c_str());
+	if(sock < 0 || bind(sock, reinterpret_cast<sockaddr*>(&addr),
+		sizeof addr) != 0 || listen(sock, 16) != 0)
+	{
+		throw std::runtime_error(
+			"Could not listen on \"" + socket_path + "\".\n"
+		);
+	}
+
+	// A client going away must not kill the daemon.
+	signal(SIGPIPE, SIG_IGN);
+
+	char* home_dir = getcwd(nullptr, 0);
+	const std::string home = home_dir ? home_dir : ".";
+	free(home_dir);
+
+	std::cout << "Listening on " << socket_path << '.' << std::endl;
+	for(;;) {
+		const int conn = accept(sock, nullptr, nullptr);
+		if(conn < 0) {
+			continue;
+		}
+
+		std::vector<std::string> request;
+		if(!read_request(conn, request)) {
+			std::cout << "Request not received in time, dropped."
+				<< std::endl;
+			close(conn);
+			continue;
+		}
+
+		// The job's output, with its formatting,
+		// is kept apart from the daemon's.
+		int status;
+		{
+			FdBuf out{conn};
+			std::streambuf* old_buf = std::cout.rdbuf(&out);
+			const auto old_flags = std::cout.flags();
+			const auto old_precision = std::cout.precision();
+
+			status = run_job(request, job);
+
+			std::cout.flush();
+			std::cout.flags(old_flags);
+			std::cout.precision(old_precision);
+			std::cout.rdbuf(old_buf);
+
+			std::ostream(&out) << "exit " << status << '\n';
+		}
+		close(conn);
+
+		if(chdir(home.c_str()) != 0) {
+			throw std::runtime_error(
+				"Could not return to \"" + home + "\".\n"
+			);
+		}
+
+		std::cout << "Job in " << (request.empty() ? "?" : request[0])
+			<< " finished with status " << status << '.'
+			<< std::endl;
+	}
+}
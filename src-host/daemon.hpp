@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+
+// Serves jobs on a Unix socket, one at a time, until killed.
+//
+// A client sends its working directory followed by the command line
+// arguments of the job, each terminated by a null byte, and then shuts
+// down its writing side, all within 10 seconds. The job runs in the
+// client's directory, and everything it writes to std::cout is sent
+// back, followed by a last line "exit <status>" before the connection
+// is closed.
+//
+// resources/pylib/solmap_client.py submits jobs.
+void serve(const std::string& socket_path,
+	const std::function<int(const std::vector<std::string>& args)>& job);
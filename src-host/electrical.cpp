@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "electrical.hpp"
+
+// Receivers whose normal is within 60° of the
+// front direction of the panel are on its front.
+static const float FRONT_MIN_COS = 0.5f;
+
+StringLayout build_strings(const Scene& scene,
+	const std::vector<Receiver>& receivers,
+	const std::vector<std::string>& prefixes, uint32_t diodes,
+	const Vec3& unit_up)
+{
+	// Receivers of each instance.
+	std::vector<std::vector<uint32_t>> inst_receivers(
+		scene.instances.size());
+	for(uint32_t i = 0; i < receivers.size(); ++i) {
+		inst_receivers[receivers[i].instance].push_back(i);
+	}
+
+	StringLayout ret;
+	for(const auto& prefix: prefixes) {
+		const uint32_t first_substring = ret.substrings.size();
+		uint32_t panels = 0;
+
+		for(uint32_t inst_idx = 0; inst_idx < scene.instances.size();
+			++inst_idx)
+		{
+			const auto& inst = scene.instances[inst_idx];
+			if(inst.name.compare(0, prefix.size(), prefix) != 0) {
+				continue;
+			}
+			++panels;
+
+			// The substrings are side by side across the panel,
+			// so they are split along the middle sized extent of
+			// the panel mesh, the smallest one being its thickness.
+			const auto& sm = scene.geometry.submeshes[inst.submesh];
+			Vec3 lo{std::numeric_limits<real>::max()};
+			Vec3 hi{std::numeric_limits<real>::lowest()};
+			for(uint32_t i = 0; i < sm.num_vertices; ++i) {
+				const Vec3& p = scene.geometry.vertices[
+					sm.first_vertex + i].position;
+				lo = glm::min(lo, p);
+				hi = glm::max(hi, p);
+			}
+
+			const Vec3 extent = hi - lo;
+			uint8_t axes[] = {0, 1, 2};
+			std::sort(axes, axes + 3, [&](uint8_t a, uint8_t b) {
+				return extent[a] < extent[b];
+			});
+			const uint8_t axis = axes[1];
+
+			// The front face is the side of the thickness axis
+			// that, placed in the scene, is more facing up.
+			Vec3 front{0.0f};
+			front[axes[0]] = 1.0f;
+			const glm::mat3 nmat = glm::transpose(
+				glm::inverse(glm::mat3{inst.transform}));
+			if(glm::dot(nmat * front, unit_up) < 0.0f) {
+				front = -front;
+			}
+
+			std::vector<std::vector<uint32_t>> split(diodes);
+			bool has_front = false;
+			for(uint32_t r: inst_receivers[inst_idx]) {
+				const VertexData& v =
+					scene.geometry.vertices[receivers[r].vertex];
+				if(glm::dot(v.normal, front) < FRONT_MIN_COS) {
+					continue;
+				}
+				has_front = true;
+
+				const real x = v.position[axis];
+				const uint32_t k = extent[axis] > 0.0
+					? uint32_t((x - lo[axis]) / extent[axis]
+						* diodes)
+					: 0;
+				split[std::min(k, diodes - 1)].push_back(r);
+			}
+
+			if(!has_front) {
+				throw std::runtime_error("Panel \"" + inst.name
+					+ "\" of string \"" + prefix
+					+ "\" has no receivers on its front face.\n");
+			}
+
+			// Substrings without receivers carry no
+			// current, and are always bypassed.
+			for(const auto& sub: split) {
+				ret.substrings.push_back({
+					uint32_t(ret.substring_receivers.size()),
+					uint32_t(sub.size())
+				});
+				ret.substring_receivers.insert(
+					ret.substring_receivers.end(),
+					sub.begin(), sub.end());
+			}
+		}
+
+		const uint32_t count = ret.substrings.size() - first_substring;
+		if(count == 0) {
+			throw std::runtime_error("No panels in string \""
+				+ prefix + "\".\n");
+		}
+		if(count > MAX_SUBSTRINGS) {
+			throw std::runtime_error("Too many substrings in string \""
+				+ prefix + "\".\n");
+		}
+
+		ret.strings.push_back({first_substring, count});
+		ret.names.push_back(prefix);
+		ret.panel_count.push_back(panels);
+	}
+
+	return ret;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "mesh_tools.hpp"
+
+// Electrical layout of the receivers: strings of panels in series,
+// where each panel is an instance, split in substrings protected by
+// bypass diodes. All the ranges match uvec2 in the shaders.
+struct StringLayout
+{
+	struct Range
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// Range of each substring in substring_receivers.
+	std::vector<Range> substrings;
+
+	// Indices of the receivers of every substring, in order.
+	std::vector<uint32_t> substring_receivers;
+
+	// Range of each string in substrings.
+	std::vector<Range> strings;
+
+	std::vector<std::string> names;
+	std::vector<uint32_t> panel_count;
+
+	bool empty() const
+	{
+		return strings.empty();
+	}
+};
+
+// The maximum number of substrings in a string, as
+// sized in the shared memory of mismatch.comp.
+static const uint32_t MAX_SUBSTRINGS = 1024;
+
+// Length of the hourly energy series of each string.
+static const uint32_t HOURS_PER_YEAR = 8760;
+
+// Each string is made of the instances whose names start with one of the
+// prefixes, in instance order. Each instance is split in the given number
+// of substrings, across its shorter side. Only the receivers on the front
+// face of each panel, the one of its two largest faces more facing up, are
+// in the substrings, as the back and the edges are never lit with it.
+StringLayout build_strings(const Scene& scene,
+	const std::vector<Receiver>& receivers,
+	const std::vector<std::string>& prefixes, uint32_t diodes,
+	const Vec3& unit_up);
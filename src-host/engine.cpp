@@ -0,0 +1,265 @@
+#include <iostream>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
+#include "engine.hpp"
+
+Vec3 to_vec(AngularPosition pos,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east)
+{
+	return glm::rotate(glm::angleAxis(float(-pos.az), unit_up) *
+		glm::angleAxis(float(pos.alt), unit_east), unit_north);
+}
+
+namespace {
+
+struct NoComputeQueueFamily: public std::exception {};
+
+std::unique_ptr<ShadowProcessor>
+create_if_has_graphics(
+	VkPhysicalDevice pd,
+	const Scene &shadow_scene, const std::vector<Receiver>& receivers,
+	const StringLayout& strings, const TuningFor& tuning)
+{
+	// Query queue capabilities:
+	uint32_t num_qf;
+	vkGetPhysicalDeviceQueueFamilyProperties(pd, &num_qf, nullptr);
+
+	std::vector<VkQueueFamilyProperties> qfp(num_qf);
+	vkGetPhysicalDeviceQueueFamilyProperties(pd, &num_qf, qfp.data());
+
+	// Select which queue families to use in the device:
+	std::vector<VkDeviceQueueCreateInfo> used_qf;
+	used_qf.reserve(num_qf);
+
+	std::vector<float> priorities;
+	for(uint32_t i = 0; i < num_qf; ++i) {
+		// Queue family is not for graphics, skip.
+		if(!(qfp[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+			continue;
+		}
+
+		// All priorities are the same: adjust priority
+		// vector to the biggest number of queues, overall:
+		if(priorities.size() < qfp[i].queueCount) {
+			priorities.resize(qfp[i].queueCount, 1.0);
+		}
+
+		// Set this family for use:
+		used_qf.push_back({
+			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.queueFamilyIndex = i,
+			.queueCount = qfp[i].queueCount
+			// We set pQueuePriorities, because the pointer might change.
+		});
+	}
+
+	// Set pQueuePriorities:
+	for(auto& qf: used_qf) {
+		qf.pQueuePriorities = priorities.data();
+	}
+
+	// Create only if there is any usable queue family.
+	if(used_qf.empty()) {
+		throw NoComputeQueueFamily{};
+	}
+
+	// Large points are needed to draw point cloud splats.
+	VkPhysicalDeviceFeatures supported;
+	vkGetPhysicalDeviceFeatures(pd, &supported);
+
+	VkPhysicalDeviceFeatures features{};
+	features.largePoints = supported.largePoints;
+
+	UVkDevice d{VkDeviceCreateInfo{
+			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+			nullptr,
+			0,
+			(uint32_t)used_qf.size(), used_qf.data(),
+			0, nullptr,
+			0, nullptr,
+			&features
+		}, pd
+	};
+
+	// Retrieve que requested queues from the newly created device:
+	std::vector<std::pair<uint32_t, std::vector<VkQueue>>> qfs;
+	qfs.reserve(num_qf);
+	for(auto& qf: used_qf) {
+		qfs.emplace_back();
+		qfs.back().first = qf.queueFamilyIndex;
+		auto& queues = qfs.back().second;
+
+		// It seems there is no performance benefit of using
+		// more than one queue, so just create one.
+		// TODO: Maybe remove support for more than one queue
+		// in the same family?
+		queues.emplace_back();
+		vkGetDeviceQueue(d.get(), qf.queueFamilyIndex, 0, &queues.back());
+	}
+
+	VkPhysicalDeviceProperties pd_props;
+	vkGetPhysicalDeviceProperties(pd, &pd_props);
+
+	auto ret = std::make_unique<ShadowProcessor>(
+		pd, pd_props, std::move(d), std::move(qfs),
+		shadow_scene, receivers, strings, tuning(pd_props)
+	);
+
+	return ret;
+}
+
+}
+
+std::vector<std::unique_ptr<ShadowProcessor>>
+create_procs_from_devices(VkInstance vk,
+	const Scene &shadow_scene, const std::vector<Receiver>& receivers,
+	const StringLayout& strings, const TuningFor& tuning)
+{
+	const std::vector<VkPhysicalDevice> pds = used_devices(vk);
+
+	// Launch device setup tasks, possibly in parallel.
+	std::vector<std::future<std::unique_ptr<ShadowProcessor>>> create_work;
+	create_work.reserve(pds.size());
+	for(auto &pd: pds) {
+		create_work.push_back(std::async(
+			create_if_has_graphics, pd, shadow_scene, receivers,
+			strings, tuning)
+		);
+	}
+
+	std::vector<std::unique_ptr<ShadowProcessor>> processors;
+	processors.reserve(pds.size());
+	std::cout << "Suitable Vulkan devices found:\n";
+	for(auto &f: create_work) {
+		try{
+			processors.push_back(f.get());
+			std::cout << " - "<< processors.back()->get_name()
+				<< '\n';
+		} catch(const std::exception &e) {}
+	}
+	if(processors.empty()) {
+		std::cout << " None!" << std::endl;
+		throw std::runtime_error("No suitable Vulkan devices.\n");
+	}
+	std::cout.flush();
+
+	return processors;
+}
+
+std::vector<VkPhysicalDevice> used_devices(VkInstance vk)
+{
+	// Get the number of Vulkan devices in the system:
+	uint32_t dcount;
+	chk_vk(vkEnumeratePhysicalDevices(vk, &dcount, nullptr));
+
+	// Get the list of VkPhysicalDevice
+	std::vector<VkPhysicalDevice> pds(dcount);
+	chk_vk(vkEnumeratePhysicalDevices(vk, &dcount, pds.data()));
+
+	// Only the first one is used, for now.
+	pds.resize(std::min<size_t>(1, pds.size()));
+	return pds;
+}
+
+UVkInstance initialize_vulkan()
+{
+	// Version 1.1 is needed to query the memory budget of the devices.
+	const VkApplicationInfo app{
+		VK_STRUCTURE_TYPE_APPLICATION_INFO,
+		nullptr,
+		"solmap",
+		0,
+		nullptr,
+		0,
+		VK_API_VERSION_1_1
+	};
+
+	UVkInstance vk{VkInstanceCreateInfo{
+			VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+			nullptr,
+			0,
+			&app,
+			0,
+			nullptr,
+			0,
+			nullptr
+		}
+	};
+	return vk;
+}
+
+void add_results(
+	std::vector<std::unique_ptr<ShadowProcessor>>& ps,
+	bool has_strings, PartialResult& r)
+{
+	for(auto &p: ps) {
+		r.directional_sum += p->get_directional_sum();
+		r.diffuse_sum += p->get_diffuse_sum();
+		r.time_sum += p->get_time_sum();
+		r.count += p->get_process_count();
+		p->accumulate_result(r.energy.data());
+		if(has_strings) {
+			p->accumulate_strings(r.string_energy.data(),
+				r.string_hourly.data());
+		}
+	}
+}
+
+PartialResult compute_from(const PartialResult& base,
+	const std::vector<InstantaneousData>& suns,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east,
+	std::vector<std::unique_ptr<ShadowProcessor>>& ps,
+	const HorizonProfile* horizon, bool has_strings,
+	double interval, size_t max_chunk,
+	const std::function<bool(const PartialResult&)>& step)
+{
+	// Processed until the rate is known.
+	static const size_t first_chunk = 256;
+
+	std::vector<Vec3> solar_data;
+	auto results_until = [&](size_t processed) {
+		PartialResult r = base;
+		r.processed = processed;
+		r.solar_data.insert(r.solar_data.end(),
+			solar_data.begin(), solar_data.end());
+		add_results(ps, has_strings, r);
+		return r;
+	};
+
+	size_t pos = base.processed;
+	size_t chunk = interval > 0.0 ? first_chunk : max_chunk;
+	while(pos < suns.size()) {
+		const size_t end = std::min(suns.size(),
+			pos + std::min(chunk, max_chunk));
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto part = calculate_yearly_incidence(
+			std::vector<InstantaneousData>(suns.begin() + pos,
+				suns.begin() + end),
+			unit_north, unit_up, unit_east, ps, horizon);
+		solar_data.insert(solar_data.end(), part.begin(), part.end());
+		const double elapsed = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+
+		// The next chunk should last about the interval.
+		if(interval > 0.0) {
+			chunk = std::max(size_t(1), size_t((end - pos)
+				* interval / std::max(elapsed, 1e-3)));
+		}
+		pos = end;
+
+		if(pos < suns.size() && !step(results_until(pos))) {
+			break;
+		}
+	}
+
+	return results_until(pos);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+#include "vk_manager.hpp"
+#include "work_stealing.hpp"
+#include "shadow_processor.hpp"
+#include "horizon.hpp"
+#include "partial_result.hpp"
+
+extern "C" {
+#include "sun_position.h"
+}
+
+// Unit vector pointing to the sun, in the frame given by the unit vectors.
+Vec3 to_vec(AngularPosition pos,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east);
+
+// Samples taken at a time by a processor.
+static const size_t DISPATCH_CHUNK = 64;
+
+// Runs the processors over the sun samples, in parallel, one thread per
+// processor, and returns the direct incidence vector of each sample
+// rendered, in the order of the samples. The results accumulate in the
+// processors.
+template<class Processor>
+std::vector<Vec3>
+calculate_yearly_incidence(const std::vector<InstantaneousData>& suns,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east,
+	std::vector<std::unique_ptr<Processor>> &processors,
+	const HorizonProfile *horizon
+)
+{
+	// The samples are split among the processors, which take them in
+	// chunks, and steal from each other when out of their own.
+	WorkStealingRanges work(suns.size(), processors.size(),
+		DISPATCH_CHUNK);
+
+	// Each processor logs the direct incidence of the samples
+	// it rendered, with their indices, to be merged at the end.
+	std::vector<std::vector<std::pair<size_t, Vec3>>>
+		logs(processors.size());
+
+	std::vector<std::thread> jobs;
+	jobs.reserve(processors.size());
+	for(size_t w = 0; w < processors.size(); ++w) {
+		jobs.push_back(std::thread([&, w]() {
+			Processor& p = *processors[w];
+			auto& log = logs[w];
+
+			size_t begin, end;
+			while(work.next(w, begin, end)) {
+				for(size_t i = begin; i < end; ++i) {
+					const InstantaneousData& val = suns[i];
+
+					// Transforms the angular position into a unit
+					// vector pointing to the sun.
+					const Vec3 suns_direction = to_vec(val.pos,
+						unit_north, unit_up, unit_east);
+
+					// If the sun is behind the far terrain,
+					// there is nothing to render.
+					if(horizon && horizon->occludes(val.pos)) {
+						p.skip(suns_direction, val);
+						continue;
+					}
+
+					p.process(suns_direction, val);
+
+					// Store the calculated solar data for later reuse.
+					log.emplace_back(i,
+						float(val.coefficient * val.direct_power)
+						* suns_direction);
+				}
+			}
+		}));
+	}
+
+	for(auto &t: jobs) {
+		t.join();
+	}
+
+	std::vector<std::pair<size_t, Vec3>> merged;
+	for(const auto& log: logs) {
+		merged.insert(merged.end(), log.begin(), log.end());
+	}
+	std::sort(merged.begin(), merged.end(),
+		[](const std::pair<size_t, Vec3>& a,
+			const std::pair<size_t, Vec3>& b) {
+			return a.first < b.first;
+		});
+
+	std::vector<Vec3> direct_incidence;
+	direct_incidence.reserve(merged.size());
+	for(const auto& m: merged) {
+		direct_incidence.push_back(m.second);
+	}
+	return direct_incidence;
+}
+
+UVkInstance initialize_vulkan();
+
+// The physical devices processors are created on.
+std::vector<VkPhysicalDevice> used_devices(VkInstance vk);
+
+// The tuning to use on a device, given its properties.
+typedef std::function<ProcessorTuning(const VkPhysicalDeviceProperties&)>
+	TuningFor;
+
+// Creates a processor on each suitable device, with the scene uploaded.
+std::vector<std::unique_ptr<ShadowProcessor>>
+create_procs_from_devices(VkInstance vk,
+	const Scene &shadow_scene, const std::vector<Receiver>& receivers,
+	const StringLayout& strings, const TuningFor& tuning);
+
+// Adds the results accumulated by the processors.
+void add_results(
+	std::vector<std::unique_ptr<ShadowProcessor>>& ps,
+	bool has_strings, PartialResult& r);
+
+// Processes the sun samples from where base stopped, in chunks of at
+// most max_chunk samples, and returns the results of all of them. If
+// the interval, in seconds, is positive, chunks last about the interval.
+// After each chunk but the last, step is called with the results so
+// far, and the computation stops there if it returns false.
+PartialResult compute_from(const PartialResult& base,
+	const std::vector<InstantaneousData>& suns,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east,
+	std::vector<std::unique_ptr<ShadowProcessor>>& ps,
+	const HorizonProfile* horizon, bool has_strings,
+	double interval, size_t max_chunk,
+	const std::function<bool(const PartialResult&)>& step);
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <thread>
+#include <limits>
+#include <cmath>
+
+#include "horizon.hpp"
+
+// Earth's mean radius, in meters.
+static const double earth_radius = 6371000.0;
+
+// Typical coefficient of atmospheric refraction, which
+// slightly bends the line of sight back to the ground.
+static const double refraction_coef = 0.13;
+
+HorizonProfile::HorizonProfile(const HeightRaster& dem,
+	double site_x, double site_y, double site_z, unsigned num_bins):
+	bins(num_bins, -M_PI * 0.5)
+{
+	const double bin_width = 2.0 * M_PI / num_bins;
+
+	// Half diagonal of a cell, used to find the angular
+	// span of the cell as seen from the site.
+	const double cell_radius = dem.cell_size * M_SQRT1_2;
+
+	// Cells this close to the site are part of the ground the
+	// site stands on, not of the horizon.
+	const double min_dist = 1.5 * dem.cell_size;
+
+	// Each thread sweeps a band of raster rows, keeping its own
+	// profile, which are merged at the end.
+	const unsigned num_threads = std::max(1u,
+		std::min(std::thread::hardware_concurrency(), dem.rows));
+	std::vector<std::vector<float>> partial(num_threads, bins);
+	std::vector<std::thread> jobs;
+	jobs.reserve(num_threads);
+
+	for(unsigned t = 0; t < num_threads; ++t) {
+		jobs.push_back(std::thread([&, t]() {
+			std::vector<float> &prof = partial[t];
+
+			for(uint32_t r = t; r < dem.rows; r += num_threads) {
+				const double dy = dem.cell_y(r) - site_y;
+
+				for(uint32_t c = 0; c < dem.cols; ++c) {
+					const float h = dem.at(c, r);
+					if(!dem.is_valid(h)) {
+						continue;
+					}
+
+					const double dx = dem.cell_x(c) - site_x;
+					const double dist = std::hypot(dx, dy);
+					if(dist < min_dist) {
+						continue;
+					}
+
+					// Height of the cell relative to the
+					// site, lowered by Earth's curvature.
+					const double rel_h = h - site_z
+						- dist * dist * (1.0 - refraction_coef)
+						/ (2.0 * earth_radius);
+					const float elev = std::atan2(rel_h, dist);
+
+					// The cell covers every bin within
+					// its angular span.
+					double az = std::atan2(dx, dy);
+					if(az < 0.0) {
+						az += 2.0 * M_PI;
+					}
+					const double span =
+						std::asin(std::min(1.0, cell_radius / dist));
+
+					const long first = std::floor((az - span) / bin_width);
+					const long last = std::floor((az + span) / bin_width);
+					for(long b = first; b <= last; ++b) {
+						const unsigned idx = (b % long(num_bins)
+							+ num_bins) % num_bins;
+						prof[idx] = std::max(prof[idx], elev);
+					}
+				}
+			}
+		}));
+	}
+
+	for(auto &j: jobs) {
+		j.join();
+	}
+
+	for(auto &prof: partial) {
+		for(unsigned i = 0; i < num_bins; ++i) {
+			bins[i] = std::max(bins[i], prof[i]);
+		}
+	}
+}
+
+double HorizonProfile::elevation(double azimuth) const
+{
+	// Linear interpolation between the two nearest bin centers.
+	const double pos = azimuth / (2.0 * M_PI) * bins.size() - 0.5;
+	const double fl = std::floor(pos);
+	const double t = pos - fl;
+
+	const long n = bins.size();
+	const long a = ((long(fl) % n) + n) % n;
+	const long b = (a + 1) % n;
+
+	return bins[a] * (1.0 - t) + bins[b] * t;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "raster.hpp"
+
+extern "C" {
+#include "sun_position.h"
+}
+
+// Elevation angle of the far terrain seen from a site,
+// discretized in azimuth bins.
+class HorizonProfile
+{
+public:
+	// Site coordinates are in the same reference as the raster.
+	HorizonProfile(const HeightRaster& dem,
+		double site_x, double site_y, double site_z,
+		unsigned num_bins = 1440);
+
+	// Elevation angle of the horizon, in radians, at the given
+	// azimuth (in radians, from north towards east).
+	double elevation(double azimuth) const;
+
+	// Tells if the sun at given position is behind the terrain.
+	bool occludes(const AngularPosition& pos) const
+	{
+		return pos.alt < elevation(pos.az);
+	}
+
+private:
+	std::vector<float> bins;
+};
@@ -0,0 +1,591 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <set>
+
+#include <glm/glm.hpp>
+
+#include "layout.hpp"
+
+namespace {
+
+// The largest facet grid sampled, in cells.
+const size_t MAX_FACET_CELLS = size_t(1) << 26;
+
+// Passes of the local search, each trying to shift every panel.
+const unsigned MAX_SEARCH_PASSES = 8;
+
+// A planar part of the mesh, sampled in a grid over its plane,
+// with the u axis horizontal whenever the plane is not.
+struct Facet
+{
+	Vec3 normal{0.0f, 0.0f, 0.0f};
+	Vec3 u, v;
+
+	// Distance of the plane from the origin, along normal.
+	real offset = 0.0;
+
+	// Plane coordinates of the grid corner.
+	real s0, t0;
+	uint32_t nu, nv;
+
+	// Members, before sampling:
+	std::vector<uint32_t> triangles;
+	std::vector<uint32_t> points;
+
+	// Summed-area tables of the incidence and of the covered
+	// cells, with an extra zero row and column.
+	std::vector<double> sum;
+	std::vector<uint32_t> covered;
+
+	std::vector<uint8_t> occupied;
+
+	double rect_sum(uint32_t i, uint32_t j, uint32_t w, uint32_t h) const
+	{
+		const size_t stride = nu + 1;
+		return sum[(j + h) * stride + i + w] - sum[j * stride + i + w]
+			- sum[(j + h) * stride + i] + sum[j * stride + i];
+	}
+
+	uint32_t rect_covered(uint32_t i, uint32_t j,
+		uint32_t w, uint32_t h) const
+	{
+		const size_t stride = nu + 1;
+		return covered[(j + h) * stride + i + w]
+			- covered[j * stride + i + w]
+			- covered[(j + h) * stride + i]
+			+ covered[j * stride + i];
+	}
+};
+
+// Candidate panel position, with its lower corner at cell (i, j).
+// Rotated panels have the length along u, instead of the width.
+struct Rect
+{
+	uint32_t facet;
+	uint32_t i, j;
+	bool rotated;
+	real score;
+};
+
+}
+
+LayoutResult optimize_layout(const Mesh& mesh, real scale,
+	const Vec3& unit_up, const std::vector<float>& incidence,
+	const std::vector<bool>& selected, const LayoutOptions& opts)
+{
+	const real res = opts.resolution > 0.0 ? opts.resolution
+		: std::min(opts.width, opts.length) * real(0.25);
+
+	// Size of the panel in cells, rounded up, so that it
+	// is always covered by the cells it takes.
+	const uint32_t fw = std::ceil(opts.width / res - 1e-3);
+	const uint32_t fl = std::ceil(opts.length / res - 1e-3);
+
+	auto pos = [&](uint32_t v) {
+		return scale * mesh.vertices[v].position;
+	};
+
+	// Group the surface by plane: first by the quantized normal,
+	// then by the distance from origin, splitting wherever there
+	// is a gap larger than a cell. Unlike quantizing the distance,
+	// this never splits a plane in two.
+	struct Member
+	{
+		real distance;
+		Vec3 weighted_normal;
+		uint32_t id;
+	};
+	std::map<std::array<int32_t, 3>, std::vector<Member>> normal_groups;
+	auto add_to_plane = [&](Vec3 n, const Vec3& p, real weight,
+		uint32_t id)
+	{
+		n = glm::normalize(n);
+		const std::array<int32_t, 3> key{
+			int32_t(std::lround(n.x * 32.0f)),
+			int32_t(std::lround(n.y * 32.0f)),
+			int32_t(std::lround(n.z * 32.0f))
+		};
+		normal_groups[key].push_back({glm::dot(n, p), weight * n, id});
+	};
+
+	if(mesh.is_point_cloud()) {
+		for(uint32_t i = 0; i < mesh.vertices.size(); ++i) {
+			const Vec3& n = mesh.vertices[i].normal;
+			if(!selected[i] || glm::dot(n, n) == 0.0f) {
+				continue;
+			}
+			add_to_plane(n, pos(i), 1.0, i);
+		}
+	} else {
+		for(uint32_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+			const uint32_t* idx = &mesh.indices[t];
+			if(!selected[idx[0]] || !selected[idx[1]]
+				|| !selected[idx[2]])
+			{
+				continue;
+			}
+
+			const Vec3 a = pos(idx[0]);
+			Vec3 n = glm::cross(pos(idx[1]) - a, pos(idx[2]) - a);
+			const real area = glm::length(n);
+			if(area <= 0.0) {
+				continue;
+			}
+
+			// The front is where the vertex normals point to.
+			if(glm::dot(n, mesh.vertices[idx[0]].normal) < 0.0) {
+				n = -n;
+			}
+			add_to_plane(n, a, area, t);
+		}
+	}
+
+	std::vector<Facet> planes;
+	for(auto& ng: normal_groups) {
+		auto& members = ng.second;
+		std::sort(members.begin(), members.end(),
+			[](const Member& a, const Member& b) {
+				return a.distance < b.distance;
+			}
+		);
+
+		for(size_t k = 0; k < members.size(); ++k) {
+			if(k == 0 || members[k].distance
+				- members[k - 1].distance > res)
+			{
+				planes.emplace_back();
+			}
+
+			Facet& f = planes.back();
+			f.normal += members[k].weighted_normal;
+			if(mesh.is_point_cloud()) {
+				f.points.push_back(members[k].id);
+			} else {
+				f.triangles.push_back(members[k].id);
+			}
+		}
+	}
+	normal_groups.clear();
+
+	LayoutResult ret;
+	std::vector<Facet> facets;
+	for(Facet& f: planes) {
+		f.normal = glm::normalize(f.normal);
+
+		f.u = glm::cross(unit_up, f.normal);
+		if(glm::length(f.u) < 1e-3) {
+			f.u = glm::cross(f.normal, std::abs(f.normal.x) < 0.9f
+				? Vec3{1.0f, 0.0f, 0.0f} : Vec3{0.0f, 0.0f, 1.0f});
+		}
+		f.u = glm::normalize(f.u);
+		f.v = glm::cross(f.normal, f.u);
+
+		// Extent over the plane.
+		real s_lo = std::numeric_limits<real>::max();
+		real t_lo = s_lo;
+		real s_hi = std::numeric_limits<real>::lowest();
+		real t_hi = s_hi;
+		double offset = 0.0;
+		size_t count = 0;
+		auto extend = [&](uint32_t v, real radius) {
+			const Vec3 p = pos(v);
+			const real s = glm::dot(p, f.u);
+			const real t = glm::dot(p, f.v);
+			s_lo = std::min(s_lo, s - radius);
+			s_hi = std::max(s_hi, s + radius);
+			t_lo = std::min(t_lo, t - radius);
+			t_hi = std::max(t_hi, t + radius);
+			offset += glm::dot(p, f.normal);
+			++count;
+		};
+		for(uint32_t t: f.triangles) {
+			for(uint8_t k = 0; k < 3; ++k) {
+				extend(mesh.indices[t + k], 0.0);
+			}
+		}
+		for(uint32_t p: f.points) {
+			extend(p, scale * mesh.splat_radius[p]);
+		}
+		f.offset = offset / count;
+
+		f.s0 = s_lo;
+		f.t0 = t_lo;
+		f.nu = std::ceil((s_hi - s_lo) / res);
+		f.nv = std::ceil((t_hi - t_lo) / res);
+
+		// Too small for a panel, in any orientation,
+		// or too large to sample.
+		if(std::max(f.nu, f.nv) < std::max(fw, fl)
+			|| std::min(f.nu, f.nv) < std::min(fw, fl)
+			|| size_t(f.nu) * f.nv > MAX_FACET_CELLS)
+		{
+			continue;
+		}
+
+		// Sample the incidence at the cell centers.
+		std::vector<float> value(size_t(f.nu) * f.nv, 0.0f);
+		std::vector<uint8_t> cover(value.size(), 0);
+		auto cell_range = [&](real lo, real hi, real origin,
+			uint32_t n, uint32_t& first, uint32_t& last)
+		{
+			first = std::max(0.0f,
+				std::floor((lo - origin) / res - 0.5f));
+			last = std::min(real(n), std::max(0.0f,
+				std::ceil((hi - origin) / res - 0.5f) + 1.0f));
+		};
+
+		for(uint32_t t: f.triangles) {
+			glm::vec2 c[3];
+			float e[3];
+			for(uint8_t k = 0; k < 3; ++k) {
+				const uint32_t v = mesh.indices[t + k];
+				const Vec3 p = pos(v);
+				c[k] = {glm::dot(p, f.u), glm::dot(p, f.v)};
+				e[k] = incidence[v];
+			}
+
+			const float det = (c[1].y - c[2].y) * (c[0].x - c[2].x)
+				+ (c[2].x - c[1].x) * (c[0].y - c[2].y);
+			if(det == 0.0f) {
+				continue;
+			}
+
+			uint32_t i0, i1, j0, j1;
+			cell_range(std::min({c[0].x, c[1].x, c[2].x}),
+				std::max({c[0].x, c[1].x, c[2].x}),
+				f.s0, f.nu, i0, i1);
+			cell_range(std::min({c[0].y, c[1].y, c[2].y}),
+				std::max({c[0].y, c[1].y, c[2].y}),
+				f.t0, f.nv, j0, j1);
+
+			for(uint32_t j = j0; j < j1; ++j) {
+				const float y = f.t0 + (j + 0.5f) * res;
+				for(uint32_t i = i0; i < i1; ++i) {
+					const float x = f.s0 + (i + 0.5f) * res;
+					const float l0 = ((c[1].y - c[2].y)
+						* (x - c[2].x) + (c[2].x - c[1].x)
+						* (y - c[2].y)) / det;
+					const float l1 = ((c[2].y - c[0].y)
+						* (x - c[2].x) + (c[0].x - c[2].x)
+						* (y - c[2].y)) / det;
+					const float l2 = 1.0f - l0 - l1;
+					if(l0 < -1e-5f || l1 < -1e-5f
+						|| l2 < -1e-5f)
+					{
+						continue;
+					}
+
+					const size_t idx = size_t(j) * f.nu + i;
+					value[idx] = l0 * e[0] + l1 * e[1]
+						+ l2 * e[2];
+					cover[idx] = 1;
+				}
+			}
+		}
+
+		for(uint32_t p: f.points) {
+			const Vec3 pp = pos(p);
+			const real s = glm::dot(pp, f.u);
+			const real t = glm::dot(pp, f.v);
+			const real r = scale * mesh.splat_radius[p];
+
+			uint32_t i0, i1, j0, j1;
+			cell_range(s - r, s + r, f.s0, f.nu, i0, i1);
+			cell_range(t - r, t + r, f.t0, f.nv, j0, j1);
+			for(uint32_t j = j0; j < j1; ++j) {
+				const real dy = f.t0 + (j + 0.5f) * res - t;
+				for(uint32_t i = i0; i < i1; ++i) {
+					const real dx = f.s0 + (i + 0.5f) * res - s;
+					if(dx * dx + dy * dy <= r * r) {
+						const size_t idx =
+							size_t(j) * f.nu + i;
+						value[idx] = incidence[p];
+						cover[idx] = 1;
+					}
+				}
+			}
+		}
+
+		// Build the summed-area tables.
+		const size_t stride = f.nu + 1;
+		f.sum.assign(stride * (f.nv + 1), 0.0);
+		f.covered.assign(f.sum.size(), 0);
+		for(uint32_t j = 0; j < f.nv; ++j) {
+			double row_sum = 0.0;
+			uint32_t row_covered = 0;
+			for(uint32_t i = 0; i < f.nu; ++i) {
+				const size_t idx = size_t(j) * f.nu + i;
+				row_sum += value[idx];
+				row_covered += cover[idx];
+
+				const size_t at = (j + 1) * stride + i + 1;
+				f.sum[at] = f.sum[at - stride] + row_sum;
+				f.covered[at] = f.covered[at - stride]
+					+ row_covered;
+			}
+		}
+
+		f.occupied.assign(size_t(f.nu) * f.nv, 0);
+		f.triangles.clear();
+		f.triangles.shrink_to_fit();
+		f.points.clear();
+		f.points.shrink_to_fit();
+
+		facets.push_back(std::move(f));
+	}
+	planes.clear();
+	ret.facets = facets.size();
+
+	auto footprint = [&](const Rect& r, uint32_t& w, uint32_t& h) {
+		w = r.rotated ? fl : fw;
+		h = r.rotated ? fw : fl;
+	};
+
+	// Tells if the rectangle is fully over the surface,
+	// and sets its score, the mean incidence.
+	auto evaluate = [&](Rect& r) {
+		const Facet& f = facets[r.facet];
+		uint32_t w, h;
+		footprint(r, w, h);
+		if(r.i + w > f.nu || r.j + h > f.nv
+			|| f.rect_covered(r.i, r.j, w, h) != w * h)
+		{
+			return false;
+		}
+		r.score = f.rect_sum(r.i, r.j, w, h) / (w * h);
+		return true;
+	};
+
+	// Evaluate every candidate position.
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<Rect> candidates;
+	for(uint32_t fi = 0; fi < facets.size(); ++fi) {
+		const Facet& f = facets[fi];
+		for(bool rotated: {false, true}) {
+			// A square panel has only one orientation.
+			if(rotated && fw == fl) {
+				break;
+			}
+
+			for(uint32_t j = 0; j < f.nv; ++j) {
+				for(uint32_t i = 0; i < f.nu; ++i) {
+					Rect r{fi, i, j, rotated, 0.0};
+					if(evaluate(r)) {
+						candidates.push_back(r);
+					}
+				}
+			}
+		}
+	}
+	ret.candidates = candidates.size();
+	ret.evaluation_time = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+
+	std::sort(candidates.begin(), candidates.end(),
+		[](const Rect& a, const Rect& b) {
+			return a.score > b.score;
+		}
+	);
+
+	auto is_free = [&](const Rect& r) {
+		const Facet& f = facets[r.facet];
+		uint32_t w, h;
+		footprint(r, w, h);
+		for(uint32_t j = r.j; j < r.j + h; ++j) {
+			const uint8_t* row = &f.occupied[size_t(j) * f.nu];
+			for(uint32_t i = r.i; i < r.i + w; ++i) {
+				if(row[i]) {
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	// Index of the candidates by facet, orientation and corner cell,
+	// with how many occupied cells each one covers, and the set of
+	// the free ones, in the order of the candidates, best first.
+	std::vector<std::array<std::vector<int32_t>, 2>> at_corner(
+		facets.size());
+	for(uint32_t fi = 0; fi < facets.size(); ++fi) {
+		for(auto& grid: at_corner[fi]) {
+			grid.assign(size_t(facets[fi].nu) * facets[fi].nv, -1);
+		}
+	}
+	std::vector<uint32_t> blocked(candidates.size(), 0);
+	std::set<uint32_t> free_candidates;
+	for(uint32_t c = 0; c < candidates.size(); ++c) {
+		const Rect& r = candidates[c];
+		at_corner[r.facet][r.rotated][size_t(r.j)
+			* facets[r.facet].nu + r.i] = c;
+		free_candidates.insert(c);
+	}
+
+	auto set_occupied = [&](const Rect& r, uint8_t occupied) {
+		Facet& f = facets[r.facet];
+		uint32_t w, h;
+		footprint(r, w, h);
+		for(uint32_t j = r.j; j < r.j + h; ++j) {
+			std::fill_n(&f.occupied[size_t(j) * f.nu + r.i], w,
+				occupied);
+		}
+
+		// Every candidate overlapping the rectangle has its
+		// corner within a footprint before one of its cells.
+		for(bool rotated: {false, true}) {
+			uint32_t cw, ch;
+			footprint(Rect{r.facet, 0, 0, rotated, 0.0}, cw, ch);
+			const uint32_t i0 = r.i + 1 > cw ? r.i + 1 - cw : 0;
+			const uint32_t j0 = r.j + 1 > ch ? r.j + 1 - ch : 0;
+			for(uint32_t cj = j0; cj < r.j + h; ++cj) {
+				for(uint32_t ci = i0; ci < r.i + w; ++ci) {
+					const int32_t c = at_corner[r.facet][rotated][
+						size_t(cj) * f.nu + ci];
+					if(c < 0) {
+						continue;
+					}
+
+					// Cells it shares with the rectangle.
+					const Rect& o = candidates[c];
+					const uint32_t shared =
+						(std::min(o.i + cw, r.i + w)
+							- std::max(o.i, r.i))
+						* (std::min(o.j + ch, r.j + h)
+							- std::max(o.j, r.j));
+					if(occupied) {
+						if(blocked[c] == 0) {
+							free_candidates.erase(c);
+						}
+						blocked[c] += shared;
+					} else {
+						blocked[c] -= shared;
+						if(blocked[c] == 0) {
+							free_candidates.insert(c);
+						}
+					}
+				}
+			}
+		}
+	};
+
+	auto best_free = [&]() -> const Rect* {
+		return free_candidates.empty() ? nullptr
+			: &candidates[*free_candidates.begin()];
+	};
+
+	// Greedy placement, from the best candidate.
+	std::vector<Rect> placed;
+	for(const Rect& c: candidates) {
+		if(placed.size() == opts.count) {
+			break;
+		}
+		if(is_free(c)) {
+			set_occupied(c, 1);
+			placed.push_back(c);
+		}
+	}
+
+	// Local search: shifting a panel by one cell may open room for
+	// another panel better than the worst placed, or for an extra
+	// panel, if not enough were placed.
+	const real eps = candidates.empty() ? 0.0
+		: std::abs(candidates.front().score) * 1e-6;
+	for(unsigned pass = 0; pass < MAX_SEARCH_PASSES; ++pass) {
+		bool improved = false;
+		for(size_t k = 0; k < placed.size(); ++k) {
+			static const int shifts[4][2] = {
+				{1, 0}, {-1, 0}, {0, 1}, {0, -1}
+			};
+			for(const auto& d: shifts) {
+				if((d[0] < 0 && placed[k].i == 0)
+					|| (d[1] < 0 && placed[k].j == 0))
+				{
+					continue;
+				}
+
+				Rect moved = placed[k];
+				moved.i += d[0];
+				moved.j += d[1];
+				if(!evaluate(moved)) {
+					continue;
+				}
+
+				set_occupied(placed[k], 0);
+				if(!is_free(moved)) {
+					set_occupied(placed[k], 1);
+					continue;
+				}
+				set_occupied(moved, 1);
+				const real loss = placed[k].score - moved.score;
+
+				if(placed.size() < opts.count) {
+					const Rect* r = best_free();
+					if(r && r->score > loss + eps) {
+						placed[k] = moved;
+						set_occupied(*r, 1);
+						placed.push_back(*r);
+						improved = true;
+						break;
+					}
+				} else if(placed.size() > 1) {
+					size_t worst = k == 0 ? 1 : 0;
+					for(size_t q = 0; q < placed.size(); ++q) {
+						if(q != k && placed[q].score
+							< placed[worst].score)
+						{
+							worst = q;
+						}
+					}
+
+					set_occupied(placed[worst], 0);
+					const Rect* r = best_free();
+					if(r && r->score - placed[worst].score
+						> loss + eps)
+					{
+						placed[k] = moved;
+						set_occupied(*r, 1);
+						placed[worst] = *r;
+						improved = true;
+						break;
+					}
+					set_occupied(placed[worst], 1);
+				}
+
+				set_occupied(moved, 0);
+				set_occupied(placed[k], 1);
+			}
+		}
+
+		if(!improved) {
+			break;
+		}
+	}
+
+	std::sort(placed.begin(), placed.end(),
+		[](const Rect& a, const Rect& b) {
+			return a.score > b.score;
+		}
+	);
+
+	for(const Rect& r: placed) {
+		const Facet& f = facets[r.facet];
+		uint32_t w, h;
+		footprint(r, w, h);
+
+		const real s = f.s0 + (r.i + w * 0.5f) * res;
+		const real t = f.t0 + (r.j + h * 0.5f) * res;
+		ret.placements.push_back({
+			f.offset * f.normal + s * f.u + t * f.v,
+			r.rotated ? f.v : f.u,
+			r.rotated ? f.u : f.v,
+			r.score,
+			r.facet
+		});
+	}
+
+	return ret;
+}
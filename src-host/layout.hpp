@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "float.hpp"
+#include "mesh_tools.hpp"
+
+// Panels to place over the surfaces of the model, all in
+// the same units of the output model.
+struct LayoutOptions
+{
+	uint32_t count = 0;
+	real width = 1.0;
+	real length = 2.0;
+
+	// Side of the grid cells the surfaces are sampled on.
+	// If zero, a quarter of the panel's shorter side.
+	real resolution = 0.0;
+};
+
+struct Placement
+{
+	// Center of the panel, and the directions of its sides,
+	// in the coordinates of the output model.
+	Vec3 center;
+	Vec3 width_dir;
+	Vec3 length_dir;
+
+	// Mean incidence over the panel, in the same unit
+	// of the incidence field given.
+	real incidence;
+
+	// Index of the planar facet the panel is on.
+	uint32_t facet;
+};
+
+struct LayoutResult
+{
+	// In order of decreasing incidence.
+	std::vector<Placement> placements;
+
+	size_t facets = 0;
+	size_t candidates = 0;
+
+	// Time spent evaluating the candidates, in seconds.
+	double evaluation_time = 0.0;
+};
+
+// Places panels flush over the planar facets of the mesh, without
+// overlapping, where the incidence is highest. Only the triangles
+// (or splats, for point clouds) whose vertices are all selected are
+// part of the facets, and panels must be fully inside them.
+//
+// The facets are sampled in grids, from which summed-area tables give
+// the mean incidence of any candidate rectangle in constant time. The
+// best candidates are picked greedily, then improved by a local search
+// that shifts panels to make room for better ones.
+LayoutResult optimize_layout(const Mesh& mesh, real scale,
+	const Vec3& unit_up, const std::vector<float>& incidence,
+	const std::vector<bool>& selected, const LayoutOptions& opts);
@@ -5,6 +5,15 @@
 #include <future>
 #include <cmath>
 #include <regex>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <filesystem>
 #include <getopt.h>
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -12,11 +21,24 @@
 #include <glm/gtx/quaternion.hpp>
 
 #include "vk_manager.hpp"
-#include "concurrentqueue.hpp"
-#include "semaphore.hpp"
 #include "sun_seq.hpp"
 #include "shadow_processor.hpp"
 #include "mesh_tools.hpp"
+#include "horizon.hpp"
+#include "raster_processor.hpp"
+#include "culling.hpp"
+#include "panel_array.hpp"
+#include "electrical.hpp"
+#include "pv_model.hpp"
+#include "layout.hpp"
+#include "vtk_writer.hpp"
+#include "result_store.hpp"
+#include "partial_result.hpp"
+#include "result_cache.hpp"
+#include "daemon.hpp"
+#include "engine.hpp"
+#include "tuning.hpp"
+#include "planner.hpp"
 
 template <typename F>
 constexpr F to_deg(F rad)
@@ -30,299 +52,130 @@ constexpr F to_rad(F deg)
 	return deg * M_PI / 180.0;
 }
 
-Vec3 to_vec(AngularPosition pos,
-	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east)
-{
-	return glm::rotate(glm::angleAxis(float(-pos.az), unit_up) *
-		glm::angleAxis(float(pos.alt), unit_east), unit_north);
-}
-
-static std::vector<Vec3>
-calculate_yearly_incidence(real latitude, real longitude, real altitude,
-	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east,
-	std::vector<std::unique_ptr<ShadowProcessor>> &processors
-)
-{
-	std::vector<Vec3> direct_incidence;
-	direct_incidence.reserve(60000);
-
-	// The generator of Sun's position:
-	SunSequence ss{latitude, longitude, altitude};
-
-	// Each generated position will be inserted into the queue
-	// and signaled on the semaphore.
-	moodycamel::ConcurrentQueue<InstantaneousData> queue;
-	Semaphore sem;
-
-	// These jobs will wait on the semaphore and consume
-	// the positions from the queue, simulating the result
-	// and accumulating internally.
-	// One job for each ShadowProcessor.
-	std::vector<std::thread> jobs;
-	jobs.reserve(processors.size());
-
-	moodycamel::ProducerToken t(queue);
-
-	// Jobs that will consume from the queue:
-	for(auto &p: processors) {
-		jobs.push_back(std::thread([&]() {
-			InstantaneousData val;
-
-			for(;;) {
-				sem.wait();
-
-				if(!queue.try_dequeue_from_producer(t, val)) {
-					break;
-				}
-
-				// Transforms the angular position into a unit
-				// vector pointing to the sun.
-				const Vec3 suns_direction = to_vec(val.pos,
-					unit_north, unit_up, unit_east);
-				p->process(suns_direction, val);
-
-				// Store the calculated solar data for later reuse.
-				direct_incidence.push_back(
-					float(val.coefficient * val.direct_power)
-					* suns_direction
-				);
-			}
-		}));
-	}
-
-	// Produce the positions and notify the processors.
-	InstantaneousData val;
-	while(ss.next(val)) {
-		queue.enqueue(t, val);
-		sem.signal();
-	}
-
-	// Notify the processors without producing anything.
-	sem.signal(jobs.size());
-
-	for(auto &t: jobs) {
-		t.join();
-	}
-
-	direct_incidence.shrink_to_fit();
-	return direct_incidence;
-}
-
-struct NoComputeQueueFamily: public std::exception {};
-
-static std::unique_ptr<ShadowProcessor>
-create_if_has_graphics(
-	VkPhysicalDevice pd,
-	const Mesh &shadow_mesh, const std::vector<VertexData>& test_set)
-{
-	// Query queue capabilities:
-	uint32_t num_qf;
-	vkGetPhysicalDeviceQueueFamilyProperties(pd, &num_qf, nullptr);
-
-	std::vector<VkQueueFamilyProperties> qfp(num_qf);
-	vkGetPhysicalDeviceQueueFamilyProperties(pd, &num_qf, qfp.data());
-
-	// Select which queue families to use in the device:
-	std::vector<VkDeviceQueueCreateInfo> used_qf;
-	used_qf.reserve(num_qf);
-
-	std::vector<float> priorities;
-	for(uint32_t i = 0; i < num_qf; ++i) {
-		// Queue family is not for graphics, skip.
-		if(!(qfp[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
-			continue;
-		}
-
-		// All priorities are the same: adjust priority
-		// vector to the biggest number of queues, overall:
-		if(priorities.size() < qfp[i].queueCount) {
-			priorities.resize(qfp[i].queueCount, 1.0);
-		}
-
-		// Set this family for use:
-		used_qf.push_back({
-			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = 0,
-			.queueFamilyIndex = i,
-			.queueCount = qfp[i].queueCount
-			// We set pQueuePriorities, because the pointer might change.
-		});
-	}
-
-	// Set pQueuePriorities:
-	for(auto& qf: used_qf) {
-		qf.pQueuePriorities = priorities.data();
-	}
-
-	// Create only if there is any usable queue family.
-	if(used_qf.empty()) {
-		throw NoComputeQueueFamily{};
-	}
-
-	UVkDevice d{VkDeviceCreateInfo{
-			VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-			nullptr,
-			0,
-			(uint32_t)used_qf.size(), used_qf.data(),
-			0, nullptr,
-			0, nullptr,
-			nullptr
-		}, pd
-	};
-
-	// Retrieve que requested queues from the newly created device:
-	std::vector<std::pair<uint32_t, std::vector<VkQueue>>> qfs;
-	qfs.reserve(num_qf);
-	for(auto& qf: used_qf) {
-		qfs.emplace_back();
-		qfs.back().first = qf.queueFamilyIndex;
-		auto& queues = qfs.back().second;
-
-		// It seems there is no performance benefit of using
-		// more than one queue, so just create one.
-		// TODO: Maybe remove support for more than one queue
-		// in the same family?
-		queues.emplace_back();
-		vkGetDeviceQueue(d.get(), qf.queueFamilyIndex, 0, &queues.back());
-	}
-
-	VkPhysicalDeviceProperties pd_props;
-	vkGetPhysicalDeviceProperties(pd, &pd_props);
-
-	auto ret = std::make_unique<ShadowProcessor>(
-		pd, pd_props, std::move(d), std::move(qfs),
-		shadow_mesh, test_set
-	);
-
-	return ret;
-}
-
-static std::vector<std::unique_ptr<ShadowProcessor>>
-create_procs_from_devices(VkInstance vk,
-	const Mesh &shadow_mesh, const std::vector<VertexData>& test_set)
-{
-	// Get the number of Vulkan devices in the system:
-	uint32_t dcount;
-	chk_vk(vkEnumeratePhysicalDevices(vk, &dcount, nullptr));
-
-	// Get the list of VkPhysicalDevice
-	std::vector<VkPhysicalDevice> pds(dcount);
-	chk_vk(vkEnumeratePhysicalDevices(vk, &dcount, pds.data()));
-
-	// Launch device setup tasks, possibly in parallel.
-	std::vector<std::future<std::unique_ptr<ShadowProcessor>>> create_work;
-	create_work.reserve(dcount);
-	for(auto &pd: pds) {
-		create_work.push_back(std::async(
-			create_if_has_graphics, pd, shadow_mesh, test_set)
-		);
-		break;
-	}
-
-	std::vector<std::unique_ptr<ShadowProcessor>> processors;
-	processors.reserve(dcount);
-	std::cout << "Suitable Vulkan devices found:\n";
-	for(auto &f: create_work) {
-		try{
-			processors.push_back(f.get());
-			std::cout << " - "<< processors.back()->get_name()
-				<< '\n';
-		} catch(const std::exception &e) {}
-	}
-	if(processors.empty()) {
-		std::cout << " None! Exiting due to lack of "
-			"suitable Vulkan devices!\n";
-		exit(1);
-	}
-	std::cout.flush();
-
-	return processors;
-}
-
-UVkInstance initialize_vulkan()
-{
-	UVkInstance vk{VkInstanceCreateInfo{
-			VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-			nullptr,
-			0,
-			nullptr,
-			0,
-			nullptr,
-			0,
-			nullptr
-		}
-	};
-	return vk;
-}
-
-void dump_vtk(const char* fname, const Mesh& mesh, real scale, double dif_total, double dir_total, Vec3 *directional)
-{
-	std::ofstream fd(fname);
-
-	fd <<	"# vtk DataFile Version 3.0\n"
-		"Daylight solar incidence\n"
-		"ASCII\n"
-		"DATASET POLYDATA\n"
-		"POINTS " << mesh.vertices.size() << " float\n";
-
-	for(auto& p: mesh.vertices) {
-		Vec3 pos = scale * p.position;
-		fd << pos.x << ' ' << pos.y << ' ' << pos.z << '\n';
-	}
-
-	uint32_t face_count = mesh.indices.size() / 3;
-	fd <<	"POLYGONS " << face_count << ' ' << face_count * 4 << '\n';
-	{
-		auto ptr = mesh.indices.begin();
-		for(uint32_t i = 0; i < face_count; ++i) {
-			fd << '3';
-			for(uint8_t j = 0; j < 3; ++j) {
-				fd << ' ' << *ptr++;
-			}
-			fd << '\n';
-		}
-	}
-
-	fd <<	"POINT_DATA " << mesh.vertices.size() << "\n"
-		"SCALARS incidence float 1\n"
-		"LOOKUP_TABLE default\n";
-
-	for(uint32_t i = 0; i < mesh.vertices.size(); ++i) {
-		const double result = dif_total
-			+ glm::dot(mesh.vertices[i].normal, directional[i]);
-		fd << result << '\n';
-	}
-
-	fd <<	"VECTORS directional_incidence float\n";
-
-	for(uint32_t i = 0; i < mesh.vertices.size(); ++i) {
-		fd << directional[i].x << ' ' <<
-			directional[i].y << ' ' <<
-			directional[i].z << '\n';
-	}
-
-	fd <<	"SCALARS shadow_percentage float 1\n"
-		"LOOKUP_TABLE default\n";
-
-	for(uint32_t i = 0; i < mesh.vertices.size(); ++i) {
-		const double result = (1.0 - glm::length(directional[i]) / dir_total) * 100.0;
-
-		// Assert the values are within reasonable ranges, but give
-		// leeway for floating point errors.
-		assert(result >= -1.0);
-		assert(result <= 101.0);
-
-		fd << result << '\n';
-	}
-}
+// Thrown after the usage is printed.
+struct UsageError {};
 
-void usage(const char *cmd)
+[[noreturn]] void usage(const char *cmd)
 {
 	std::cout << "Usage:\n"
 		"    " << cmd << " [options] latitude longitude 3d-model\n"
+		"    " << cmd << " [options] --merge latitude longitude 3d-model shard-files...\n"
+		"    " << cmd << " [options] --panel-array=... latitude longitude\n"
+		"    " << cmd << " --daemon=<socket> [--vram=<megabytes>]\n"
+		"    " << cmd << " --batch=<job-list> [--vram=<megabytes>]\n"
+		"    " << cmd << " --autotune [--frame-size=<pixels>]\n"
 		"\n"
 		"Option:\n"
+		"    -o --output=<file>\n"
+		"\tWhere to write the 3-D model with the incidence, in binary\n"
+		"\tlegacy VTK format (default: \"incidence.vtk\").\n"
+		"\n"
+		"    -z --store=<file>\n"
+		"\tAlso write the results, the run metadata and the sun\n"
+		"\tpositions to a columnar binary file, to be memory mapped,\n"
+		"\te.g. by resources/pylib/result_store.py.\n"
+		"\n"
+		"    -S --shard=<i>/<n>\n"
+		"\tOnly compute the <i>-th of <n> interleaved subsets of the\n"
+		"\tsun samples, from 0, and write the accumulated results to\n"
+		"\t\"shard-<i>-of-<n>.part\" instead of the outputs. Runs\n"
+		"\tof the shards can be spread over many machines.\n"
+		"\n"
+		"    -M --merge\n"
+		"\tInstead of computing, sum the partial result files given\n"
+		"\tafter 3d-model, one per shard, and write the outputs as if\n"
+		"\tcomputed in a single run. The other options must be the\n"
+		"\tsame as the shards were run with.\n"
+		"\n"
+		"    -C --checkpoint=<minutes>\n"
+		"\tSave the results accumulated so far, and how far in the\n"
+		"\tsun samples they go, about every so many minutes, to\n"
+		"\t\"solmap.checkpoint\" (or \"shard-<i>-of-<n>.checkpoint\").\n"
+		"\tEach checkpoint waits for the device to finish its frames,\n"
+		"\tso longer intervals have less overhead.\n"
+		"\n"
+		"    -R --resume\n"
+		"\tContinue from the checkpoint, if there is one. The options\n"
+		"\tmust be the same as the interrupted run was given.\n"
+		"\n"
+		"    -P --preview=<seconds>\n"
+		"\tAbout every so many seconds, write to the output an\n"
+		"\testimate of the incidence from the sun samples processed\n"
+		"\tso far. Samples are taken in an order spread over the\n"
+		"\tyear, so previews are usable early on.\n"
+		"\n"
+		"    -T --tolerance=<percent>\n"
+		"\tStop early, and extrapolate the results, once the estimate\n"
+		"\tof the yearly incidence of at least 99% of the points\n"
+		"\tchanged less than this, relative to itself, for two steps\n"
+		"\tin a row. Each step takes 1/64 of the sun samples, or less.\n"
+		"\tYearly totals are reliable, hourly results, as used by\n"
+		"\t--weather, only where many hours are summed.\n"
+		"\n"
+		"    -D --daemon=<socket>\n"
+		"\tInstead of computing, listen on the given Unix socket for\n"
+		"\tjobs, each the arguments of a run, e.g. as submitted by\n"
+		"\tresources/pylib/solmap_client.py, and run them one at a\n"
+		"\ttime, keeping the devices, with the model and receivers,\n"
+		"\tready for the next jobs on the same model and site.\n"
+		"\n"
+		"    -B --batch=<job-list>\n"
+		"\tRun the jobs listed in the file, one per line, each the\n"
+		"\targuments of a run, with quotes around arguments with\n"
+		"\tspaces. Devices and models are kept between jobs like in\n"
+		"\tthe daemon, and the model of the next job is loaded while\n"
+		"\tthe current one computes. No two jobs may write the same\n"
+		"\tfile, be it the --output, the --store, or the fixed names\n"
+		"\tof --dsm, --geotiff, --shard and the other tables. Lines\n"
+		"\tstarting with # are ignored.\n"
+		"\n"
+		"    -V --vram=<megabytes>\n"
+		"\tHow much device memory the daemon or the batch keeps\n"
+		"\tfor models of past jobs, dropping the least recently used\n"
+		"\tones first (default: 1024).\n"
+		"\n"
+		"    -F --frame-size=<pixels>\n"
+		"\tSide of the shadow maps rendered for each sun position.\n"
+		"\tLarger maps resolve smaller shadows, but take longer\n"
+		"\tand more device memory (default: 2048).\n"
+		"\n"
+		"    -I --timestep=<seconds>\n"
+		"\tLongest interval between the sun samples of each day. The\n"
+		"\tcomputation time is about proportional to the number of\n"
+		"\tsamples (default: 300).\n"
+		"\n"
+		"    -Q --accuracy=<percent>\n"
+		"\tPlan the longest timestep whose error on the yearly energy\n"
+		"\tof unshaded surfaces is estimated within the target, and,\n"
+		"\tunless --frame-size is given, a frame size that resolves\n"
+		"\tthe typical triangle of the model. Before computing, print\n"
+		"\tthe planned settings, and the estimated device memory and\n"
+		"\ttime, with fewer frames in flight if needed to fit in the\n"
+		"\tdevice memory. The time is only known for autotuned devices.\n"
+		"\n"
+		"    -A --autotune\n"
+		"\tInstead of computing, benchmark each device over a\n"
+		"\tsynthetic scene, with the given frame size, for the\n"
+		"\tnumber of frames in flight and the work group size that\n"
+		"\trender the fastest, and save them to the tuning profile,\n"
+		"\tin $XDG_CONFIG_HOME/solmap/tuning. Later runs with the\n"
+		"\tsame device, driver and frame size use them.\n"
+		"\n"
+		"    -K --cache=<megabytes>\n"
+		"\tKeep the loaded models and the computed results in a\n"
+		"\tlocal cache, in $XDG_CACHE_HOME/solmap, and reuse them\n"
+		"\twhen the same files are run with the same parameters.\n"
+		"\tThe least recently used entries are removed to keep the\n"
+		"\tcache under the given size.\n"
+		"\n"
+		"    -G --geotiff=<cell size>[:<x>:<z>]\n"
+		"\tAlso render the incidence seen from above, on the device,\n"
+		"\tinto a raster of square cells of the given size, in meters,\n"
+		"\tkeeping the highest surface, and write it as a GeoTIFF to\n"
+		"\t\"incidence.tif\". The latitude and longitude are taken to\n"
+		"\tbe at <x>:<z> of the output model (default: 0:0, which is\n"
+		"\tthe center of the bounding box of the 3-D model).\n"
+		"\n"
 		"    -q --rotation-quaternion=<w>:<x>:<y>:<z>\n"
 		"\tRotation quaternion applied to the 3-D model (default: no rotation).\n"
 		"\n"
@@ -337,6 +190,109 @@ void usage(const char *cmd)
 		"\tGiven in degrees. Calculate the energy incidence over a\n"
 		"\tsurface with the given tilt. Can be supplied multiple times.\n"
 		"\n"
+		"    -d --horizon-dem=<file>\n"
+		"\tElevation raster of the surrounding terrain, in ESRI ASCII\n"
+		"\tgrid format, with coordinates in meters. The sun is\n"
+		"\tconsidered occluded whenever it is below the horizon\n"
+		"\tprofile computed from it.\n"
+		"\n"
+		"    -p --horizon-site=<x>:<y>[:<z>]\n"
+		"\tPosition of the 3-D model in the horizon raster (default:\n"
+		"\traster center, at ground height).\n"
+		"\n"
+		"    -r --dsm\n"
+		"\tTake 3d-model as a digital surface model raster, in ESRI\n"
+		"\tASCII grid format, and compute the incidence directly over\n"
+		"\tits cells, on CPU. Output is written to \"incidence.asc\".\n"
+		"\n"
+		"    -c --point-cloud\n"
+		"\tTake 3d-model as a point cloud with normals, whose points\n"
+		"\tare both where the insolation is computed and what casts\n"
+		"\tthe shadows, without the need of a surface mesh.\n"
+		"\n"
+		"    -x --context-model=<file>\n"
+		"\t3-D model of the surroundings, which only casts shadows\n"
+		"\tover 3d-model, where the insolation is computed. It must\n"
+		"\tbe in the same coordinate system as 3d-model.\n"
+		"\n"
+		"    -l --context-lod=<size>\n"
+		"\tSimplify the context model by merging its vertices closer\n"
+		"\tthan <size>, in model units (default: no simplification).\n"
+		"\n"
+		"    -b --roi-box=<x0>:<y0>:<z0>:<x1>:<y1>:<z1>\n"
+		"\tOnly compute the insolation inside this box, given in the\n"
+		"\tcoordinates of the output model. Points outside, or left\n"
+		"\tout by the other --roi options, are not computed, and are\n"
+		"\twritten as if always in shadow: with only the diffuse\n"
+		"\tincidence, and a shadow_percentage of 100.\n"
+		"\n"
+		"    -g --roi-tilt=<min>:<max>\n"
+		"\tOnly compute the insolation where the angle between the\n"
+		"\tsurface normal and up is in this range, in degrees.\n"
+		"\n"
+		"    -n --roi-submesh=<name>\n"
+		"\tOnly compute the insolation in the named part of the 3-D\n"
+		"\tmodel. Can be supplied multiple times.\n"
+		"\n"
+		"    -k --tracker=<prefix>:single:<x>:<y>:<z>:<max>[:<gcr>]\n"
+		"    -k --tracker=<prefix>:dual:<max>\n"
+		"\tInstances whose names start with <prefix> track the sun,\n"
+		"\trotating around their origin up to <max> degrees. Single\n"
+		"\taxis trackers rotate around the axis <x>:<y>:<z>, in the\n"
+		"\taligned model frame, with backtracking if the ground\n"
+		"\tcoverage ratio <gcr> is given. Can be supplied multiple\n"
+		"\ttimes, the first match is used.\n"
+		"\n"
+		"    -v --vegetation=<prefix>:<transmittance>[:...]\n"
+		"\tInstances whose names start with <prefix> are vegetation,\n"
+		"\tletting through this fraction of the direct light. Either\n"
+		"\tone value, or one per month from January. The meshes must\n"
+		"\tbe closed crowns. Can be supplied multiple times.\n"
+		"\n"
+		"    -i --string=<prefix>\n"
+		"\tInstances whose names start with <prefix> are the panels\n"
+		"\tof a string, connected in series. Its yearly energy is\n"
+		"\treported with the mismatch losses from partial shading.\n"
+		"\tCan be supplied multiple times, one per string.\n"
+		"\n"
+		"    -j --bypass-diodes=<count>\n"
+		"\tNumber of bypass diodes per panel, each protecting one\n"
+		"\tsubstring of cells side by side (default: 3).\n"
+		"\n"
+		"    -y --weather=<file>\n"
+		"\tHourly weather of the year, in a CSV file with a header,\n"
+		"\twith the ambient temperature in column \"temp_air\" and,\n"
+		"\toptionally, wind speed in \"wind_speed\", starting at\n"
+		"\tJanuary 1st 00:00 UTC. Enables the AC yield of the strings,\n"
+		"\twritten hourly to \"pv.csv\".\n"
+		"\n"
+		"    -m --pv-module=<pdc0>[:<gamma>[:<efficiency>[:<ratio>]]]\n"
+		"\tPanel power at standard test conditions, in watts (default:\n"
+		"\t300), its temperature coefficient in %/°C (default: -0.37),\n"
+		"\tinverter nominal efficiency (default: 0.96) and DC to AC\n"
+		"\tratio (default: 1.2), for the AC yield of the strings.\n"
+		"\n"
+		"    -u --layout=<count>:<width>:<length>[:<resolution>]\n"
+		"\tFind where to place <count> panels of the given size, in\n"
+		"\tmodel units, flush over the planar surfaces of the region\n"
+		"\tof interest, with the highest incidence and without\n"
+		"\toverlapping. Surfaces are sampled in cells of <resolution>\n"
+		"\t(default: a quarter of the panel's shorter side). Output\n"
+		"\tis written to \"layout.csv\".\n"
+		"\n"
+		"    -a --panel-array=<rows>:<panels>:<width>:<length>[:<clearance>]\n"
+		"\tInstead of loading 3d-model, sweep over the variants of a\n"
+		"\tground mounted array of panel rows facing the equator,\n"
+		"\twith sizes in meters, and report the shading loss between\n"
+		"\trows for each variant. Device state is kept between them.\n"
+		"\n"
+		"    -e --sweep-tilt=<angle>[:<angle>...]\n"
+		"\tPanel tilts of the sweep, in degrees (default: latitude).\n"
+		"\n"
+		"    -w --sweep-pitch=<distance>[:<distance>...]\n"
+		"\tDistances between rows of the sweep, in meters (default:\n"
+		"\ttwice the panel length).\n"
+		"\n"
 		"Parameters:\n"
 		"    latitude\n"
 		"\tLatitde, given as degrees in decimal notation,\n"
@@ -351,7 +307,7 @@ void usage(const char *cmd)
 		"\tAssumes a right-hand coordinate system.\n"
 		"\tExpected alignment after transformations:\n"
 		"\t+y is up; -z is north; +x is east.\n";
-	exit(1);
+	throw UsageError{};
 }
 
 static real parse_real(const char* opt, const char* cmd)
@@ -366,6 +322,24 @@ static real parse_real(const char* opt, const char* cmd)
 	return val;
 }
 
+static std::vector<real> parse_real_list(const char* opt, const char* cmd,
+	size_t min_count, size_t max_count)
+{
+	std::vector<real> ret;
+	std::string val;
+	std::istringstream ss(opt);
+	while(std::getline(ss, val, ':')) {
+		ret.push_back(parse_real(val.c_str(), cmd));
+	}
+
+	if(ret.size() < min_count || ret.size() > max_count) {
+		std::cout << "Invalid number of components in \"" << opt
+			<< "\"." << std::endl;
+		usage(cmd);
+	}
+	return ret;
+}
+
 static Quat parse_quat(const char* opt, const char* cmd)
 {
 	std::regex parser{"^(.+):(.+):(.+):(.+)$"};
@@ -384,26 +358,168 @@ static Quat parse_quat(const char* opt, const char* cmd)
 	return glm::normalize(ret);
 }
 
-static void parse_args(int argc, char *argv[], Quat& rotation, real& scale,
-	real& lat, real& lon, std::string& mesh_name, real &filter_cutoff,
-	std::vector<double> &test_tilts)
+static TrackerGroup parse_tracker(const char* opt, const char* cmd)
+{
+	std::regex parser{"^(.*):(single|dual):(.+)$"};
+	std::cmatch match;
+
+	if(!std::regex_match(opt, match, parser)) {
+		std::cout << "Invalid tracker \"" << opt << "\"." << std::endl;
+		usage(cmd);
+	}
+
+	TrackerGroup ret;
+	ret.prefix = match[1].str();
+
+	const std::string params = match[3].str();
+	if(match[2].str() == "single") {
+		const auto p = parse_real_list(params.c_str(), cmd, 4, 5);
+		ret.type = TrackerGroup::SINGLE_AXIS;
+		ret.axis = Vec3{p[0], p[1], p[2]};
+		ret.max_angle = p[3];
+		ret.gcr = p.size() > 4 ? p[4] : 0.0;
+	} else {
+		const auto p = parse_real_list(params.c_str(), cmd, 1, 1);
+		ret.type = TrackerGroup::DUAL_AXIS;
+		ret.axis = Vec3{0.0, 0.0, 0.0};
+		ret.max_angle = p[0];
+	}
+	ret.max_angle *= M_PI / 180.0;
+
+	return ret;
+}
+
+static VegetationGroup parse_vegetation(const char* opt, const char* cmd)
+{
+	std::regex parser{"^(.*?):([^:]+(:[^:]+)*)$"};
+	std::cmatch match;
+
+	if(!std::regex_match(opt, match, parser)) {
+		std::cout << "Invalid vegetation \"" << opt << "\"." << std::endl;
+		usage(cmd);
+	}
+
+	const std::string values = match[2].str();
+	const auto t = parse_real_list(values.c_str(), cmd, 1, 12);
+	if(t.size() != 1 && t.size() != 12) {
+		std::cout << "Vegetation needs either 1 or 12 transmittances."
+			<< std::endl;
+		usage(cmd);
+	}
+
+	VegetationGroup ret;
+	ret.prefix = match[1].str();
+	for(uint8_t m = 0; m < 12; ++m) {
+		ret.transmittance[m] = t.size() == 1 ? t[0] : t[m];
+	}
+
+	return ret;
+}
+
+// Command line options.
+struct Options
+{
+	real lat, lon;
+	std::string mesh_name;
+	std::string output = "incidence.vtk";
+	std::string store;
+	uint32_t shard = 0;
+	uint32_t num_shards = 0;
+	bool merge = false;
+	std::vector<std::string> partials;
+	real checkpoint_interval = 0.0;
+	bool resume = false;
+	real preview_interval = 0.0;
+	real tolerance = 0.0;
+	bool cache = false;
+	real cache_size = 0.0;
+	std::string daemon;
+	std::string batch;
+	real vram = 1024.0;
+	real frame_size = ProcessorTuning{}.frame_size;
+	bool frame_size_given = false;
+	real timestep = 300.0;
+	real accuracy = 0.0;
+	bool autotune = false;
+	bool geotiff = false;
+	real geotiff_cell = 0.0;
+	Vec2 geotiff_origin{0.0f, 0.0f};
+	Quat rotation{1.0, 0.0, 0.0, 0.0};
+	real scale = 1.0;
+	real filter_cutoff = std::numeric_limits<real>::infinity();
+	std::vector<double> test_tilts;
+	std::string horizon_dem;
+	std::vector<real> horizon_site;
+	bool use_dsm = false;
+	bool point_cloud = false;
+	std::string context_model;
+	real context_lod = 0.0;
+	RegionOfInterest roi;
+	std::vector<TrackerGroup> trackers;
+	std::vector<VegetationGroup> vegetation;
+	std::vector<std::string> strings;
+	real bypass_diodes = 3;
+	std::string weather;
+	PvModel pv;
+	LayoutOptions layout;
+	bool sweep = false;
+	PanelArray array;
+	std::vector<real> sweep_tilts;
+	std::vector<real> sweep_pitches;
+};
+
+static Options parse_args(int argc, char *argv[])
 {
 	const static struct option long_options[] =
 	{
+		{"output",              required_argument, nullptr, 'o'},
+		{"store",               required_argument, nullptr, 'z'},
+		{"geotiff",             required_argument, nullptr, 'G'},
+		{"shard",               required_argument, nullptr, 'S'},
+		{"merge",               no_argument,       nullptr, 'M'},
+		{"checkpoint",          required_argument, nullptr, 'C'},
+		{"resume",              no_argument,       nullptr, 'R'},
+		{"preview",             required_argument, nullptr, 'P'},
+		{"tolerance",           required_argument, nullptr, 'T'},
+		{"cache",               required_argument, nullptr, 'K'},
+		{"daemon",              required_argument, nullptr, 'D'},
+		{"batch",               required_argument, nullptr, 'B'},
+		{"vram",                required_argument, nullptr, 'V'},
+		{"frame-size",          required_argument, nullptr, 'F'},
+		{"autotune",            no_argument,       nullptr, 'A'},
+		{"timestep",            required_argument, nullptr, 'I'},
+		{"accuracy",            required_argument, nullptr, 'Q'},
 		{"rotation-quaternion", required_argument, nullptr, 'q'},
 		{"scale",               required_argument, nullptr, 's'},
 		{"fine-pass-filter",	required_argument, nullptr, 'f'},
 		{"test-tilt",           required_argument, nullptr, 't'},
+		{"horizon-dem",         required_argument, nullptr, 'd'},
+		{"horizon-site",        required_argument, nullptr, 'p'},
+		{"dsm",                 no_argument,       nullptr, 'r'},
+		{"point-cloud",         no_argument,       nullptr, 'c'},
+		{"context-model",       required_argument, nullptr, 'x'},
+		{"context-lod",         required_argument, nullptr, 'l'},
+		{"roi-box",             required_argument, nullptr, 'b'},
+		{"roi-tilt",            required_argument, nullptr, 'g'},
+		{"roi-submesh",         required_argument, nullptr, 'n'},
+		{"tracker",             required_argument, nullptr, 'k'},
+		{"vegetation",          required_argument, nullptr, 'v'},
+		{"string",              required_argument, nullptr, 'i'},
+		{"bypass-diodes",       required_argument, nullptr, 'j'},
+		{"weather",             required_argument, nullptr, 'y'},
+		{"pv-module",           required_argument, nullptr, 'm'},
+		{"layout",              required_argument, nullptr, 'u'},
+		{"panel-array",         required_argument, nullptr, 'a'},
+		{"sweep-tilt",          required_argument, nullptr, 'e'},
+		{"sweep-pitch",         required_argument, nullptr, 'w'},
 		{nullptr, 0, nullptr, 0}
 	};
 
-	rotation = Quat(1.0, 0.0, 0.0, 0.0);
-	scale = 1.0;
-	filter_cutoff = std::numeric_limits<real>::infinity();
+	Options o;
 
 	opterr = 0;
 	for(;;) {
-		int opt = getopt_long (argc, argv, "+q:s:f:t:",
+		int opt = getopt_long (argc, argv, "+o:z:G:S:MC:RP:T:K:D:B:V:F:AI:Q:q:s:f:t:d:p:rcx:l:b:g:n:k:v:i:j:y:m:u:a:e:w:",
 			long_options, nullptr);
 
 		if(opt == -1) {
@@ -411,17 +527,181 @@ static void parse_args(int argc, char *argv[], Quat& rotation, real& scale,
 		}
 
 		switch(opt) {
+		case 'o':
+			o.output = optarg;
+			break;
+		case 'z':
+			o.store = optarg;
+			break;
+		case 'S': {
+			unsigned shard, num_shards;
+			char end;
+			if(std::sscanf(optarg, "%u/%u%c", &shard, &num_shards,
+				&end) != 2 || num_shards == 0)
+			{
+				std::cout << "Invalid shard \"" << optarg
+					<< "\"." << std::endl;
+				usage(argv[0]);
+			}
+			o.shard = shard;
+			o.num_shards = num_shards;
+			break;
+		}
+		case 'M':
+			o.merge = true;
+			break;
+		case 'C':
+			o.checkpoint_interval = parse_real(optarg, argv[0]);
+			break;
+		case 'R':
+			o.resume = true;
+			break;
+		case 'P':
+			o.preview_interval = parse_real(optarg, argv[0]);
+			break;
+		case 'T':
+			o.tolerance = parse_real(optarg, argv[0]);
+			break;
+		case 'D':
+			o.daemon = optarg;
+			break;
+		case 'B':
+			o.batch = optarg;
+			break;
+		case 'V':
+			o.vram = parse_real(optarg, argv[0]);
+			break;
+		case 'F':
+			o.frame_size = parse_real(optarg, argv[0]);
+			o.frame_size_given = true;
+			break;
+		case 'A':
+			o.autotune = true;
+			break;
+		case 'I':
+			o.timestep = parse_real(optarg, argv[0]);
+			break;
+		case 'Q':
+			o.accuracy = parse_real(optarg, argv[0]);
+			break;
+		case 'K':
+			o.cache = true;
+			o.cache_size = parse_real(optarg, argv[0]);
+			break;
+		case 'G': {
+			const auto g = parse_real_list(optarg, argv[0], 1, 3);
+			o.geotiff = true;
+			o.geotiff_cell = g[0];
+			if(g.size() > 1) {
+				o.geotiff_origin.x = g[1];
+				o.geotiff_origin.y = g.size() > 2 ? g[2] : 0.0;
+			}
+			break;
+		}
 		case 'q':
-			rotation = parse_quat(optarg, argv[0]);
+			o.rotation = parse_quat(optarg, argv[0]);
 			break;
 		case 's':
-			scale = parse_real(optarg, argv[0]);
+			o.scale = parse_real(optarg, argv[0]);
 			break;
 		case 'f':
-			filter_cutoff = parse_real(optarg, argv[0]);
+			o.filter_cutoff = parse_real(optarg, argv[0]);
 			break;
 		case 't':
-			test_tilts.push_back(parse_real(optarg, argv[0]));
+			o.test_tilts.push_back(parse_real(optarg, argv[0]));
+			break;
+		case 'd':
+			o.horizon_dem = optarg;
+			break;
+		case 'p':
+			o.horizon_site = parse_real_list(optarg, argv[0], 2, 3);
+			break;
+		case 'r':
+			o.use_dsm = true;
+			break;
+		case 'c':
+			o.point_cloud = true;
+			break;
+		case 'x':
+			o.context_model = optarg;
+			break;
+		case 'l':
+			o.context_lod = parse_real(optarg, argv[0]);
+			break;
+		case 'b': {
+			const auto box = parse_real_list(optarg, argv[0], 6, 6);
+			o.roi.has_box = true;
+			o.roi.box_lo = Vec3{box[0], box[1], box[2]};
+			o.roi.box_hi = Vec3{box[3], box[4], box[5]};
+			break;
+		}
+		case 'g': {
+			const auto tilt = parse_real_list(optarg, argv[0], 2, 2);
+			o.roi.min_tilt = tilt[0];
+			o.roi.max_tilt = tilt[1];
+			break;
+		}
+		case 'n':
+			o.roi.submeshes.push_back(optarg);
+			break;
+		case 'k':
+			o.trackers.push_back(parse_tracker(optarg, argv[0]));
+			break;
+		case 'v':
+			o.vegetation.push_back(parse_vegetation(optarg, argv[0]));
+			break;
+		case 'i':
+			o.strings.push_back(optarg);
+			break;
+		case 'j':
+			o.bypass_diodes = parse_real(optarg, argv[0]);
+			break;
+		case 'y':
+			o.weather = optarg;
+			break;
+		case 'u': {
+			const auto l = parse_real_list(optarg, argv[0], 3, 4);
+			o.layout.count = l[0];
+			o.layout.width = l[1];
+			o.layout.length = l[2];
+			if(l.size() > 3) {
+				o.layout.resolution = l[3];
+			}
+			break;
+		}
+		case 'm': {
+			const auto m = parse_real_list(optarg, argv[0], 1, 4);
+			o.pv.pdc0 = m[0];
+			if(m.size() > 1) {
+				o.pv.gamma = m[1] * 0.01;
+			}
+			if(m.size() > 2) {
+				o.pv.inverter_efficiency = m[2];
+			}
+			if(m.size() > 3) {
+				o.pv.dc_ac_ratio = m[3];
+			}
+			break;
+		}
+		case 'a': {
+			const auto a = parse_real_list(optarg, argv[0], 4, 5);
+			o.sweep = true;
+			o.array.rows = a[0];
+			o.array.panels_per_row = a[1];
+			o.array.panel_width = a[2];
+			o.array.panel_length = a[3];
+			if(a.size() > 4) {
+				o.array.clearance = a[4];
+			}
+			break;
+		}
+		case 'e':
+			o.sweep_tilts = parse_real_list(optarg, argv[0], 1,
+				std::numeric_limits<size_t>::max());
+			break;
+		case 'w':
+			o.sweep_pitches = parse_real_list(optarg, argv[0], 1,
+				std::numeric_limits<size_t>::max());
 			break;
 		default:
 			goto out;
@@ -429,43 +709,255 @@ static void parse_args(int argc, char *argv[], Quat& rotation, real& scale,
 	}
 	out:
 
-	if(argc - optind < 3)
+	if(o.frame_size < 16.0 || o.frame_size > 65536.0
+		|| o.frame_size != std::floor(o.frame_size))
+	{
+		std::cout << "Error: Frame size must be a whole number of pixels, from 16 to 65536." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.autotune) {
+		if(!o.daemon.empty() || !o.batch.empty()) {
+			std::cout << "Error: Autotune is a mode of its own." << std::endl;
+			usage(argv[0]);
+		}
+		return o;
+	}
+
+	// Jobs bring their own arguments.
+	if(!o.daemon.empty() || !o.batch.empty()) {
+		if(!o.daemon.empty() && !o.batch.empty()) {
+			std::cout << "Error: Daemon and batch are different modes." << std::endl;
+			usage(argv[0]);
+		}
+		if(o.vram <= 0.0) {
+			std::cout << "Error: Device memory budget must be positive." << std::endl;
+			usage(argv[0]);
+		}
+		return o;
+	}
+
+	if(argc - optind < (o.sweep ? 2 : 3))
 	{
 		std::cout << "Error: Missing arguments." << std::endl;
 		usage(argv[0]);
 	}
 
-	if(filter_cutoff <= 0.0) {
+	if(o.filter_cutoff <= 0.0) {
 		std::cout << "Error: Fine pass filter factor must be greater than 0." << std::endl;
 		usage(argv[0]);
 	}
 
-	lat = parse_real(argv[optind], argv[0]);
-	lon = parse_real(argv[optind+1], argv[0]);
-	mesh_name = argv[optind+2];
-}
+	if(o.timestep <= 0.0) {
+		std::cout << "Error: Timestep must be positive." << std::endl;
+		usage(argv[0]);
+	}
 
-// Golden section method, straight from Wikipedia page:
-template<class F, class T>
-auto maximize(const F& func, T lo, T hi, size_t iters)
-{
-	// Inverse golden ratio
-	static const double phi = 2.0 / (1.0 + std::sqrt(5.0));
+	if(o.accuracy < 0.0) {
+		std::cout << "Error: Accuracy must not be negative." << std::endl;
+		usage(argv[0]);
+	}
 
-	T a = lo;
-	auto af = func(a);
+	if(o.context_lod < 0.0) {
+		std::cout << "Error: Context LOD must not be negative." << std::endl;
+		usage(argv[0]);
+	}
 
-	T b = hi;
-	auto bf = func(b);
+	for(const auto& t: o.trackers) {
+		if(t.max_angle < 0.0 || t.gcr < 0.0 || t.gcr > 1.0) {
+			std::cout << "Error: Tracker angle must not be negative, and ground coverage ratio must be in [0, 1]." << std::endl;
+			usage(argv[0]);
+		}
+	}
 
-	T c = b - (b - a) * phi;
-	auto cf = func(c);
+	for(const auto& v: o.vegetation) {
+		for(real t: v.transmittance) {
+			if(t < 0.0 || t > 1.0) {
+				std::cout << "Error: Vegetation transmittance must be in [0, 1]." << std::endl;
+				usage(argv[0]);
+			}
+		}
+	}
 
-	T d = a + (b - a) * phi;
-	auto df = func(d);
+	if(o.bypass_diodes < 1 || o.bypass_diodes != std::floor(o.bypass_diodes)) {
+		std::cout << "Error: Number of bypass diodes must be a positive integer." << std::endl;
+		usage(argv[0]);
+	}
 
-	for (size_t i = 0; i < iters; ++i) {
-        	if(cf > df) {
+	if(!o.weather.empty() && o.strings.empty()) {
+		std::cout << "Error: Weather is only used for the yield of strings." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.pv.pdc0 <= 0.0 || o.pv.inverter_efficiency <= 0.0
+		|| o.pv.inverter_efficiency > 1.0 || o.pv.dc_ac_ratio <= 0.0)
+	{
+		std::cout << "Error: Panel power and DC to AC ratio must be positive, and inverter efficiency in (0, 1]." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.layout.count && (o.layout.width <= 0.0
+		|| o.layout.length <= 0.0 || o.layout.resolution < 0.0))
+	{
+		std::cout << "Error: Layout panels must have positive size." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.num_shards || o.merge) {
+		if(o.sweep || o.use_dsm) {
+			std::cout << "Error: Shards are only computed from 3-D models." << std::endl;
+			usage(argv[0]);
+		}
+		if(o.num_shards && o.merge) {
+			std::cout << "Error: A shard can't be computed while merging." << std::endl;
+			usage(argv[0]);
+		}
+	}
+
+	if(o.checkpoint_interval < 0.0) {
+		std::cout << "Error: Checkpoint interval must not be negative." << std::endl;
+		usage(argv[0]);
+	}
+
+	if((o.checkpoint_interval > 0.0 || o.resume)
+		&& (o.sweep || o.use_dsm || o.merge))
+	{
+		std::cout << "Error: Only computations of 3-D models are checkpointed." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.preview_interval < 0.0 || o.tolerance < 0.0) {
+		std::cout << "Error: Preview interval and tolerance must not be negative." << std::endl;
+		usage(argv[0]);
+	}
+
+	if((o.preview_interval > 0.0 || o.tolerance > 0.0)
+		&& (o.sweep || o.use_dsm || o.merge || o.num_shards))
+	{
+		std::cout << "Error: Only whole runs on 3-D models are previewed or stopped early." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.cache && o.cache_size <= 0.0) {
+		std::cout << "Error: Cache size must be positive." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.cache && (o.sweep || o.use_dsm || o.merge)) {
+		std::cout << "Error: Only computations of 3-D models are cached." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.num_shards && o.shard >= o.num_shards) {
+		std::cout << "Error: Shard index must be less than the number of shards." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.merge && o.geotiff) {
+		std::cout << "Error: GeoTIFF needs the device, so it can't be rendered while merging." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.geotiff && o.geotiff_cell <= 0.0) {
+		std::cout << "Error: Raster cell size must be positive." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.geotiff && (o.sweep || o.use_dsm)) {
+		std::cout << "Error: GeoTIFF is only rendered from 3-D models." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.sweep && !o.strings.empty()) {
+		std::cout << "Error: Strings can't be used with the panel array sweep." << std::endl;
+		usage(argv[0]);
+	}
+
+	// The sweep builds its own model, and only writes its table.
+	if(o.sweep && (!o.trackers.empty() || !o.vegetation.empty()
+		|| o.rotation != Quat{1.0, 0.0, 0.0, 0.0} || o.scale != 1.0
+		|| o.roi.has_box || o.roi.min_tilt != 0.0
+		|| o.roi.max_tilt != 180.0 || !o.roi.submeshes.empty()
+		|| !o.context_model.empty() || o.context_lod != 0.0
+		|| o.output != "incidence.vtk" || !o.store.empty()
+		|| o.layout.count || o.use_dsm || o.point_cloud
+		|| o.filter_cutoff != std::numeric_limits<real>::infinity()))
+	{
+		std::cout << "Error: Options of the 3-D model and its outputs can't be used with the panel array sweep." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.sweep && (o.array.rows < 1 || o.array.panels_per_row < 1
+		|| o.array.panel_width <= 0.0 || o.array.panel_length <= 0.0))
+	{
+		std::cout << "Error: Panel array must have panels of positive size." << std::endl;
+		usage(argv[0]);
+	}
+
+	for(real p: o.sweep_pitches) {
+		if(p < o.array.panel_length) {
+			std::cout << "Error: Row pitch must not be less than the panel length." << std::endl;
+			usage(argv[0]);
+		}
+	}
+
+	if(o.point_cloud && !o.vegetation.empty()) {
+		std::cout << "Error: Vegetation can't be used with point clouds." << std::endl;
+		usage(argv[0]);
+	}
+
+	if(o.point_cloud && !o.context_model.empty()) {
+		std::cout << "Error: Context model can't be used with point clouds." << std::endl;
+		usage(argv[0]);
+	}
+
+	o.lat = parse_real(argv[optind], argv[0]);
+	o.lon = parse_real(argv[optind+1], argv[0]);
+	if(!o.sweep) {
+		o.mesh_name = argv[optind+2];
+		if(o.merge) {
+			o.partials.assign(argv + optind + 3, argv + argc);
+			if(o.partials.empty()) {
+				std::cout << "Error: Missing partial result files to merge." << std::endl;
+				usage(argv[0]);
+			}
+		}
+		return o;
+	}
+
+	// Panels face the equator.
+	o.array.facing_north = o.lat < 0.0;
+	if(o.sweep_tilts.empty()) {
+		o.sweep_tilts.push_back(std::abs(o.lat));
+	}
+	if(o.sweep_pitches.empty()) {
+		o.sweep_pitches.push_back(2.0 * o.array.panel_length);
+	}
+
+	return o;
+}
+
+// Golden section method, straight from Wikipedia page:
+template<class F, class T>
+auto maximize(const F& func, T lo, T hi, size_t iters)
+{
+	// Inverse golden ratio
+	static const double phi = 2.0 / (1.0 + std::sqrt(5.0));
+
+	T a = lo;
+	auto af = func(a);
+
+	T b = hi;
+	auto bf = func(b);
+
+	T c = b - (b - a) * phi;
+	auto cf = func(c);
+
+	T d = a + (b - a) * phi;
+	auto df = func(d);
+
+	for (size_t i = 0; i < iters; ++i) {
+        	if(cf > df) {
 			b = d;
 			bf = df;
 
@@ -489,72 +981,29 @@ auto maximize(const F& func, T lo, T hi, size_t iters)
 	return cf > df ? std::make_pair(c, cf) : std::make_pair(d, df);
 }
 
-int main(int argc, char *argv[])
+// Sums of the solar data over all processors.
+struct Totals
 {
-	std::ios_base::sync_with_stdio(false);
-
-	real lat, lon;
-	std::string mesh_name;
-	Quat rotation;
-	real scale;
-	real filter_cutoff;
-	std::vector<double> test_tilts;
-
-	parse_args(argc, argv, rotation, scale, lat, lon, mesh_name, filter_cutoff, test_tilts);
-
-	UVkInstance vk = initialize_vulkan();
-
-	std::vector<std::unique_ptr<ShadowProcessor>> ps;
-	Mesh test_mesh = load_scene(mesh_name, rotation, scale, filter_cutoff);
-	{
-		auto shadow_mesh = test_mesh;
-		//refine(test_mesh, 0.05);
-		std::cout << "Mesh size:\n    Vertices: " << test_mesh.vertices.size()
-			<< " (" << test_mesh.vertices.size()
-			* sizeof(decltype(test_mesh.vertices)::value_type)
-			/ 1024.0 / 1024.0 << " MB)\n    Indices: "
-			<< test_mesh.indices.size() << " (" << test_mesh.vertices.size()
-			* sizeof(decltype(test_mesh.indices)::value_type) / 1024.0 / 1024.0
-			<< " MB)" << std::endl;
-
-		ps = create_procs_from_devices(vk.get(),
-			shadow_mesh, test_mesh.vertices);
-	}
-
-	// TODO: take as command line input:
-	const Vec3 unit_north{0, 0, -1};
-	const Vec3 unit_up{0, 1, 0};
-	const Vec3 unit_east{1, 0, 0};
-	auto solar_data = calculate_yearly_incidence(lat, lon, 0,
-		unit_north, unit_up, unit_east, ps);
-
-	// Get results:
-	std::vector<Vec3> dir_energy(test_mesh.vertices.size(), Vec3{0.0f, 0.0f, 0.0f});
 	Vec3 dir_total{0.0, 0.0, 0.0};
 	double dif_total = 0.0;
 	double suntime = 0.0;
-
 	size_t count = 0;
-	for(auto &p: ps) {
-		dir_total += p->get_directional_sum();
-		dif_total += p->get_diffuse_sum();
-		suntime += p->get_time_sum();
-
-		count += p->get_process_count();
-		p->accumulate_result(dir_energy.data());
-	}
-	const float icount = 1.0f / count;
 
-	// Convert from j/m² to kWh/m²
-	const double j2kwh = 1.0 / 3600.0 / 1000.0;
-	const double dif_total_kwh = dif_total * j2kwh;
-	const double dir_total_kwh = glm::length(dir_total) * j2kwh;
-	for(Vec3 &r: dir_energy) {
-		r *= j2kwh;
+	template<class Processor>
+	void add(const Processor& p)
+	{
+		dir_total += p.get_directional_sum();
+		dif_total += p.get_diffuse_sum();
+		suntime += p.get_time_sum();
+		count += p.get_process_count();
 	}
+};
 
-	dump_vtk("incidence.vtk", test_mesh, scale,
-		dif_total_kwh, dir_total_kwh, dir_energy.data());
+template<class Processor>
+static void print_workload(
+	const std::vector<std::unique_ptr<Processor>> &ps, size_t count)
+{
+	const float icount = 1.0f / count;
 
 	std::cout << "Workload distribution:\n";
 	for(size_t i = 0; i < ps.size(); ++i) {
@@ -563,13 +1012,21 @@ int main(int argc, char *argv[])
 			<< '/' << count << " (" << lc * icount * 100.0f
 			<< "%)\n";
 	}
+}
+
+static void report(const std::vector<Vec3>& solar_data, const Totals& totals,
+	real lat, real lon, const std::vector<double>& test_tilts,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east)
+{
+	// Convert from j/m² to kWh/m²
+	const double j2kwh = 1.0 / 3600.0 / 1000.0;
 
 	// Find the best placement angle with a maximization method:
 	auto energy_calc = [&](double alt) {
 		AngularPosition pos {.az=0.0, .alt=M_PI*0.5 - alt};
 		const Vec3 best = to_vec(pos, unit_north, unit_up, unit_east);
 
-		double energy_at_best = dif_total;
+		double energy_at_best = totals.dif_total;
 		for(auto& sun: solar_data) {
 			energy_at_best += std::max(0.0f, dot(sun, best));
 		}
@@ -585,7 +1042,7 @@ int main(int argc, char *argv[])
 	}
 
 	std::cout << "\nReport:\n"
-		" - Total daytime over year: " << suntime / 3600.0 << " hours\n"
+		" - Total daytime over year: " << totals.suntime / 3600.0 << " hours\n"
 		" - Best placement for latitude "
 		<< lat << " and longitude " << lon
 		<< " is:\n"
@@ -602,3 +1059,1408 @@ int main(int argc, char *argv[])
 		}
 	}
 }
+
+// Prints and writes to strings.csv the yearly energy of each string,
+// per area of panel, with and without the mismatch between substrings.
+static void report_strings(const StringLayout& strings,
+	const std::vector<Vec2>& energy, double dif_total_kwh)
+{
+	// Convert from j/m² to kWh/m²
+	const double j2kwh = 1.0 / 3600.0 / 1000.0;
+
+	std::ofstream csv("strings.csv");
+	csv << "string,panels,kwh_m2,ideal_kwh_m2,mismatch_loss\n";
+
+	std::cout << "\nStrings (kWh/m² of panel):\n";
+	for(size_t i = 0; i < energy.size(); ++i) {
+		// The diffuse light is the same over every substring,
+		// so it is not subject to mismatch.
+		const double inv = 1.0 / strings.strings[i].count;
+		const double actual = energy[i].x * inv * j2kwh
+			+ dif_total_kwh;
+		const double ideal = energy[i].y * inv * j2kwh
+			+ dif_total_kwh;
+		const double loss = ideal > 0.0 ? 1.0 - actual / ideal : 0.0;
+
+		std::cout << " - " << strings.names[i] << ": "
+			<< strings.panel_count[i] << " panels, " << actual
+			<< " (" << ideal << " without mismatch, "
+			<< loss * 100.0 << "% loss)\n";
+		csv << strings.names[i] << ',' << strings.panel_count[i]
+			<< ',' << actual << ',' << ideal << ',' << loss << '\n';
+	}
+	std::cout << "Table written to strings.csv." << std::endl;
+}
+
+// Evaluates the PV model over the hourly energy of the strings, prints
+// the yearly AC yield of each, and writes the hourly yield to pv.csv.
+static void report_pv(const StringLayout& strings,
+	const std::vector<float>& hourly,
+	const std::vector<InstantaneousData>& suns,
+	const Weather& weather, const PvModel& pv)
+{
+	// The diffuse light is the same over every string.
+	std::vector<double> diffuse(HOURS_PER_YEAR, 0.0);
+	for(const auto& val: suns) {
+		diffuse[val.hour] += val.coefficient * val.indirect_power;
+	}
+
+	// Mean irradiance of each hour, in W/m², from the energy
+	// summed over the substrings, in J/m².
+	std::vector<float> poa(hourly.size());
+	for(size_t i = 0; i < strings.strings.size(); ++i) {
+		const double inv = 1.0 / strings.strings[i].count;
+		for(uint32_t h = 0; h < HOURS_PER_YEAR; ++h) {
+			const size_t idx = i * HOURS_PER_YEAR + h;
+			poa[idx] = (hourly[idx] * inv + diffuse[h]) / 3600.0;
+		}
+	}
+
+	const PvYield y = evaluate_pv(pv, weather, poa, strings.panel_count,
+		std::max(1u, std::thread::hardware_concurrency()));
+
+	std::cout << "\nAC yield over the year:\n";
+	for(size_t i = 0; i < strings.strings.size(); ++i) {
+		std::cout << " - " << strings.names[i] << ": "
+			<< y.annual_ac[i] << " kWh ("
+			<< y.annual_ac[i] / (strings.panel_count[i] * pv.pdc0
+				* 0.001)
+			<< " kWh/kWp)\n";
+	}
+
+	std::ofstream csv("pv.csv");
+	csv << "hour";
+	for(const auto& name: strings.names) {
+		csv << ',' << name;
+	}
+	csv << '\n';
+	for(uint32_t h = 0; h < HOURS_PER_YEAR; ++h) {
+		csv << h;
+		for(size_t i = 0; i < strings.strings.size(); ++i) {
+			csv << ',' << y.hourly_ac[i * HOURS_PER_YEAR + h];
+		}
+		csv << '\n';
+	}
+	std::cout << "Hourly AC energy, in Wh, written to pv.csv."
+		<< std::endl;
+}
+
+// Places the panels over the incidence field, prints
+// the placement and writes it to layout.csv.
+static void report_layout(const Mesh& mesh, real scale, const Vec3& unit_up,
+	const std::vector<Vec4>& dir_energy, double dif_total_kwh,
+	const std::vector<uint32_t>& selected_indices,
+	const LayoutOptions& opts)
+{
+	std::vector<float> incidence(dir_energy.size());
+	for(size_t i = 0; i < dir_energy.size(); ++i) {
+		incidence[i] = dif_total_kwh + dir_energy[i].w;
+	}
+
+	std::vector<bool> selected(dir_energy.size(), false);
+	for(uint32_t i: selected_indices) {
+		selected[i] = true;
+	}
+
+	const LayoutResult r = optimize_layout(mesh, scale, unit_up,
+		incidence, selected, opts);
+
+	const double area = opts.width * opts.length;
+	double total = 0.0;
+
+	std::ofstream csv("layout.csv");
+	csv << "panel,facet,x,y,z,width_x,width_y,width_z,"
+		"length_x,length_y,length_z,kwh_m2,kwh\n";
+	for(size_t i = 0; i < r.placements.size(); ++i) {
+		const Placement& p = r.placements[i];
+		total += p.incidence * area;
+		csv << i << ',' << p.facet << ','
+			<< p.center.x << ',' << p.center.y << ','
+			<< p.center.z << ',' << p.width_dir.x << ','
+			<< p.width_dir.y << ',' << p.width_dir.z << ','
+			<< p.length_dir.x << ',' << p.length_dir.y << ','
+			<< p.length_dir.z << ',' << p.incidence << ','
+			<< p.incidence * area << '\n';
+	}
+
+	std::cout << "\nLayout:\n"
+		" - Planar facets: " << r.facets << "\n"
+		" - Candidate positions: " << r.candidates << " ("
+		<< r.candidates / std::max(r.evaluation_time, 1e-9)
+		<< " per second)\n"
+		" - Panels placed: " << r.placements.size() << " of "
+		<< opts.count << "\n";
+	if(!r.placements.empty()) {
+		std::cout << " - Incidence per panel: "
+			<< r.placements.front().incidence << " to "
+			<< r.placements.back().incidence << " kWh/m²\n"
+			" - Total over the panels: " << total << " kWh\n";
+	}
+	std::cout << "Placements written to layout.csv." << std::endl;
+}
+
+// Renders the incidence seen from above, into cells aligned to the
+// origin, which is where the given latitude and longitude are in the
+// output model, and writes it to incidence.tif.
+static void export_geotiff(ShadowProcessor& p, const Mesh& mesh,
+	real scale, const std::vector<Vec4>& dir_energy, double dif_total_kwh,
+	double lat, double lon, real cell_size, const Vec2& origin)
+{
+	// Horizontal extent of the model, splats included.
+	const real inf = std::numeric_limits<real>::infinity();
+	real west = inf, east = -inf, north = inf, south = -inf;
+	for(size_t i = 0; i < mesh.vertices.size(); ++i) {
+		const Vec3 pos = scale * mesh.vertices[i].position;
+		const real r = mesh.is_point_cloud()
+			? scale * mesh.splat_radius[i] : 0.0f;
+		west = std::min(west, pos.x - r);
+		east = std::max(east, pos.x + r);
+		north = std::min(north, pos.z - r);
+		south = std::max(south, pos.z + r);
+	}
+
+	TopDownGrid grid;
+	grid.cell_size = cell_size;
+	grid.west = origin.x
+		+ std::floor((west - origin.x) / cell_size) * cell_size;
+	grid.north = origin.y
+		+ std::floor((north - origin.y) / cell_size) * cell_size;
+	grid.cols = std::max(1.0f, std::ceil((east - grid.west) / cell_size));
+	grid.rows = std::max(1.0f, std::ceil((south - grid.north) / cell_size));
+
+	std::vector<float> incidence(dir_energy.size());
+	for(size_t i = 0; i < dir_energy.size(); ++i) {
+		incidence[i] = dif_total_kwh + dir_energy[i].w;
+	}
+
+	// In the raster, y grows northwards, from the origin.
+	HeightRaster raster;
+	raster.cols = grid.cols;
+	raster.rows = grid.rows;
+	raster.cell_size = cell_size;
+	raster.x0 = grid.west - origin.x;
+	raster.y0 = origin.y - (grid.north + grid.rows * cell_size);
+
+	const auto values = p.render_top_down(mesh, scale, incidence, grid,
+		raster.nodata);
+	save_geotiff("incidence.tif", raster, values, lat, lon);
+
+	std::cout << "Raster of " << grid.cols << " by " << grid.rows
+		<< " cells written to incidence.tif." << std::endl;
+}
+
+// Hash of everything the loaded models depend on.
+static uint64_t scene_key(const Options& o)
+{
+	Hasher h;
+	h.add(ENGINE_VERSION);
+	h.add_file(o.mesh_name);
+	h.add(o.point_cloud);
+	h.add(o.rotation);
+	h.add(o.scale);
+	h.add(o.filter_cutoff);
+	h.add(o.context_model.empty());
+	if(!o.context_model.empty()) {
+		h.add_file(o.context_model);
+		h.add(o.context_lod);
+	}
+	return h.get();
+}
+
+// Hash of everything the receivers and the processors depend on,
+// besides the models.
+static uint64_t setup_key(const Options& o, uint64_t scene)
+{
+	Hasher h;
+	h.add(scene);
+	h.add(o.lat);
+	h.add(o.lon);
+
+	h.add(o.horizon_dem.empty());
+	if(!o.horizon_dem.empty()) {
+		h.add_file(o.horizon_dem);
+		h.add(uint64_t(o.horizon_site.size()));
+		for(real v: o.horizon_site) {
+			h.add(v);
+		}
+	}
+
+	h.add(o.roi.has_box);
+	if(o.roi.has_box) {
+		h.add(o.roi.box_lo);
+		h.add(o.roi.box_hi);
+	}
+	h.add(o.roi.min_tilt);
+	h.add(o.roi.max_tilt);
+	h.add(uint64_t(o.roi.submeshes.size()));
+	for(const auto& name: o.roi.submeshes) {
+		h.add(name);
+	}
+
+	h.add(uint64_t(o.trackers.size()));
+	for(const auto& t: o.trackers) {
+		h.add(t.prefix);
+		h.add(t.type);
+		h.add(t.axis);
+		h.add(t.max_angle);
+		h.add(t.gcr);
+	}
+
+	h.add(uint64_t(o.vegetation.size()));
+	for(const auto& v: o.vegetation) {
+		h.add(v.prefix);
+		h.add(v.transmittance);
+	}
+
+	h.add(uint64_t(o.strings.size()));
+	for(const auto& prefix: o.strings) {
+		h.add(prefix);
+	}
+	h.add(o.bypass_diodes);
+	h.add(o.frame_size);
+	h.add(o.frame_size_given);
+	h.add(o.timestep);
+	h.add(o.accuracy);
+	return h.get();
+}
+
+// Hash of everything the results of every shard of a run depend on,
+// which identifies the run in the partial results.
+static uint64_t run_key(const Options& o, uint64_t scene)
+{
+	Hasher h;
+	h.add(setup_key(o, scene));
+	h.add(o.tolerance);
+	return h.get();
+}
+
+// Hash of everything the results depend on, besides the models.
+static uint64_t result_key(const Options& o, uint64_t scene)
+{
+	Hasher h;
+	h.add(run_key(o, scene));
+	h.add(o.shard);
+	h.add(o.num_shards);
+	return h.get();
+}
+
+// Directional energy of every vertex of the mesh, in kWh/m², scattered
+// back from the selected receivers, with zero on the ones left out.
+static std::vector<Vec4> scatter_energy(size_t num_vertices,
+	const std::vector<uint32_t>& indices, const PartialResult& r)
+{
+	const double j2kwh = 1.0 / 3600.0 / 1000.0;
+
+	std::vector<Vec4> ret(num_vertices, Vec4{0.0f, 0.0f, 0.0f, 0.0f});
+	for(size_t i = 0; i < indices.size(); ++i) {
+		ret[indices[i]] = r.energy[i] * float(j2kwh);
+	}
+	return ret;
+}
+
+// Writes the incidence from the partial results, as a preview.
+static void write_estimate(const std::string& fname, const Mesh& mesh,
+	real scale, const std::vector<uint32_t>& indices,
+	const PartialResult& estimate)
+{
+	const double j2kwh = 1.0 / 3600.0 / 1000.0;
+
+	const auto dir_energy = scatter_energy(mesh.vertices.size(),
+		indices, estimate);
+	write_vtk(fname, mesh, scale, estimate.diffuse_sum * j2kwh,
+		glm::length(estimate.directional_sum) * j2kwh,
+		dir_energy.data(),
+		std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Tells when the estimate of the yearly incidence of the points, from
+// the stratified samples processed so far, stops changing.
+class Convergence
+{
+public:
+	Convergence(double tolerance):
+		tolerance(tolerance)
+	{}
+
+	// Takes the results after another step, extrapolated to all the
+	// samples, and returns whether it has converged.
+	bool update(const PartialResult& estimate)
+	{
+		std::vector<double> current(estimate.energy.size());
+		for(size_t i = 0; i < current.size(); ++i) {
+			current[i] = estimate.diffuse_sum + estimate.energy[i].w;
+		}
+
+		if(!last.empty()) {
+			size_t within = 0;
+			for(size_t i = 0; i < current.size(); ++i) {
+				const double change = std::abs(current[i] - last[i])
+					/ std::max(std::abs(current[i]), 1e-9);
+				within += change < tolerance;
+			}
+			const double ratio = double(within)
+				/ std::max(size_t(1), current.size());
+			stable_steps = ratio >= 0.99 ? stable_steps + 1 : 0;
+
+			std::cout << "    " << std::fixed << std::setprecision(1)
+				<< ratio * 100.0 << "% of points within tolerance."
+				<< std::defaultfloat << std::endl;
+		}
+		last = std::move(current);
+
+		return stable_steps >= 2;
+	}
+
+private:
+	double tolerance;
+	std::vector<double> last;
+	unsigned stable_steps = 0;
+};
+
+// Sums the partial results in the files, which must be every shard
+// of the run described by ret, each exactly once, into ret.
+static void merge_partials(const std::vector<std::string>& files,
+	PartialResult& ret)
+{
+	std::vector<bool> merged;
+	for(const auto& f: files) {
+		const PartialResult p = load_partial_result(f);
+		if(p.run != ret.run) {
+			throw std::runtime_error("\"" + f + "\" is of a run with "
+				"other options or models.\n");
+		}
+		if(merged.empty()) {
+			ret.num_shards = p.num_shards;
+			merged.resize(p.num_shards, false);
+		}
+
+		ret.add(p);
+		if(merged[p.shard]) {
+			throw std::runtime_error("Shard " + std::to_string(p.shard)
+				+ " was given more than once.\n");
+		}
+		merged[p.shard] = true;
+	}
+
+	for(uint32_t i = 0; i < merged.size(); ++i) {
+		if(!merged[i]) {
+			throw std::runtime_error("Shard " + std::to_string(i)
+				+ " of " + std::to_string(merged.size())
+				+ " is missing.\n");
+		}
+	}
+}
+
+// Computes every variant of the panel array, only replacing
+// the placement of the panels between them.
+static void run_sweep(const Options& o,
+	const std::vector<InstantaneousData>& suns,
+	const HorizonProfile* horizon,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east)
+{
+	// Convert from j/m² to kWh/m²
+	const double j2kwh = 1.0 / 3600.0 / 1000.0;
+
+	const PanelArray& pa = o.array;
+	const real scale = panel_array_radius(pa, *std::max_element(
+		o.sweep_pitches.begin(), o.sweep_pitches.end()));
+
+	Scene scene = make_panel_array(pa);
+	place_panel_array(scene, pa, o.sweep_tilts[0], o.sweep_pitches[0],
+		scale);
+
+	// Receivers are on the front side of the panels,
+	// which are the first instances.
+	const auto& front = scene.geometry.submeshes[0];
+	std::vector<Receiver> receivers;
+	for(uint32_t i = 0; i < pa.rows * pa.panels_per_row; ++i) {
+		for(uint32_t v = 0; v < front.num_vertices; ++v) {
+			receivers.push_back({front.first_vertex + v, i});
+		}
+	}
+
+	std::cout << "Panel array: " << pa.rows << " rows of "
+		<< pa.panels_per_row << " panels, " << receivers.size()
+		<< " receivers\nVariants: " << o.sweep_tilts.size()
+		* o.sweep_pitches.size() << std::endl;
+
+	UVkInstance vk = initialize_vulkan();
+	auto ps = create_procs_from_devices(vk.get(), scene, receivers,
+		StringLayout{}, TuningProfile(default_tuning_profile())
+			.tuning_for(uint32_t(o.frame_size)));
+
+	std::ofstream csv("sweep.csv");
+	csv << "tilt,pitch,gcr,direct_kwh_m2,shading_loss\n";
+
+	std::cout << "\n   tilt   pitch    GCR   direct (kWh/m²)   loss\n";
+	bool first = true;
+	for(real tilt: o.sweep_tilts) {
+		for(real pitch: o.sweep_pitches) {
+			if(!first) {
+				place_panel_array(scene, pa, tilt, pitch, scale);
+				for(auto &p: ps) {
+					p->restart(scene);
+				}
+			}
+			first = false;
+
+			const auto solar_data = calculate_yearly_incidence(suns,
+				unit_north, unit_up, unit_east, ps, horizon);
+
+			std::vector<Vec4> energy(receivers.size(),
+				Vec4{0.0f, 0.0f, 0.0f, 0.0f});
+			for(auto &p: ps) {
+				p->accumulate_result(energy.data());
+			}
+
+			double lit = 0.0;
+			for(const Vec4& e: energy) {
+				lit += e.w;
+			}
+			lit /= energy.size();
+
+			// What every receiver would get without the other rows.
+			const Vec3 normal = panel_array_normal(pa, tilt);
+			double unshaded = 0.0;
+			for(const Vec3& s: solar_data) {
+				unshaded += std::max(0.0f, glm::dot(normal, s));
+			}
+
+			const double loss = unshaded > 0.0
+				? 1.0 - lit / unshaded : 0.0;
+			const double gcr = pa.panel_length / pitch;
+
+			std::cout << std::fixed << std::setprecision(1)
+				<< std::setw(7) << tilt << std::setw(8) << pitch
+				<< std::setprecision(3) << std::setw(7) << gcr
+				<< std::setprecision(1) << std::setw(18)
+				<< lit * j2kwh << std::setw(6) << loss * 100.0
+				<< "%" << std::endl;
+			csv << tilt << ',' << pitch << ',' << gcr << ','
+				<< lit * j2kwh << ',' << loss << '\n';
+		}
+	}
+	std::cout << std::defaultfloat << "\nTable written to sweep.csv."
+		<< std::endl;
+}
+
+// Everything needed for computing a model at a site: the receivers,
+// the strings, and the processors, with the scene on the devices.
+struct Setup
+{
+	// The output, with every instance in place.
+	Mesh test_mesh;
+
+	// Scale of the model, after it was normalized when loaded.
+	real scale;
+
+	ReceiverSelection selection;
+	StringLayout strings;
+
+	// Empty if prepared without devices.
+	std::vector<std::unique_ptr<ShadowProcessor>> ps;
+
+	// Estimated device memory of all the processors.
+	uint64_t device_bytes = 0;
+};
+
+// A model as loaded, before trackers and vegetation are assigned.
+struct LoadedModel
+{
+	// Every receiver is also a caster, but the context
+	// model, if given, is made of casters only.
+	Scene receivers;
+	Scene casters;
+
+	// Scale of the model, after it was normalized.
+	real scale;
+};
+
+// Loads the model, from the cache if given, or else into the cache.
+static LoadedModel load_model(const Options& o, ResultCache* cache,
+	uint64_t scene_hash)
+{
+	LoadedModel m;
+	m.scale = o.scale;
+
+	const bool cached = cache && cache->load_scenes(
+		scene_hash, m.receivers, m.casters, m.scale);
+	if(cached) {
+		std::cout << "Model loaded from cache." << std::endl;
+	} else if(!o.context_model.empty()) {
+		load_scene_with_context(o.mesh_name, o.context_model,
+			o.context_lod, o.rotation, m.scale,
+			m.receivers, m.casters);
+	} else {
+		m.receivers = o.point_cloud
+			? load_point_cloud(o.mesh_name, o.rotation, m.scale)
+			: load_scene(o.mesh_name, o.rotation, m.scale,
+				o.filter_cutoff);
+		m.casters = m.receivers;
+	}
+
+	if(cache && !cached) {
+		cache->save_scenes(scene_hash, m.receivers,
+			o.context_model.empty() ? nullptr : &m.casters,
+			m.scale);
+	}
+
+	return m;
+}
+
+// Prints the planned settings and their estimated cost on each device.
+static void print_plan(const std::vector<DevicePlan>& plans,
+	uint32_t frame_size, real scale, size_t frames)
+{
+	const double mb = 1.0 / 1024.0 / 1024.0;
+
+	std::cout << "Plan: " << frames << " frames of " << frame_size
+		<< " pixels (" << 2.0 * scale / frame_size
+		<< " m per pixel)\n";
+
+	// Devices share the frames, each at its own speed.
+	double rate = 0.0;
+	bool all_tuned = true;
+	for(const auto& p: plans) {
+		std::cout << " - " << p.name << ": "
+			<< p.tuning.slots_per_queue << " frames in flight, "
+			<< p.bytes * mb << " of " << p.budget * mb
+			<< " MB of device memory";
+		if(p.bytes > p.budget) {
+			std::cout << " (over the budget!)";
+		}
+		if(p.seconds > 0.0) {
+			std::cout << ", " << p.seconds / 60.0 << " minutes alone";
+			rate += 1.0 / p.seconds;
+		} else {
+			std::cout << ", not autotuned";
+			all_tuned = false;
+		}
+		std::cout << '\n';
+	}
+
+	if(all_tuned && rate > 0.0) {
+		std::cout << "Estimated time: " << 1.0 / rate / 60.0
+			<< " minutes\n";
+	} else {
+		std::cout << "Estimated time unknown, run --autotune "
+			"for every device.\n";
+	}
+	std::cout.flush();
+}
+
+// Selects the receivers of the model. The processors
+// are only created if there is a Vulkan instance.
+static std::unique_ptr<Setup> prepare(Options& o, LoadedModel model,
+	const std::vector<InstantaneousData>& suns,
+	const HorizonProfile* horizon,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east,
+	VkInstance vk)
+{
+	auto setup = std::make_unique<Setup>();
+
+	Scene& test_scene = model.receivers;
+	Scene& shadow_scene = model.casters;
+	o.scale = model.scale;
+
+	// The receivers are the first instances of the shadow
+	// scene, so both scenes are assigned the same way.
+	if(!o.trackers.empty()) {
+		test_scene.assign_trackers(o.trackers);
+		std::cout << "Tracking instances: "
+			<< shadow_scene.assign_trackers(o.trackers)
+			<< std::endl;
+	}
+
+	// Vegetation only matters for casting shadows.
+	if(!o.vegetation.empty()) {
+		std::cout << "Vegetation instances: "
+			<< shadow_scene.assign_vegetation(o.vegetation)
+			<< std::endl;
+	}
+
+	const Mesh& geom = shadow_scene.geometry;
+	//refine(test_mesh, 0.05);
+	std::cout << "Mesh size:\n    Vertices: " << geom.vertices.size()
+		<< " (" << geom.vertices.size()
+		* sizeof(decltype(geom.vertices)::value_type)
+		/ 1024.0 / 1024.0 << " MB)\n    Indices: "
+		<< geom.indices.size() << " (" << geom.vertices.size()
+		* sizeof(decltype(geom.indices)::value_type) / 1024.0 / 1024.0
+		<< " MB)\n    Unique meshes: " << geom.submeshes.size()
+		<< "\n    Instances: " << shadow_scene.instances.size()
+		<< std::endl;
+
+	// Only the directions the sun shines from matter
+	// for deciding which receivers can ever be lit.
+	std::vector<Vec3> sun_dirs;
+	sun_dirs.reserve(suns.size());
+	for(const auto& val: suns) {
+		if(val.direct_power > 0.0
+			&& !(horizon && horizon->occludes(val.pos)))
+		{
+			sun_dirs.push_back(to_vec(val.pos,
+				unit_north, unit_up, unit_east));
+		}
+	}
+
+	// Receivers that are not selected are left
+	// out of the computation entirely. They are
+	// the same in the shadow scene, because its
+	// first instances are the ones of test scene.
+	ReceiverSelection& selection = setup->selection;
+	selection = select_receivers(test_scene, o.scale, unit_up,
+		o.roi, SunCone{sun_dirs});
+
+	std::cout << "Receivers: " << selection.receivers.size()
+		<< " of " << test_scene.instanced_vertex_count() << " ("
+		<< selection.outside_roi << " outside region of interest, "
+		<< selection.never_sunlit << " never facing the sun)"
+		<< std::endl;
+
+	if(selection.receivers.empty()) {
+		throw std::runtime_error("No receivers to compute.\n");
+	}
+
+	// Panels are instances of the test scene, with only
+	// their selected receivers.
+	StringLayout& strings = setup->strings;
+	if(!o.strings.empty()) {
+		strings = build_strings(test_scene, selection.receivers,
+			o.strings, uint32_t(o.bypass_diodes), unit_up);
+		std::cout << "Strings: " << strings.strings.size()
+			<< " (" << strings.substrings.size()
+			<< " substrings)" << std::endl;
+	}
+
+	setup->test_mesh = test_scene.flatten().geometry;
+
+	const TuningProfile profile(default_tuning_profile());
+	TuningFor tuning = profile.tuning_for(uint32_t(o.frame_size));
+	if(vk && o.accuracy > 0.0) {
+		uint32_t frame_size = o.frame_size_given
+			? uint32_t(o.frame_size)
+			: plan_frame_size(setup->test_mesh);
+
+		const size_t frames = sun_dirs.size()
+			/ std::max(1u, o.num_shards);
+		const auto plans = plan_devices(vk, shadow_scene,
+			selection.receivers.size(), strings, profile,
+			frame_size, frames);
+		o.frame_size = frame_size;
+		print_plan(plans, frame_size, o.scale, frames);
+
+		tuning = [plans, profile, frame_size](
+			const VkPhysicalDeviceProperties& props)
+		{
+			for(const auto& p: plans) {
+				if(p.name == props.deviceName) {
+					return p.tuning;
+				}
+			}
+			return profile.find(props, frame_size);
+		};
+	}
+
+	if(vk) {
+		setup->ps = create_procs_from_devices(vk,
+			shadow_scene, selection.receivers, strings, tuning);
+	}
+
+	// The shadow maps of every slot usually take more than the scene.
+	for(const auto& p: setup->ps) {
+		const auto memory = ShadowProcessor::estimate_memory(
+			shadow_scene, selection.receivers.size(), strings,
+			p->get_frame_size());
+		setup->device_bytes += memory.fixed
+			+ memory.per_slot * p->get_num_slots();
+	}
+
+	setup->scale = o.scale;
+	return setup;
+}
+
+// Setups kept by the daemon and the batch between jobs, with the
+// processors and the scene on the devices, the least recently used
+// being dropped when the estimated device memory exceeds the budget.
+// The last models loaded are also kept, for jobs on other sites.
+class WarmSetups
+{
+public:
+	WarmSetups(uint64_t max_bytes):
+		vk{initialize_vulkan()},
+		max_bytes{max_bytes}
+	{}
+
+	VkInstance instance()
+	{
+		return vk.get();
+	}
+
+	// The setup with the given key, with its results cleared,
+	// or null if there is none.
+	Setup* find(uint64_t key)
+	{
+		for(auto i = entries.begin(); i != entries.end(); ++i) {
+			if(i->first == key) {
+				entries.splice(entries.begin(), entries, i);
+				for(auto& p: i->second->ps) {
+					p->clear();
+				}
+				return i->second.get();
+			}
+		}
+		return nullptr;
+	}
+
+	// The model with the given hash, as loaded by a previous call
+	// or prefetch, or by the given function, now.
+	LoadedModel model(uint64_t key,
+		const std::function<LoadedModel()>& load)
+	{
+		return find_model(key, load, std::launch::deferred).get();
+	}
+
+	// Starts loading the model with the given hash in
+	// the background, if it is not loaded already.
+	void prefetch(uint64_t key, const std::function<LoadedModel()>& load)
+	{
+		find_model(key, load, std::launch::async);
+	}
+
+	Setup* insert(uint64_t key, std::unique_ptr<Setup> setup)
+	{
+		used += bytes(*setup);
+		entries.emplace_front(key, std::move(setup));
+
+		// The newest is kept, even if alone over the budget.
+		while(used > max_bytes && entries.size() > 1) {
+			used -= bytes(*entries.back().second);
+			entries.pop_back();
+		}
+		return entries.front().second.get();
+	}
+
+private:
+	static uint64_t bytes(const Setup& s)
+	{
+		return s.device_bytes;
+	}
+
+	std::shared_future<LoadedModel> find_model(uint64_t key,
+		const std::function<LoadedModel()>& load, std::launch policy)
+	{
+		for(auto i = models.begin(); i != models.end(); ++i) {
+			if(i->first == key) {
+				models.splice(models.begin(), models, i);
+				return i->second;
+			}
+		}
+
+		models.emplace_front(key, std::async(policy, load).share());
+		if(models.size() > MAX_MODELS) {
+			models.pop_back();
+		}
+		return models.front().second;
+	}
+
+	// The current job's and the next one's.
+	static const size_t MAX_MODELS = 2;
+	std::list<std::pair<uint64_t, std::shared_future<LoadedModel>>>
+		models;
+
+	// Destroyed after the devices.
+	UVkInstance vk;
+
+	std::list<std::pair<uint64_t, std::unique_ptr<Setup>>> entries;
+	uint64_t used = 0;
+	uint64_t max_bytes;
+};
+
+// Runs the computation described by the options. The daemon
+// gives the setups it keeps, to reuse and to add new ones to.
+static int run(Options o, WarmSetups* warm)
+{
+	// Far terrain is not part of the scene, but of a horizon
+	// profile that tells when the sun is hidden behind it.
+	std::unique_ptr<HorizonProfile> horizon;
+	if(!o.horizon_dem.empty()) {
+		HeightRaster dem = load_esri_ascii_grid(o.horizon_dem);
+
+		if(o.horizon_site.empty()) {
+			o.horizon_site = {
+				real(dem.x0 + dem.cols * dem.cell_size * 0.5),
+				real(dem.y0 + dem.rows * dem.cell_size * 0.5)
+			};
+		}
+		if(o.horizon_site.size() < 3) {
+			const float ground = dem.sample(
+				o.horizon_site[0], o.horizon_site[1]);
+			if(!dem.is_valid(ground)) {
+				throw std::runtime_error(
+					"Site is outside the horizon raster.\n");
+			}
+			o.horizon_site.push_back(ground);
+		}
+
+		horizon = std::make_unique<HorizonProfile>(dem,
+			o.horizon_site[0], o.horizon_site[1], o.horizon_site[2]);
+	}
+
+	// Loaded before the long computation, to fail early.
+	std::unique_ptr<Weather> weather;
+	if(!o.weather.empty()) {
+		weather = std::make_unique<Weather>(load_weather(o.weather));
+	}
+
+	// TODO: take as command line input:
+	const Vec3 unit_north{0, 0, -1};
+	const Vec3 unit_up{0, 1, 0};
+	const Vec3 unit_east{1, 0, 0};
+
+	// Convert from j/m² to kWh/m²
+	const double j2kwh = 1.0 / 3600.0 / 1000.0;
+
+	// All the sun positions over the year, with the
+	// timestep planned for the accuracy, if given.
+	auto suns = sun_table(o.lat, o.lon, 0, o.timestep);
+	if(o.accuracy > 0.0) {
+		const TimestepPlan plan = plan_timestep(suns, o.timestep,
+			o.accuracy, unit_north, unit_up, unit_east);
+		if(plan.timestep < o.timestep) {
+			suns = sun_table(o.lat, o.lon, 0, plan.timestep);
+		} else {
+			suns = coarsen(suns,
+				unsigned(plan.timestep / o.timestep + 0.5));
+		}
+
+		std::cout << "Plan: timestep of " << plan.timestep << " s, "
+			<< suns.size() << " sun samples, estimated error of "
+			<< plan.error << "% on unshaded surfaces";
+		if(plan.error > o.accuracy) {
+			std::cout << " (over the target!)";
+		}
+		std::cout << std::endl;
+	}
+
+	// Tracker rest normals depend on what is up.
+	for(auto& t: o.trackers) {
+		if(t.type == TrackerGroup::DUAL_AXIS) {
+			t.rest_normal = unit_up;
+			continue;
+		}
+
+		t.axis = glm::normalize(t.axis);
+		t.rest_normal = unit_up - glm::dot(unit_up, t.axis) * t.axis;
+		if(glm::length(t.rest_normal) < 1e-3) {
+			throw std::runtime_error("Single axis tracker can't "
+				"rotate around the vertical.\n");
+		}
+		t.rest_normal = glm::normalize(t.rest_normal);
+	}
+
+	if(o.sweep) {
+		run_sweep(o, suns, horizon.get(),
+			unit_north, unit_up, unit_east);
+		return 0;
+	}
+
+	if(o.use_dsm) {
+		// The raster is in its own frame, with z up.
+		const Vec3 r_north{0, 1, 0};
+		const Vec3 r_up{0, 0, 1};
+		const Vec3 r_east{1, 0, 0};
+
+		const HeightRaster dsm = load_esri_ascii_grid(o.mesh_name);
+		std::cout << "Raster size: " << dsm.cols << 'x' << dsm.rows
+			<< " cells of " << dsm.cell_size << " m" << std::endl;
+
+		std::vector<std::unique_ptr<RasterProcessor>> rps;
+		rps.push_back(std::make_unique<RasterProcessor>(dsm,
+			std::max(1u, std::thread::hardware_concurrency())));
+
+		auto solar_data = calculate_yearly_incidence(suns,
+			r_north, r_up, r_east, rps, horizon.get());
+
+		Totals totals;
+		std::vector<float> incidence(dsm.heights.size(), 0.0f);
+		for(auto &p: rps) {
+			totals.add(*p);
+			p->accumulate_result(incidence.data());
+		}
+
+		for(float &r: incidence) {
+			r = (r + totals.dif_total) * j2kwh;
+		}
+		save_esri_ascii_grid("incidence.asc", dsm, incidence);
+
+		print_workload(rps, totals.count);
+		report(solar_data, totals, o.lat, o.lon, o.test_tilts,
+			r_north, r_up, r_east);
+		return 0;
+	}
+
+	// A cached result skips the computation, and
+	// a cached model skips loading it.
+	std::unique_ptr<ResultCache> cache;
+	// From the options as given, before prepare() plans the frame size.
+	const uint64_t scene_hash = scene_key(o);
+	const uint64_t run_hash = run_key(o, scene_hash);
+	const uint64_t result_hash = result_key(o, scene_hash);
+	PartialResult cached;
+	bool result_cached = false;
+	if(o.cache) {
+		cache = std::make_unique<ResultCache>(default_cache_dir(),
+			uint64_t(o.cache_size * 1024.0 * 1024.0));
+		result_cached = cache->load_result(result_hash, cached);
+	}
+
+	// Merged or cached results need no device,
+	// except for rendering the GeoTIFF.
+	const bool use_device = !o.merge && (!result_cached || o.geotiff);
+	UVkInstance vk;
+	if(use_device && !warm) {
+		vk = initialize_vulkan();
+	}
+
+	// A setup kept by the daemon is reused, with
+	// its results cleared, as long as it has devices.
+	std::unique_ptr<Setup> own_setup;
+	Setup* setup = nullptr;
+	const uint64_t setup_hash = setup_key(o, scene_hash);
+	if(warm && use_device) {
+		setup = warm->find(setup_hash);
+	}
+
+	auto load = [&] {
+		return load_model(o, cache.get(), scene_hash);
+	};
+	if(setup) {
+		std::cout << "Using warm setup." << std::endl;
+	} else if(warm && use_device) {
+		setup = warm->insert(setup_hash, prepare(o,
+			warm->model(scene_hash, load), suns, horizon.get(),
+			unit_north, unit_up, unit_east, warm->instance()));
+	} else {
+		own_setup = prepare(o,
+			warm ? warm->model(scene_hash, load) : load(), suns,
+			horizon.get(), unit_north, unit_up, unit_east,
+			vk.get());
+		setup = own_setup.get();
+	}
+
+	o.scale = setup->scale;
+	const Mesh& test_mesh = setup->test_mesh;
+	const ReceiverSelection& selection = setup->selection;
+	const StringLayout& strings = setup->strings;
+	auto& ps = setup->ps;
+
+	// Either computed here, over all the sun samples or the
+	// ones of the shard, or merged from the shards.
+	PartialResult result;
+	result.shard = o.shard;
+	result.num_shards = std::max(1u, o.num_shards);
+	result.run = run_hash;
+	result.latitude = o.lat;
+	result.longitude = o.lon;
+	result.num_suns = suns.size();
+	result.energy.resize(selection.indices.size(),
+		Vec4{0.0f, 0.0f, 0.0f, 0.0f});
+	result.string_energy.resize(strings.strings.size(),
+		Vec2{0.0f, 0.0f});
+	result.string_hourly.resize(
+		strings.strings.size() * HOURS_PER_YEAR, 0.0f);
+
+	if(o.merge) {
+		merge_partials(o.partials, result);
+		std::cout << "Merged " << result.num_shards << " shards."
+			<< std::endl;
+	} else if(result_cached) {
+		result.add(cached);
+		std::cout << "Results loaded from cache." << std::endl;
+	} else {
+		// Shards take interleaved samples, so
+		// that each one spans the whole year.
+		std::vector<InstantaneousData> shard_suns;
+		for(size_t i = 0; o.num_shards && i < suns.size(); ++i) {
+			if(in_shard(i, o.shard, o.num_shards)) {
+				shard_suns.push_back(suns[i]);
+			}
+		}
+
+		// Any prefix of the samples is spread over the year,
+		// so partial results are estimates of the final ones.
+		const auto run_suns = stratified(
+			o.num_shards ? shard_suns : suns);
+
+		const std::string checkpoint = o.num_shards
+			? "shard-" + std::to_string(o.shard) + "-of-"
+				+ std::to_string(o.num_shards) + ".checkpoint"
+			: "solmap.checkpoint";
+
+		if(o.resume && std::ifstream(checkpoint)) {
+			const PartialResult saved =
+				load_partial_result(checkpoint);
+			if(saved.shard != result.shard) {
+				throw std::runtime_error(
+					"Checkpoint is of another shard.\n");
+			}
+			if(saved.run != result.run) {
+				throw std::runtime_error("Checkpoint is of a run "
+					"with other options or models.\n");
+			}
+			result.add(saved);
+			std::cout << "Resuming from " << result.processed
+				<< " of " << run_suns.size() << " sun samples."
+				<< std::endl;
+		} else if(o.resume) {
+			std::cout << "No checkpoint found, starting over."
+				<< std::endl;
+		}
+
+		// Chunks last until the next checkpoint or preview is due,
+		// and are small enough to tell when the results converge.
+		std::vector<double> intervals;
+		if(o.checkpoint_interval > 0.0) {
+			intervals.push_back(o.checkpoint_interval * 60.0);
+		}
+		if(o.preview_interval > 0.0) {
+			intervals.push_back(o.preview_interval);
+		}
+		const double interval = intervals.empty() ? 0.0
+			: *std::min_element(intervals.begin(), intervals.end());
+		const size_t max_chunk = o.tolerance > 0.0
+			? std::max(size_t(1), run_suns.size() / 64)
+			: run_suns.size();
+
+		using Clock = std::chrono::steady_clock;
+		Clock::time_point last_checkpoint = Clock::now();
+		Clock::time_point last_preview = Clock::now();
+		auto due = [](Clock::time_point& last, double interval) {
+			if(interval <= 0.0 || std::chrono::duration<double>(
+				Clock::now() - last).count() < interval * 0.99)
+			{
+				return false;
+			}
+			last = Clock::now();
+			return true;
+		};
+
+		Convergence convergence(o.tolerance / 100.0);
+		auto step = [&](const PartialResult& r) {
+			if(due(last_checkpoint, o.checkpoint_interval * 60.0)) {
+				save_partial_result(checkpoint, r);
+				std::cout << "Checkpoint at " << r.processed
+					<< " of " << run_suns.size()
+					<< " sun samples." << std::endl;
+			}
+
+			const bool preview_due = due(last_preview,
+				o.preview_interval);
+			if(!preview_due && o.tolerance <= 0.0) {
+				return true;
+			}
+
+			PartialResult estimate = r;
+			estimate.scale(double(run_suns.size()) / r.processed);
+
+			if(preview_due) {
+				write_estimate(o.output, test_mesh, o.scale,
+					selection.indices, estimate);
+				std::cout << "Preview from " << r.processed << " of "
+					<< run_suns.size() << " sun samples written to "
+					<< o.output << '.' << std::endl;
+			}
+
+			if(o.tolerance > 0.0 && convergence.update(estimate)) {
+				std::cout << "Converged after " << r.processed
+					<< " of " << run_suns.size() << " sun samples."
+					<< std::endl;
+				return false;
+			}
+			return true;
+		};
+
+		result = compute_from(result, run_suns,
+			unit_north, unit_up, unit_east, ps, horizon.get(),
+			!strings.empty(), interval, max_chunk, step);
+
+		// Stopped early, so the rest is extrapolated.
+		if(result.processed < run_suns.size()) {
+			result.scale(double(run_suns.size()) / result.processed);
+		}
+
+		// The results are complete, it is no longer needed.
+		if(o.checkpoint_interval > 0.0 || o.resume) {
+			std::remove(checkpoint.c_str());
+		}
+
+		if(cache) {
+			cache->save_result(result_hash, result);
+		}
+	}
+
+	if(o.num_shards) {
+		const std::string fname = "shard-" + std::to_string(o.shard)
+			+ "-of-" + std::to_string(o.num_shards) + ".part";
+		save_partial_result(fname, result);
+		if(!result_cached) {
+			print_workload(ps, result.count);
+		}
+		std::cout << "Partial result written to " << fname << '.'
+			<< std::endl;
+		return 0;
+	}
+
+	// Get results:
+	const std::vector<Vec4> dir_energy = scatter_energy(
+		test_mesh.vertices.size(), selection.indices, result);
+	Totals totals;
+	totals.dir_total = result.directional_sum;
+	totals.dif_total = result.diffuse_sum;
+	totals.suntime = result.time_sum;
+	totals.count = result.count;
+
+	const double dif_total_kwh = totals.dif_total * j2kwh;
+	const double dir_total_kwh = glm::length(totals.dir_total) * j2kwh;
+
+	write_vtk(o.output, test_mesh, o.scale, dif_total_kwh, dir_total_kwh,
+		dir_energy.data(),
+		std::max(1u, std::thread::hardware_concurrency()));
+	std::cout << "Incidence written to " << o.output << '.' << std::endl;
+
+	if(!o.store.empty()) {
+		write_result_store(o.store, {o.lat, o.lon, o.mesh_name},
+			test_mesh, o.scale, dif_total_kwh, dir_total_kwh,
+			dir_energy.data(), suns);
+		std::cout << "Results stored in " << o.store << '.'
+			<< std::endl;
+	}
+
+	if(o.geotiff) {
+		export_geotiff(*ps.front(), test_mesh, o.scale, dir_energy,
+			dif_total_kwh, o.lat, o.lon, o.geotiff_cell,
+			o.geotiff_origin);
+	}
+
+	if(o.layout.count) {
+		report_layout(test_mesh, o.scale, unit_up, dir_energy,
+			dif_total_kwh, selection.indices, o.layout);
+	}
+
+	if(!strings.empty()) {
+		report_strings(strings, result.string_energy, dif_total_kwh);
+		if(weather) {
+			report_pv(strings, result.string_hourly, suns,
+				*weather, o.pv);
+		}
+	}
+
+	if(!ps.empty() && !result_cached) {
+		print_workload(ps, totals.count);
+	}
+	report(result.solar_data, totals, o.lat, o.lon, o.test_tilts,
+		unit_north, unit_up, unit_east);
+	return 0;
+}
+
+// Tunes the devices for the frame size, and saves it to the profile.
+static int run_autotune(const Options& o)
+{
+	UVkInstance vk = initialize_vulkan();
+	TuningProfile profile(default_tuning_profile());
+	autotune(vk.get(), uint32_t(o.frame_size), profile);
+	profile.save();
+	std::cout << "Saved to \"" << default_tuning_profile() << "\"."
+		<< std::endl;
+	return 0;
+}
+
+// Parses the arguments of a job of the daemon or of the batch.
+static Options parse_job(char* cmd, const std::vector<std::string>& args)
+{
+	std::vector<char*> job_argv{cmd};
+	for(const auto& a: args) {
+		job_argv.push_back(const_cast<char*>(a.c_str()));
+	}
+	job_argv.push_back(nullptr);
+
+	// Starts getopt over.
+	optind = 0;
+	Options o = parse_args(int(job_argv.size() - 1), job_argv.data());
+	if(!o.daemon.empty() || !o.batch.empty()) {
+		throw std::runtime_error("A job can't run other jobs.\n");
+	}
+	if(o.autotune) {
+		throw std::runtime_error("A job can't autotune.\n");
+	}
+	return o;
+}
+
+// Every file the job writes its results to. Checkpoints are left out,
+// as they are removed when the job is done, and can't be resumed by
+// other jobs.
+static std::vector<std::string> written_files(const Options& o)
+{
+	if(o.sweep) {
+		return {"sweep.csv"};
+	}
+	if(o.use_dsm) {
+		return {"incidence.asc"};
+	}
+
+	std::vector<std::string> ret;
+	if(o.num_shards) {
+		ret.push_back("shard-" + std::to_string(o.shard) + "-of-"
+			+ std::to_string(o.num_shards) + ".part");
+		if(o.preview_interval > 0.0) {
+			ret.push_back(o.output);
+		}
+		return ret;
+	}
+
+	ret.push_back(o.output);
+	if(!o.store.empty()) {
+		ret.push_back(o.store);
+	}
+	if(o.geotiff) {
+		ret.push_back("incidence.tif");
+	}
+	if(o.layout.count) {
+		ret.push_back("layout.csv");
+	}
+	if(!o.strings.empty()) {
+		ret.push_back("strings.csv");
+	}
+	if(!o.weather.empty()) {
+		ret.push_back("pv.csv");
+	}
+	return ret;
+}
+
+// Runs the jobs listed in the file, keeping the devices and the models
+// between them. While a job computes, the next one's model is loaded.
+static int run_batch(char* cmd, const std::string& fname, uint64_t vram)
+{
+	std::ifstream in(fname);
+	if(!in) {
+		throw std::runtime_error(
+			"Could not open job list \"" + fname + "\".\n"
+		);
+	}
+
+	// All the jobs are parsed first, to fail before computing.
+	std::vector<Options> jobs;
+	std::vector<size_t> job_lines;
+	std::string line;
+	for(size_t line_num = 1; std::getline(in, line); ++line_num) {
+		std::istringstream ss(line);
+		std::vector<std::string> args;
+		for(std::string arg; ss >> std::quoted(arg);) {
+			args.push_back(arg);
+		}
+		if(args.empty() || args[0][0] == '#') {
+			continue;
+		}
+
+		try {
+			jobs.push_back(parse_job(cmd, args));
+		} catch(const UsageError&) {
+			throw std::runtime_error("Invalid job at line "
+				+ std::to_string(line_num) + ".\n");
+		}
+		job_lines.push_back(line_num);
+	}
+
+	// Each job's results are written separately.
+	std::map<std::string, size_t> outputs;
+	for(size_t i = 0; i < jobs.size(); ++i) {
+		for(const auto& f: written_files(jobs[i])) {
+			const auto prev = outputs.emplace(
+				std::filesystem::path(f).lexically_normal(),
+				job_lines[i]);
+			if(!prev.second && prev.first->second != job_lines[i]) {
+				throw std::runtime_error("Jobs at lines "
+					+ std::to_string(prev.first->second) + " and "
+					+ std::to_string(job_lines[i])
+					+ " both write to \"" + f + "\".\n");
+			}
+		}
+	}
+
+	WarmSetups warm(vram);
+	size_t failed = 0;
+	for(size_t i = 0; i < jobs.size(); ++i) {
+		if(i + 1 < jobs.size() && !jobs[i + 1].sweep
+			&& !jobs[i + 1].use_dsm)
+		{
+			// If this fails, the job will fail when it gets its turn.
+			try {
+				const Options next = jobs[i + 1];
+				const uint64_t key = scene_key(next);
+				warm.prefetch(key, [next, key] {
+					std::unique_ptr<ResultCache> cache;
+					if(next.cache) {
+						cache = std::make_unique<ResultCache>(
+							default_cache_dir(), uint64_t(
+							next.cache_size * 1024.0 * 1024.0));
+					}
+					return load_model(next, cache.get(), key);
+				});
+			} catch(const std::exception&) {}
+		}
+
+		std::cout << "\nJob " << i + 1 << " of " << jobs.size()
+			<< ", from line " << job_lines[i] << ':' << std::endl;
+		try {
+			failed += run(jobs[i], &warm) != 0;
+		} catch(const std::exception& e) {
+			std::cout << "Error: " << e.what() << std::flush;
+			++failed;
+		}
+	}
+
+	std::cout << '\n' << jobs.size() - failed << " of " << jobs.size()
+		<< " jobs succeeded." << std::endl;
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	try {
+		const Options o = parse_args(argc, argv);
+
+		// Batch jobs load the next model while computing, both
+		// printing, so the streams must stay synchronized.
+		if(o.batch.empty()) {
+			std::ios_base::sync_with_stdio(false);
+		}
+
+		if(o.autotune) {
+			return run_autotune(o);
+		}
+
+		if(!o.batch.empty()) {
+			return run_batch(argv[0], o.batch,
+				uint64_t(o.vram * 1024.0 * 1024.0));
+		}
+
+		if(o.daemon.empty()) {
+			return run(o, nullptr);
+		}
+
+		WarmSetups warm(uint64_t(o.vram * 1024.0 * 1024.0));
+		serve(o.daemon, [&](const std::vector<std::string>& args) {
+			try {
+				return run(parse_job(argv[0], args), &warm);
+			} catch(const UsageError&) {
+				return 1;
+			}
+		});
+	} catch(const UsageError&) {
+		return 1;
+	} catch(const std::exception& e) {
+		std::cout << "Error: " << e.what() << std::flush;
+		return 1;
+	}
+}
@@ -1,6 +1,10 @@
 #include <unordered_map>
 #include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <array>
 #include <cmath>
+#include <limits>
 
 #include <boost/functional/hash.hpp>
 
@@ -10,24 +14,30 @@
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/norm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/glm.hpp>
 
 #include <iostream>
 
 #include "mesh_tools.hpp"
 
-// Finding the axis aligned bounding box.
-static real bounding_box(const Mesh& m, Vec3& center)
+// Finds the axis aligned bounding box of all the instanced vertices
+// of the scenes. Returns the radius of its bounding sphere.
+static real bounding_box(std::initializer_list<Scene*> scenes,
+	Vec3& center)
 {
-	Vec3 lo = m.vertices[0].position;
-	Vec3 hi = lo;
-
-	for(size_t i = 1; i < m.vertices.size(); ++i) {
-		const Vec3 &p = m.vertices[i].position;
-		for(size_t j = 0; j < 3; ++j) {
-			if(p[j] < lo[j]) {
-				lo[j] = p[j];
-			} else if(p[j] > hi[j]) {
-				hi[j] = p[j];
+	Vec3 lo{std::numeric_limits<real>::infinity()};
+	Vec3 hi{-std::numeric_limits<real>::infinity()};
+
+	for(const Scene* s: scenes) {
+		for(const auto& inst: s->instances) {
+			const auto& sm = s->geometry.submeshes[inst.submesh];
+			for(uint32_t i = 0; i < sm.num_vertices; ++i) {
+				const Vec3 p = Vec3{inst.transform * Vec4{
+					s->geometry.vertices[sm.first_vertex + i]
+						.position, 1.0f}};
+				lo = glm::min(lo, p);
+				hi = glm::max(hi, p);
 			}
 		}
 	}
@@ -35,9 +45,42 @@ static real bounding_box(const Mesh& m, Vec3& center)
 	return glm::distance(center, hi);
 }
 
+static Mat4 to_mat4(const aiMatrix4x4& m)
+{
+	// Assimp matrices are row major, GLM's are column major.
+	Mat4 ret;
+	for(uint8_t i = 0; i < 4; ++i) {
+		for(uint8_t j = 0; j < 4; ++j) {
+			ret[j][i] = m[i][j];
+		}
+	}
+	return ret;
+}
+
+// Creates one instance for every mesh referenced by the node hierarchy.
+static void find_instances(const aiNode* node, const Mat4& parent,
+	std::vector<Scene::Instance>& instances)
+{
+	const Mat4 transform = parent * to_mat4(node->mTransformation);
+
+	for(unsigned i = 0; i < node->mNumMeshes; ++i) {
+		instances.push_back({
+			node->mMeshes[i], transform, node->mName.C_Str()
+		});
+	}
+
+	for(unsigned i = 0; i < node->mNumChildren; ++i) {
+		find_instances(node->mChildren[i], transform, instances);
+	}
+}
+
 // Code adapted from assimp library example
 // http://sir-kimmi.de/assimp/lib_html/usage.html
-static Mesh import_scene_from_file(const std::string& filename)
+//
+// If point_cloud is set, only the vertices are loaded,
+// and every kind of primitive is ignored.
+static Scene import_scene_from_file(const std::string& filename,
+	bool point_cloud)
 {
 	// Create an instance of the Importer class
 	Assimp::Importer importer;
@@ -64,21 +107,31 @@ static Mesh import_scene_from_file(const std::string& filename)
 	// Remove degenerate primitives
 	importer.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);
 
-	// And have it read the given file with some example postprocessing
-	// Usually - if speed is not the most important aspect for you - you'll
-	// probably to request more postprocessing than we do in this example.
-	if(!importer.ReadFile(filename,
+	// The node hierarchy is not pre-transformed, so that meshes
+	// referenced many times are loaded only once, as instances.
+
+	// Point clouds must keep their point primitives,
+	// so skip everything that deals with faces.
+	const unsigned flags = point_cloud ? (
+		aiProcess_JoinIdenticalVertices |
+		aiProcess_RemoveComponent |
+		aiProcess_FindInvalidData
+	) : (
 		aiProcess_Triangulate |
 		aiProcess_JoinIdenticalVertices |
 		aiProcess_SortByPType |
 		aiProcess_RemoveComponent |
-		aiProcess_PreTransformVertices |
 		//aiProcess_ValidateDataStructure |
 		aiProcess_ImproveCacheLocality |
 		aiProcess_SortByPType |
 		aiProcess_FindDegenerates |
 		aiProcess_FindInvalidData
-	)) {
+	);
+
+	// And have it read the given file with some example postprocessing
+	// Usually - if speed is not the most important aspect for you - you'll
+	// probably to request more postprocessing than we do in this example.
+	if(!importer.ReadFile(filename, flags)) {
 		// If the import failed, report it
 		throw std::runtime_error(
 			"Could not load provided 3D scene file.\n"
@@ -96,16 +149,21 @@ static Mesh import_scene_from_file(const std::string& filename)
 	for(size_t i = 0; i < scene->mNumMeshes; ++i) {
 		auto* m = scene->mMeshes[i];
 		vert_count += m->mNumVertices;
-		idx_count += m->mNumFaces * 3;
+		if(!point_cloud) {
+			idx_count += m->mNumFaces * 3;
+		}
 	}
 
-	Mesh ret;
-	ret.vertices.reserve(vert_count);
-	ret.indices.reserve(idx_count);
+	Scene ret;
+	Mesh& geom = ret.geometry;
+	geom.vertices.reserve(vert_count);
+	geom.indices.reserve(idx_count);
+	geom.submeshes.reserve(scene->mNumMeshes);
 
 	// Copy the vertex data.
 	for(size_t i = 0; i < scene->mNumMeshes; ++i) {
 		auto* m = scene->mMeshes[i];
+		const uint32_t base = geom.vertices.size();
 		if(!m->mNormals) {
 			throw std::runtime_error(
 				"Missing normals on mesh.\n"
@@ -113,8 +171,8 @@ static Mesh import_scene_from_file(const std::string& filename)
 		}
 
 		for(size_t j = 0; j < m->mNumVertices; ++j) {
-			ret.vertices.emplace_back();
-			VertexData& v = ret.vertices.back();
+			geom.vertices.emplace_back();
+			VertexData& v = geom.vertices.back();
 
 			for(uint8_t k = 0; k < 3; ++k) {
 				v.position[k] = m->mVertices[j][k];
@@ -122,16 +180,149 @@ static Mesh import_scene_from_file(const std::string& filename)
 			}
 		}
 
-		for(size_t j = 0; j < m->mNumFaces; ++j) {
-			for(uint8_t k = 0; k < 3; ++k) {
-				ret.indices.push_back(m->mFaces[j].mIndices[k]);
+		const uint32_t first_index = geom.indices.size();
+		if(!point_cloud) {
+			for(size_t j = 0; j < m->mNumFaces; ++j) {
+				for(uint8_t k = 0; k < 3; ++k) {
+					geom.indices.push_back(
+						base + m->mFaces[j].mIndices[k]);
+				}
+			}
+		}
+
+		geom.submeshes.push_back({
+			m->mName.C_Str(),
+			base, m->mNumVertices,
+			first_index, uint32_t(geom.indices.size() - first_index)
+		});
+	}
+
+	find_instances(scene->mRootNode, Mat4{1.0f}, ret.instances);
+
+	// Make the instances of the same mesh contiguous.
+	std::stable_sort(ret.instances.begin(), ret.instances.end(),
+		[](const Scene::Instance& a, const Scene::Instance& b) {
+			return a.submesh < b.submesh;
+		}
+	);
+
+	if(ret.instances.empty() || geom.vertices.empty()) {
+		throw std::runtime_error(
+			"No vertices in provided 3D scene file.\n"
+		);
+	}
+
+	return ret;
+}
+
+// Matrix to transform the normals of an instance.
+static glm::mat3 normal_matrix(const Mat4& transform)
+{
+	return glm::transpose(glm::inverse(glm::mat3{transform}));
+}
+
+size_t Scene::instanced_vertex_count() const
+{
+	size_t ret = 0;
+	for(const auto& inst: instances) {
+		ret += geometry.submeshes[inst.submesh].num_vertices;
+	}
+	return ret;
+}
+
+Scene Scene::flatten() const
+{
+	Scene ret;
+	Mesh& out = ret.geometry;
+	out.vertices.reserve(instanced_vertex_count());
+
+	for(const auto& inst: instances) {
+		const auto& sm = geometry.submeshes[inst.submesh];
+		const glm::mat3 nmat = normal_matrix(inst.transform);
+		const uint32_t base = out.vertices.size();
+
+		// Splats scale with the instance,
+		// assuming the scale is uniform.
+		const float splat_scale = glm::length(
+			Vec3{inst.transform[0]});
+
+		for(uint32_t i = 0; i < sm.num_vertices; ++i) {
+			const VertexData& v =
+				geometry.vertices[sm.first_vertex + i];
+			// Degenerate normals are left as zero, instead of
+			// NaN, so the vertex just never receives energy.
+			const Vec3 n = nmat * v.normal;
+			const float len = glm::length(n);
+			out.vertices.emplace_back(
+				Vec3{inst.transform * Vec4{v.position, 1.0f}},
+				len > 0.0f ? n / len : Vec3{0.0f}
+			);
+
+			if(geometry.is_point_cloud()) {
+				out.splat_radius.push_back(splat_scale *
+					geometry.splat_radius[
+						sm.first_vertex + i]);
+			}
+		}
+
+		// Mirrored instances have their winding reversed,
+		// so the triangles keep facing their normals.
+		const bool mirrored =
+			glm::determinant(glm::mat3{inst.transform}) < 0.0f;
+		for(uint32_t i = 0; i < sm.num_indices; ++i) {
+			uint32_t j = i;
+			if(mirrored && i % 3 != 0) {
+				j = i % 3 == 1 ? i + 1 : i - 1;
 			}
+			out.indices.push_back(base - sm.first_vertex
+				+ geometry.indices[sm.first_index + j]);
 		}
 	}
 
+	// As the vertices are already in place, the only
+	// instance is a single identity over everything.
+	out.submeshes.push_back({"", 0, uint32_t(out.vertices.size()),
+		0, uint32_t(out.indices.size())});
+	ret.instances.push_back({0, Mat4{1.0f}, ""});
+
 	return ret;
 }
 
+// Sets the given instance field to the 1-based index of the first
+// group whose prefix matches the instance name, or 0 if none does.
+template<typename Group>
+static size_t assign_by_prefix(std::vector<Scene::Instance>& instances,
+	uint32_t Scene::Instance::* field, const std::vector<Group>& groups)
+{
+	size_t count = 0;
+	for(auto& inst: instances) {
+		inst.*field = 0;
+		for(uint32_t i = 0; i < groups.size(); ++i) {
+			if(inst.name.compare(0, groups[i].prefix.size(),
+				groups[i].prefix) == 0)
+			{
+				inst.*field = i + 1;
+				++count;
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+size_t Scene::assign_trackers(const std::vector<TrackerGroup>& groups)
+{
+	trackers = groups;
+	return assign_by_prefix(instances, &Instance::tracker, groups);
+}
+
+size_t Scene::assign_vegetation(const std::vector<VegetationGroup>& groups)
+{
+	vegetation = groups;
+	return assign_by_prefix(instances, &Instance::vegetation, groups);
+}
+
 static real parallelogram_area(const Vec3& a, const Vec3& b, const Vec3& c)
 {
 	return glm::length(glm::cross(b - a, c - a));
@@ -350,36 +541,401 @@ static void fine_pass_filter(Mesh &m, float filter_cutoff)
 	m.vertices.shrink_to_fit();
 }
 
-Mesh load_scene(const std::string& filename, const Quat& rotation,
+// Centers the mesh at origin and scales it so it fits in the unit
+// sphere, thus it always fit in the rendered buffer, no matter what
+// rotation is applied. Also applies the mesh rotation, so it doesn't
+// need to be done on GPU for every rendered frame.
+//
+// Multiple meshes are normalized together, as if they were one.
+static void normalize(std::initializer_list<Scene*> scenes,
+	const Quat& rotation, real& scale)
+{
+	// Find the bounding sphere of the point set:
+	Vec3 center;
+
+	// Find the bounding box to scale to the rendering buffer.
+	const real radius = bounding_box(scenes, center);
+
+	// Transform scene. Scale so radius is 1. The transform is
+	// applied to the instances, so the geometry is untouched.
+	const glm::mat3 rot = glm::mat3_cast(rotation);
+	Mat4 n{rot / radius};
+	n[3] = Vec4{rot * -center / radius, 1.0f};
+
+	for(Scene* s: scenes) {
+		for(auto& inst: s->instances) {
+			inst.transform = n * inst.transform;
+		}
+	}
+
+	// Update the user defined scale, so it applies to
+	// the newly normalized coordiates.
+	scale *= radius;
+}
+
+Scene load_scene(const std::string& filename, const Quat& rotation,
 	real &scale, real filter_cutoff)
 {
-	Mesh ret = import_scene_from_file(filename);
+	Scene ret = import_scene_from_file(filename, false);
 
 	// Filter out too big triangles.
 	/*if(filter_cutoff < std::numeric_limits<real>::infinity()) {
 		fine_pass_filter(ret, filter_cutoff);
 	}*/
 
-	// Find the bounding sphere of the point set:
-	Vec3 center;
+	normalize({&ret}, rotation, scale);
 
-	// Find the bounding box to scale to the rendering buffer.
-	const real radius = bounding_box(ret, center);
+	return ret;
+}
 
-	// Transform mesh. Scale so radius is 1, thus it
-	// always fit in the rendered buffer, no matter what
-	// rotation is applied. Also applies the mesh rotation,
-	// so it doesn't need to be done on GPU for every
-	// rendered frame.
-	for(auto& v: ret.vertices) {
-		v.position = glm::rotate(rotation, v.position - center)
-			/ radius;
-		v.normal = glm::rotate(rotation, v.normal);
+Scene make_scene(Mesh mesh, const Quat& rotation, real& scale)
+{
+	if(mesh.vertices.empty() || mesh.indices.size() % 3 != 0) {
+		throw std::runtime_error("Invalid mesh.\n");
+	}
+	for(uint32_t idx: mesh.indices) {
+		if(idx >= mesh.vertices.size()) {
+			throw std::runtime_error("Invalid mesh.\n");
+		}
 	}
 
-	// Update the user defined scale, so it applies to
-	// the newly normalized coordiates.
-	scale *= radius;
+	Scene ret;
+	ret.geometry = std::move(mesh);
+	ret.geometry.submeshes.push_back({"mesh",
+		0, uint32_t(ret.geometry.vertices.size()),
+		0, uint32_t(ret.geometry.indices.size())});
+	ret.instances.push_back({0, Mat4{1.0f}, "mesh"});
+
+	normalize({&ret}, rotation, scale);
+
+	return ret;
+}
+
+// Simplifies the mesh by vertex clustering: all vertices within the
+// same grid cell are merged into their average, and the triangles
+// that collapse are removed. Good enough for distant casters.
+static void cluster_vertices(Mesh& m, real cell_size)
+{
+	const real inv_cell = 1.0 / cell_size;
+
+	// Grid is relative to the corner of the bounding box,
+	// as the model might be in large world coordinates.
+	Vec3 lo = m.vertices[0].position;
+	Vec3 hi = lo;
+	for(const auto& v: m.vertices) {
+		lo = glm::min(lo, v.position);
+		hi = glm::max(hi, v.position);
+	}
+
+	// The cell of each axis takes 21 bits of the key.
+	const real max_cells = real(1 << 21);
+	for(uint8_t j = 0; j < 3; ++j) {
+		if((hi[j] - lo[j]) * inv_cell >= max_cells) {
+			throw std::runtime_error("Context LOD is too fine for "
+				"the size of the context model.\n");
+		}
+	}
+
+	struct Cluster {
+		uint32_t idx;
+		uint32_t count;
+	};
+
+	std::unordered_map<uint64_t, Cluster> clusters;
+	std::vector<uint32_t> old_to_new(m.vertices.size());
+	std::vector<VertexData> new_vertices;
+
+	for(uint32_t i = 0; i < m.vertices.size(); ++i) {
+		const VertexData& v = m.vertices[i];
+
+		uint64_t key = 0;
+		for(uint8_t j = 0; j < 3; ++j) {
+			key = (key << 21) | (uint64_t(int64_t(
+				std::floor((v.position[j] - lo[j]) * inv_cell)))
+				& 0x1fffff);
+		}
+
+		auto r = clusters.try_emplace(key,
+			Cluster{uint32_t(new_vertices.size()), 0});
+		Cluster& c = r.first->second;
+		if(r.second) {
+			new_vertices.emplace_back(Vec3{0, 0, 0}, Vec3{0, 0, 0});
+		}
+
+		new_vertices[c.idx].position += v.position;
+		new_vertices[c.idx].normal += v.normal;
+		++c.count;
+
+		old_to_new[i] = c.idx;
+	}
+
+	for(const auto& kv: clusters) {
+		VertexData& v = new_vertices[kv.second.idx];
+		v.position /= float(kv.second.count);
+
+		const real len = glm::length(v.normal);
+		if(len > 0.0) {
+			v.normal /= len;
+		}
+	}
+
+	std::vector<uint32_t> new_indices;
+	for(size_t i = 0; i < m.indices.size(); i += 3) {
+		const uint32_t a = old_to_new[m.indices[i]];
+		const uint32_t b = old_to_new[m.indices[i+1]];
+		const uint32_t c = old_to_new[m.indices[i+2]];
+
+		if(a != b && b != c && c != a) {
+			new_indices.push_back(a);
+			new_indices.push_back(b);
+			new_indices.push_back(c);
+		}
+	}
+
+	std::cout << "Context simplified from " << m.vertices.size()
+		<< " to " << new_vertices.size() << " vertices." << std::endl;
+
+	m.vertices = std::move(new_vertices);
+	m.indices = std::move(new_indices);
+
+	// Vertices are no longer grouped by submesh.
+	m.submeshes.clear();
+	m.submeshes.push_back({"", 0, uint32_t(m.vertices.size()),
+		0, uint32_t(m.indices.size())});
+}
+
+void load_scene_with_context(const std::string& filename,
+	const std::string& context_filename, real context_lod,
+	const Quat& rotation, real& scale,
+	Scene& receivers, Scene& casters)
+{
+	receivers = import_scene_from_file(filename, false);
+	Scene context = import_scene_from_file(context_filename, false);
+
+	// Simplification works on the whole context at once.
+	if(context_lod > 0.0) {
+		context = context.flatten();
+		cluster_vertices(context.geometry, context_lod);
+	}
+
+	normalize({&receivers, &context}, rotation, scale);
+
+	// Receivers cast shadows too, so they come first in the
+	// casters, followed by the context.
+	casters = receivers;
+	Mesh& geom = casters.geometry;
+
+	const uint32_t base = geom.vertices.size();
+	const uint32_t idx_base = geom.indices.size();
+	const uint32_t sm_base = geom.submeshes.size();
+
+	geom.vertices.insert(geom.vertices.end(),
+		context.geometry.vertices.begin(),
+		context.geometry.vertices.end());
+
+	geom.indices.reserve(geom.indices.size()
+		+ context.geometry.indices.size());
+	for(uint32_t idx: context.geometry.indices) {
+		geom.indices.push_back(base + idx);
+	}
+
+	for(auto sm: context.geometry.submeshes) {
+		sm.first_vertex += base;
+		sm.first_index += idx_base;
+		geom.submeshes.push_back(std::move(sm));
+	}
+
+	for(auto inst: context.instances) {
+		inst.submesh += sm_base;
+		casters.instances.push_back(std::move(inst));
+	}
+}
+
+// Uniform grid over the points, for neighbourhood queries.
+// Points are sorted by cell, so each cell is a contiguous
+// range in the index array.
+class PointGrid
+{
+public:
+	PointGrid(const std::vector<VertexData>& vertices, real cell_size):
+		vs(vertices),
+		inv_cell(1.0 / cell_size),
+		cell(cell_size)
+	{
+		order.resize(vs.size());
+		std::vector<uint64_t> keys(vs.size());
+		for(uint32_t i = 0; i < vs.size(); ++i) {
+			order[i] = i;
+			keys[i] = key(coord(vs[i].position));
+		}
+
+		std::sort(order.begin(), order.end(),
+			[&](uint32_t a, uint32_t b) {
+				return keys[a] < keys[b];
+			}
+		);
+
+		for(uint32_t i = 0; i < order.size();) {
+			const uint64_t k = keys[order[i]];
+			uint32_t end = i + 1;
+			while(end < order.size() && keys[order[end]] == k) {
+				++end;
+			}
+			cells.emplace(k, std::make_pair(i, end));
+			i = end;
+		}
+
+		// No neighbour can be farther than this many rings.
+		max_ring = int32_t(std::ceil(2.0 * inv_cell)) + 1;
+	}
+
+	// Mean distance from vertex idx to its k nearest neighbours.
+	real mean_neighbour_distance(uint32_t idx, size_t k) const
+	{
+		const Vec3& p = vs[idx].position;
+		const auto c = coord(p);
+
+		// Max-heap of the squared distances of the k nearest so far.
+		std::vector<real> best;
+		best.reserve(k + 1);
+
+		for(int32_t r = 0; r <= max_ring; ++r) {
+			for(int32_t dx = -r; dx <= r; ++dx) {
+			for(int32_t dy = -r; dy <= r; ++dy) {
+			// Only the cells at the surface of the ring: inside
+			// the faces of x and y, only the two of z.
+			const bool on_side = std::abs(dx) == r || std::abs(dy) == r;
+			const int32_t dz_step = on_side || r == 0 ? 1 : 2 * r;
+			for(int32_t dz = -r; dz <= r; dz += dz_step) {
+				auto found = cells.find(key({
+					c[0] + dx, c[1] + dy, c[2] + dz
+				}));
+				if(found == cells.end()) {
+					continue;
+				}
+
+				for(uint32_t i = found->second.first;
+					i < found->second.second; ++i)
+				{
+					if(order[i] == idx) {
+						continue;
+					}
+
+					best.push_back(glm::distance2(p,
+						vs[order[i]].position));
+					std::push_heap(best.begin(), best.end());
+					if(best.size() > k) {
+						std::pop_heap(best.begin(),
+							best.end());
+						best.pop_back();
+					}
+				}
+			}}}
+
+			// Points in the next rings are at least
+			// r cells away, so we are done.
+			if(best.size() == k
+				&& best.front() <= (r * cell) * (r * cell))
+			{
+				break;
+			}
+		}
+
+		if(best.empty()) {
+			return cell;
+		}
+
+		real sum = 0.0;
+		for(real d2: best) {
+			sum += std::sqrt(d2);
+		}
+		return sum / best.size();
+	}
+
+private:
+	std::array<int32_t, 3> coord(const Vec3& p) const
+	{
+		return {
+			int32_t(std::floor(p.x * inv_cell)),
+			int32_t(std::floor(p.y * inv_cell)),
+			int32_t(std::floor(p.z * inv_cell))
+		};
+	}
+
+	static uint64_t key(const std::array<int32_t, 3>& c)
+	{
+		// 21 bits per axis is way more than we need.
+		uint64_t ret = 0;
+		for(int32_t v: c) {
+			ret = (ret << 21) | (uint64_t(v) & 0x1fffff);
+		}
+		return ret;
+	}
+
+	const std::vector<VertexData>& vs;
+	real inv_cell;
+	real cell;
+	int32_t max_ring;
+
+	std::vector<uint32_t> order;
+	std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> cells;
+};
+
+// Estimates the splat radius of each point as the mean distance to its
+// nearest neighbours, which is enough for the disks to overlap and cover
+// the surface without holes, even where the sampling is uneven.
+static std::vector<float> estimate_splat_radii(const Mesh& m)
+{
+	static const size_t NEIGHBOURS = 8;
+
+	// Assume the points sample a surface spanning the unit sphere,
+	// so there are about NEIGHBOURS points per grid cell.
+	const real cell_size = std::max(
+		real(2.0 * std::sqrt(real(NEIGHBOURS) / m.vertices.size())),
+		real(1.0 / 1024.0)
+	);
+	const PointGrid grid(m.vertices, cell_size);
+
+	std::vector<float> radii(m.vertices.size());
+
+	const unsigned num_threads =
+		std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> threads;
+	threads.reserve(num_threads);
+	for(unsigned t = 0; t < num_threads; ++t) {
+		// Contiguous chunks, so threads don't share cache lines.
+		const size_t begin = radii.size() * t / num_threads;
+		const size_t end = radii.size() * (t + 1) / num_threads;
+		threads.emplace_back([&, begin, end]() {
+			for(size_t i = begin; i < end; ++i) {
+				radii[i] = grid.mean_neighbour_distance(
+					i, NEIGHBOURS);
+			}
+		});
+	}
+	for(auto& t: threads) {
+		t.join();
+	}
+
+	return radii;
+}
+
+Scene load_point_cloud(const std::string& filename, const Quat& rotation,
+	real &scale)
+{
+	Scene ret = import_scene_from_file(filename, true);
+
+	normalize({&ret}, rotation, scale);
+
+	// Neighbourhoods are only meaningful with all the points in place.
+	ret = ret.flatten();
+
+	std::cout << "Estimating splat sizes... ";
+	std::cout.flush();
+
+	ret.geometry.splat_radius = estimate_splat_radii(ret.geometry);
+
+	std::cout << "done." << std::endl;
 
 	return ret;
 }
@@ -5,6 +5,8 @@
 #include <cstdint>
 
 #include "float.hpp"
+#include "tracker.hpp"
+#include "vegetation.hpp"
 
 struct VertexData
 {
@@ -22,9 +24,103 @@ struct Mesh
 {
 	std::vector<VertexData> vertices;
 	std::vector<uint32_t> indices;
+
+	// Parts of the mesh, as contiguous ranges of vertices and indices.
+	// Indices are global, not relative to the submesh.
+	struct Submesh
+	{
+		std::string name;
+		uint32_t first_vertex;
+		uint32_t num_vertices;
+		uint32_t first_index;
+		uint32_t num_indices;
+	};
+	std::vector<Submesh> submeshes;
+
+	// Only set for point clouds, which have no indices:
+	// radius of the disk around each vertex that
+	// represents the surface.
+	std::vector<float> splat_radius;
+
+	bool is_point_cloud() const
+	{
+		return !splat_radius.empty();
+	}
+};
+
+// Model made of instances of unique geometry. Each submesh of the
+// geometry is an unique mesh, and each instance places one of them
+// in the model.
+struct Scene
+{
+	Mesh geometry;
+
+	struct Instance
+	{
+		uint32_t submesh;
+		Mat4 transform;
+		std::string name;
+
+		// 1-based index into trackers, or 0 if the instance is fixed.
+		uint32_t tracker = 0;
+
+		// 1-based index into vegetation, or 0 if the instance is opaque.
+		uint32_t vegetation = 0;
+	};
+
+	// Instances of the same submesh are contiguous.
+	std::vector<Instance> instances;
+
+	// Groups of sun tracking instances.
+	std::vector<TrackerGroup> trackers;
+
+	// Groups of semi-transparent instances.
+	std::vector<VegetationGroup> vegetation;
+
+	// Total number of vertices, over all the instances.
+	size_t instanced_vertex_count() const;
+
+	// All the instances transformed into a single mesh, with vertices
+	// in the order of instances, and a single identity instance.
+	// Trackers are flattened at rest.
+	Scene flatten() const;
+
+	// Sets the tracker groups, and assigns each instance to the first
+	// group matching its name. Returns the number of tracking instances.
+	size_t assign_trackers(const std::vector<TrackerGroup>& groups);
+
+	// Same as assign_trackers(), for vegetation groups.
+	size_t assign_vegetation(const std::vector<VegetationGroup>& groups);
 };
 
-Mesh load_scene(const std::string& filename, const Quat& rotation,
+// A vertex of the geometry, as placed by an instance.
+struct Receiver
+{
+	uint32_t vertex;
+	uint32_t instance;
+};
+
+Scene load_scene(const std::string& filename, const Quat& rotation,
 	real& scale, real filter_cutoff);
 
+// Loads the receivers model together with a context model, which only casts
+// shadows. Both are normalized as if they were a single model. If context_lod
+// is positive, the context is simplified by merging vertices closer than it.
+// The casters output contains both the receivers and the context, with
+// the instances of receivers first, in the same order.
+void load_scene_with_context(const std::string& filename,
+	const std::string& context_filename, real context_lod,
+	const Quat& rotation, real& scale,
+	Scene& receivers, Scene& casters);
+
+// Loads a point cloud with normals, where every point is both a receiver
+// and a caster. Points are normalized like in load_scene(), and the splat
+// radius of each point is estimated from the density of its neighbourhood.
+Scene load_point_cloud(const std::string& filename, const Quat& rotation,
+	real& scale);
+
+// Wraps a mesh built in memory, of triangles, in a scene with a single
+// identity instance, normalized like in load_scene().
+Scene make_scene(Mesh mesh, const Quat& rotation, real& scale);
+
 void refine(Mesh& m, float max_length);
@@ -0,0 +1,115 @@
+#include <cmath>
+
+#include "panel_array.hpp"
+
+// Adds a grid over the unit square in the xz plane, centered at
+// origin, facing +y or -y, as a new submesh.
+static void add_panel_side(Mesh& m, uint32_t res, bool back,
+	const std::string& name)
+{
+	const uint32_t first_vertex = m.vertices.size();
+	const uint32_t first_index = m.indices.size();
+	const Vec3 normal{0.0f, back ? -1.0f : 1.0f, 0.0f};
+
+	for(uint32_t i = 0; i <= res; ++i) {
+		for(uint32_t j = 0; j <= res; ++j) {
+			m.vertices.emplace_back(Vec3{
+				real(i) / res - 0.5f, 0.0f, real(j) / res - 0.5f
+			}, normal);
+		}
+	}
+
+	// Counter-clockwise seen from the side the normal points to.
+	auto idx = [&](uint32_t i, uint32_t j) {
+		return first_vertex + i * (res + 1) + j;
+	};
+	for(uint32_t i = 0; i < res; ++i) {
+		for(uint32_t j = 0; j < res; ++j) {
+			const uint32_t quad[] = {
+				idx(i, j), idx(i, j + 1),
+				idx(i + 1, j + 1), idx(i + 1, j)
+			};
+			const uint8_t tris[] = {0, 1, 2, 0, 2, 3};
+			for(uint8_t k = 0; k < 6; ++k) {
+				m.indices.push_back(quad[back
+					? tris[5 - k] : tris[k]]);
+			}
+		}
+	}
+
+	m.submeshes.push_back({name, first_vertex,
+		uint32_t(m.vertices.size()) - first_vertex,
+		first_index, uint32_t(m.indices.size()) - first_index});
+}
+
+Scene make_panel_array(const PanelArray& pa)
+{
+	Scene ret;
+	add_panel_side(ret.geometry, pa.resolution, false, "panel");
+	add_panel_side(ret.geometry, pa.resolution, true, "panel-back");
+
+	for(uint32_t side = 0; side < 2; ++side) {
+		for(uint32_t r = 0; r < pa.rows; ++r) {
+			for(uint32_t p = 0; p < pa.panels_per_row; ++p) {
+				ret.instances.push_back({side, Mat4{1.0f},
+					"row" + std::to_string(r)
+					+ "-panel" + std::to_string(p)});
+			}
+		}
+	}
+
+	return ret;
+}
+
+static real tilt_angle(const PanelArray& pa, real tilt)
+{
+	// Tilting around +x turns the normal from up to south (+z).
+	return (pa.facing_north ? -tilt : tilt) * M_PI / 180.0;
+}
+
+void place_panel_array(Scene& scene, const PanelArray& pa,
+	real tilt, real pitch, real scale)
+{
+	const real angle = tilt_angle(pa, tilt);
+	const real height = pa.clearance
+		+ 0.5 * pa.panel_length * std::sin(std::abs(angle));
+
+	const size_t count = size_t(pa.rows) * pa.panels_per_row;
+	for(size_t i = 0; i < scene.instances.size(); ++i) {
+		const uint32_t r = (i % count) / pa.panels_per_row;
+		const uint32_t p = (i % count) % pa.panels_per_row;
+
+		const Vec3 center{
+			real(p - 0.5 * (pa.panels_per_row - 1)) * pa.panel_width,
+			height,
+			real(r - 0.5 * (pa.rows - 1)) * pitch
+		};
+
+		// Scale of the unit panel, then rotation around x,
+		// then translation, all divided by scale.
+		const real c = std::cos(angle) / scale;
+		const real s = std::sin(angle) / scale;
+		Mat4& t = scene.instances[i].transform;
+		t[0] = Vec4{pa.panel_width / scale, 0.0f, 0.0f, 0.0f};
+		t[1] = Vec4{0.0f, c, s, 0.0f};
+		t[2] = Vec4{0.0f, -s * pa.panel_length, c * pa.panel_length, 0.0f};
+		t[3] = Vec4{center / scale, 1.0f};
+	}
+}
+
+real panel_array_radius(const PanelArray& pa, real max_pitch)
+{
+	const real half_width = 0.5 * pa.panels_per_row * pa.panel_width;
+	const real half_depth = 0.5 * ((pa.rows - 1) * max_pitch
+		+ pa.panel_length);
+	const real height = pa.clearance + pa.panel_length;
+
+	return std::sqrt(half_width * half_width + half_depth * half_depth
+		+ height * height);
+}
+
+Vec3 panel_array_normal(const PanelArray& pa, real tilt)
+{
+	const real angle = tilt_angle(pa, tilt);
+	return Vec3{0.0, std::cos(angle), std::sin(angle)};
+}
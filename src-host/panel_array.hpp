@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include "float.hpp"
+#include "mesh_tools.hpp"
+
+// Ground mounted array of fixed tilt panel rows, running east to
+// west, and facing the equator. Lengths are in meters.
+struct PanelArray
+{
+	uint32_t rows = 10;
+	uint32_t panels_per_row = 20;
+
+	// Panel size along the row, and up the slope:
+	real panel_width = 1.0;
+	real panel_length = 2.0;
+
+	// Height of the lower edge of the panels:
+	real clearance = 0.5;
+
+	// Cells along each side of a panel, with
+	// receivers at the corners of the cells:
+	uint32_t resolution = 4;
+
+	bool facing_north = false;
+};
+
+// Panels of the array, as instances of a single panel mesh: first the
+// front sides, where the receivers are, then the back sides, in the
+// same order, which only cast shadows. The instances must be placed
+// with place_panel_array() before use.
+Scene make_panel_array(const PanelArray& pa);
+
+// Places the panels with the given tilt and row pitch (i.e. distance
+// between rows), in degrees and meters, divided by scale.
+void place_panel_array(Scene& scene, const PanelArray& pa,
+	real tilt, real pitch, real scale);
+
+// Radius of a sphere around the array with the largest pitch. Used as
+// scale, all the variants of the array fit in the normalized space.
+real panel_array_radius(const PanelArray& pa, real max_pitch);
+
+// Normal of the front of the panels, for the given tilt.
+Vec3 panel_array_normal(const PanelArray& pa, real tilt);
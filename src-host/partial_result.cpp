@@ -0,0 +1,192 @@
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "partial_result.hpp"
+
+namespace {
+
+const uint32_t PARTIAL_VERSION = 4;
+
+template<class T>
+void put(std::ostream& out, const T& v)
+{
+	out.write(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+template<class T>
+void put_vector(std::ostream& out, const std::vector<T>& v)
+{
+	put(out, uint64_t(v.size()));
+	out.write(reinterpret_cast<const char*>(v.data()),
+		v.size() * sizeof(T));
+}
+
+template<class T>
+void get(std::istream& in, T& v)
+{
+	in.read(reinterpret_cast<char*>(&v), sizeof v);
+}
+
+template<class T>
+void get_vector(std::istream& in, std::vector<T>& v)
+{
+	uint64_t size = 0;
+	get(in, size);
+	if(!in || size > (uint64_t(1) << 40) / sizeof(T)) {
+		throw std::runtime_error("Malformed partial result file.\n");
+	}
+	v.resize(size);
+	in.read(reinterpret_cast<char*>(v.data()), size * sizeof(T));
+}
+
+}
+
+void PartialResult::add(const PartialResult& other)
+{
+	if(num_shards != other.num_shards || run != other.run
+		|| latitude != other.latitude
+		|| longitude != other.longitude || num_suns != other.num_suns
+		|| energy.size() != other.energy.size()
+		|| string_energy.size() != other.string_energy.size()
+		|| string_hourly.size() != other.string_hourly.size())
+	{
+		throw std::runtime_error(
+			"Partial results are not from the same run.\n"
+		);
+	}
+
+	directional_sum += other.directional_sum;
+	diffuse_sum += other.diffuse_sum;
+	time_sum += other.time_sum;
+	count += other.count;
+	processed += other.processed;
+
+	for(size_t i = 0; i < energy.size(); ++i) {
+		energy[i] += other.energy[i];
+	}
+
+	solar_data.insert(solar_data.end(), other.solar_data.begin(),
+		other.solar_data.end());
+
+	for(size_t i = 0; i < string_energy.size(); ++i) {
+		string_energy[i] += other.string_energy[i];
+	}
+	for(size_t i = 0; i < string_hourly.size(); ++i) {
+		string_hourly[i] += other.string_hourly[i];
+	}
+}
+
+void PartialResult::scale(double factor)
+{
+	directional_sum *= float(factor);
+	diffuse_sum *= factor;
+	time_sum *= factor;
+
+	for(Vec4& e: energy) {
+		e *= float(factor);
+	}
+	for(Vec3& s: solar_data) {
+		s *= float(factor);
+	}
+	for(Vec2& e: string_energy) {
+		e *= float(factor);
+	}
+	for(float& e: string_hourly) {
+		e *= float(factor);
+	}
+}
+
+void save_partial_result(const std::string& fname, const PartialResult& r)
+{
+	const std::string tmp_name = fname + ".tmp";
+	std::ofstream out(tmp_name, std::ios::binary);
+	if(!out) {
+		throw std::runtime_error(
+			"Could not open output file \"" + tmp_name + "\".\n"
+		);
+	}
+
+	out.write("SOLMAPPR", 8);
+	put(out, PARTIAL_VERSION);
+	put(out, r.shard);
+	put(out, r.num_shards);
+	put(out, r.run);
+	put(out, r.latitude);
+	put(out, r.longitude);
+	put(out, r.num_suns);
+	put(out, r.processed);
+	put(out, r.directional_sum);
+	put(out, r.diffuse_sum);
+	put(out, r.time_sum);
+	put(out, r.count);
+	put_vector(out, r.energy);
+	put_vector(out, r.solar_data);
+	put_vector(out, r.string_energy);
+	put_vector(out, r.string_hourly);
+	out.close();
+
+	// Make sure the data is on disk before it replaces the old file.
+	const int fd = open(tmp_name.c_str(), O_RDONLY);
+	const bool synced = fd >= 0 && fsync(fd) == 0;
+	if(fd >= 0) {
+		close(fd);
+	}
+
+	if(!out || !synced || std::rename(tmp_name.c_str(), fname.c_str())) {
+		throw std::runtime_error(
+			"Could not write output file \"" + fname + "\".\n"
+		);
+	}
+}
+
+PartialResult load_partial_result(const std::string& fname)
+{
+	std::ifstream in(fname, std::ios::binary);
+	if(!in) {
+		throw std::runtime_error(
+			"Could not open partial result file \"" + fname + "\".\n"
+		);
+	}
+
+	char magic[8];
+	uint32_t version = 0;
+	in.read(magic, 8);
+	get(in, version);
+	if(!in || std::memcmp(magic, "SOLMAPPR", 8) != 0
+		|| version != PARTIAL_VERSION)
+	{
+		throw std::runtime_error(
+			"\"" + fname + "\" is not a partial result file.\n"
+		);
+	}
+
+	PartialResult r;
+	get(in, r.shard);
+	get(in, r.num_shards);
+	get(in, r.run);
+	get(in, r.latitude);
+	get(in, r.longitude);
+	get(in, r.num_suns);
+	get(in, r.processed);
+	get(in, r.directional_sum);
+	get(in, r.diffuse_sum);
+	get(in, r.time_sum);
+	get(in, r.count);
+	get_vector(in, r.energy);
+	get_vector(in, r.solar_data);
+	get_vector(in, r.string_energy);
+	get_vector(in, r.string_hourly);
+
+	if(!in || r.num_shards == 0 || r.shard >= r.num_shards) {
+		throw std::runtime_error(
+			"Malformed partial result file \"" + fname + "\".\n"
+		);
+	}
+
+	return r;
+}
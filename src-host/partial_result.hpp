@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "float.hpp"
+
+// Accumulated results of a run over a subset of the sun samples,
+// before any conversion. Results of disjoint subsets of the same
+// run add up exactly to the result over their union, so a run can
+// be split in shards, computed apart, and merged afterwards.
+struct PartialResult
+{
+	// Which of the interleaved subsets of the sun samples this is.
+	uint32_t shard = 0;
+	uint32_t num_shards = 1;
+
+	// Identify the run the shards belong to: a hash of the models and
+	// of every option the results depend on, besides the shard.
+	uint64_t run = 0;
+	double latitude = 0.0;
+	double longitude = 0.0;
+	uint64_t num_suns = 0;
+
+	// How many sun samples of the shard were processed,
+	// in order, which is where a checkpoint resumes from.
+	uint64_t processed = 0;
+
+	// The processor totals, see ShadowProcessor.
+	Vec3 directional_sum{0.0f, 0.0f, 0.0f};
+	double diffuse_sum = 0.0;
+	double time_sum = 0.0;
+	uint64_t count = 0;
+
+	// Lit directional energy of each selected receiver in xyz,
+	// and its projection on the receiver's normal in w.
+	std::vector<Vec4> energy;
+
+	// Direct incidence vector of each sun sample rendered.
+	std::vector<Vec3> solar_data;
+
+	// Energy of each string, with and without mismatch, and
+	// with mismatch, by string and then by hour of the year.
+	std::vector<Vec2> string_energy;
+	std::vector<float> string_hourly;
+
+	// Adds the results of another shard of the same run.
+	void add(const PartialResult& other);
+
+	// Multiplies the sums by the factor, e.g. to estimate the results
+	// over all the sun samples from the results over a stratified part
+	// of them. The hourly energy of the strings is scaled as well, but
+	// the hours not sampled are left with no energy.
+	void scale(double factor);
+};
+
+// Whether the sun sample of the given index belongs to the shard.
+inline bool in_shard(size_t sun_idx, uint32_t shard, uint32_t num_shards)
+{
+	return sun_idx % num_shards == shard;
+}
+
+// Binary file, little endian, starting with "SOLMAPPR" and a version.
+// It is written to a temporary file, synced and then renamed over the
+// given name, so the file is either the previous or the new version,
+// even if the process is killed in between.
+void save_partial_result(const std::string& fname, const PartialResult& r);
+
+PartialResult load_partial_result(const std::string& fname);
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/geometric.hpp>
+
+#include "planner.hpp"
+
+namespace {
+
+// Timesteps are planned up to this, in seconds, and
+// down to the table timestep halved this many times.
+const real MAX_TIMESTEP = 3600.0;
+const unsigned MAX_HALVINGS = 3;
+
+// Surfaces with less yearly energy than this fraction
+// of the best oriented one are not considered.
+const double MIN_RELATIVE_ENERGY = 0.05;
+
+const uint32_t MIN_FRAME_SIZE = 1024;
+const uint32_t MAX_FRAME_SIZE = 8192;
+
+// Triangles sampled for the median edge.
+const size_t MAX_SAMPLED_TRIANGLES = 65536;
+
+// Samples of one day, from first to last, inclusive.
+struct Day
+{
+	size_t first;
+	size_t last;
+};
+
+// Each day is integrated with the trapezoidal rule, so its first and
+// last samples have half the coefficient of the ones in between.
+std::vector<Day> split_days(const std::vector<InstantaneousData>& suns)
+{
+	std::vector<Day> days;
+	size_t i = 0;
+	while(i < suns.size()) {
+		const double half = suns[i].coefficient;
+		size_t j = i + 1;
+		while(j < suns.size() && suns[j].coefficient > 1.5 * half) {
+			++j;
+		}
+		j = std::min(j, suns.size() - 1);
+		days.push_back({i, j});
+		i = j + 1;
+	}
+	return days;
+}
+
+// Horizontal, tilted 45°, and vertical, facing each cardinal direction.
+std::vector<Vec3> reference_normals(const Vec3& unit_north,
+	const Vec3& unit_up, const Vec3& unit_east)
+{
+	std::vector<Vec3> ret{unit_up};
+	for(const Vec3& facing: {unit_north, unit_east, -unit_north,
+		-unit_east})
+	{
+		ret.push_back(glm::normalize(unit_up + facing));
+		ret.push_back(facing);
+	}
+	return ret;
+}
+
+// Yearly direct energy on each of the unshaded surfaces.
+std::vector<double> integrate(const std::vector<InstantaneousData>& suns,
+	const std::vector<Vec3>& normals,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east)
+{
+	std::vector<double> ret(normals.size(), 0.0);
+	for(const auto& val: suns) {
+		const Vec3 dir = to_vec(val.pos, unit_north, unit_up,
+			unit_east);
+		const double e = val.coefficient * val.direct_power;
+		for(size_t i = 0; i < normals.size(); ++i) {
+			ret[i] += e * std::max(0.0f, glm::dot(normals[i], dir));
+		}
+	}
+	return ret;
+}
+
+// Largest difference of the integrals, in percent of the reference.
+real relative_error(const std::vector<double>& reference,
+	const std::vector<double>& other)
+{
+	const double best = *std::max_element(reference.begin(),
+		reference.end());
+
+	double ret = 0.0;
+	for(size_t i = 0; i < reference.size(); ++i) {
+		if(reference[i] > MIN_RELATIVE_ENERGY * best) {
+			ret = std::max(ret, std::abs(other[i] - reference[i])
+				/ reference[i]);
+		}
+	}
+	return 100.0 * ret;
+}
+
+// Memory of the device that can still be allocated.
+uint64_t device_budget(VkPhysicalDevice pd,
+	const VkPhysicalDeviceProperties& props)
+{
+	bool has_budget = false;
+	if(props.apiVersion >= VK_API_VERSION_1_1) {
+		uint32_t count;
+		chk_vk(vkEnumerateDeviceExtensionProperties(pd, nullptr,
+			&count, nullptr));
+		std::vector<VkExtensionProperties> exts(count);
+		chk_vk(vkEnumerateDeviceExtensionProperties(pd, nullptr,
+			&count, exts.data()));
+
+		for(const auto& e: exts) {
+			if(std::strcmp(e.extensionName,
+				VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+			{
+				has_budget = true;
+			}
+		}
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+	budget.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 mem{};
+	mem.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	if(has_budget) {
+		mem.pNext = &budget;
+		vkGetPhysicalDeviceMemoryProperties2(pd, &mem);
+	} else {
+		vkGetPhysicalDeviceMemoryProperties(pd, &mem.memoryProperties);
+	}
+
+	// Everything is allocated from the largest device local heap.
+	const auto& mp = mem.memoryProperties;
+	uint64_t ret = 0;
+	for(uint32_t i = 0; i < mp.memoryHeapCount; ++i) {
+		if(!(mp.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+			continue;
+		}
+
+		uint64_t available = mp.memoryHeaps[i].size;
+		if(has_budget) {
+			available = budget.heapBudget[i] > budget.heapUsage[i]
+				? budget.heapBudget[i] - budget.heapUsage[i] : 0;
+		}
+		ret = std::max(ret, available);
+	}
+	return ret;
+}
+
+}
+
+std::vector<InstantaneousData> coarsen(
+	const std::vector<InstantaneousData>& suns, unsigned stride)
+{
+	if(stride <= 1) {
+		return suns;
+	}
+
+	std::vector<InstantaneousData> ret;
+	ret.reserve(suns.size() / stride + 2 * 366);
+	for(const Day& d: split_days(suns)) {
+		const double dt = 2.0 * suns[d.first].coefficient;
+		const size_t n = d.last - d.first;
+
+		// Offsets of the kept samples in the day, each weighted
+		// by half of the intervals before and after it.
+		size_t prev = 0;
+		size_t off = 0;
+		for(;;) {
+			const size_t next = std::min(off + stride, n);
+			InstantaneousData val = suns[d.first + off];
+			val.coefficient = 0.5 * dt * double(next - prev);
+			ret.push_back(val);
+
+			if(off == n) {
+				break;
+			}
+			prev = off;
+			off = next;
+		}
+	}
+	return ret;
+}
+
+TimestepPlan plan_timestep(const std::vector<InstantaneousData>& suns,
+	real table_dt, real target,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east)
+{
+	const auto normals = reference_normals(unit_north, unit_up, unit_east);
+	auto integral = [&](unsigned stride) {
+		return integrate(coarsen(suns, stride), normals,
+			unit_north, unit_up, unit_east);
+	};
+
+	// Doubling the timestep of the trapezoidal rule quadruples its
+	// error, so the difference is 3 times the error of the table.
+	const auto table = integral(1);
+	const real table_error = relative_error(table, integral(2)) / 3.0;
+
+	if(table_error > target) {
+		TimestepPlan ret{table_dt, table_error};
+		for(unsigned i = 0; i < MAX_HALVINGS && ret.error > target; ++i) {
+			ret.timestep *= 0.5;
+			ret.error *= 0.25;
+		}
+		return ret;
+	}
+
+	TimestepPlan ret{table_dt, table_error};
+	for(unsigned stride = 2; stride * table_dt <= MAX_TIMESTEP; ++stride) {
+		const real error = table_error
+			+ relative_error(table, integral(stride));
+		if(error > target) {
+			break;
+		}
+		ret = {stride * table_dt, error};
+	}
+	return ret;
+}
+
+uint32_t plan_frame_size(const Mesh& normalized)
+{
+	std::vector<float> edges;
+	if(normalized.is_point_cloud()) {
+		const size_t step = std::max<size_t>(1,
+			normalized.splat_radius.size() / MAX_SAMPLED_TRIANGLES);
+		for(size_t i = 0; i < normalized.splat_radius.size(); i += step) {
+			edges.push_back(2.0f * normalized.splat_radius[i]);
+		}
+	} else {
+		const size_t num_tris = normalized.indices.size() / 3;
+		const size_t step = std::max<size_t>(1,
+			num_tris / MAX_SAMPLED_TRIANGLES);
+		for(size_t t = 0; t < num_tris; t += step) {
+			const uint32_t* tri = &normalized.indices[3 * t];
+			for(unsigned i = 0; i < 3; ++i) {
+				edges.push_back(glm::length(
+					normalized.vertices[tri[i]].position
+					- normalized.vertices[tri[(i + 1) % 3]].position
+				));
+			}
+		}
+	}
+
+	if(edges.empty()) {
+		return MIN_FRAME_SIZE;
+	}
+
+	auto median = edges.begin() + edges.size() / 2;
+	std::nth_element(edges.begin(), median, edges.end());
+
+	// Frames span the diameter of the unit sphere.
+	uint32_t frame_size = MIN_FRAME_SIZE;
+	while(frame_size < MAX_FRAME_SIZE && 2.0f / frame_size > *median) {
+		frame_size *= 2;
+	}
+	return frame_size;
+}
+
+std::vector<DevicePlan> plan_devices(VkInstance vk,
+	const Scene& shadow_scene, size_t num_receivers,
+	const StringLayout& strings, const TuningProfile& profile,
+	uint32_t& frame_size, size_t num_frames)
+{
+	const auto pds = used_devices(vk);
+	std::vector<VkPhysicalDeviceProperties> props(pds.size());
+	for(size_t i = 0; i < pds.size(); ++i) {
+		vkGetPhysicalDeviceProperties(pds[i], &props[i]);
+
+		const auto& limits = props[i].limits;
+		frame_size = std::min({frame_size,
+			limits.maxImageDimension2D,
+			limits.maxFramebufferWidth,
+			limits.maxFramebufferHeight});
+	}
+
+	const auto memory = ShadowProcessor::estimate_memory(shadow_scene,
+		num_receivers, strings, frame_size);
+
+	std::vector<DevicePlan> ret;
+	for(size_t i = 0; i < pds.size(); ++i) {
+		DevicePlan p;
+		p.name = props[i].deviceName;
+		p.tuning = profile.find(props[i], frame_size);
+		p.budget = device_budget(pds[i], props[i]);
+
+		// One slot is kept, even if over the budget.
+		auto bytes = [&] {
+			return memory.fixed
+				+ memory.per_slot * p.tuning.slots_per_queue;
+		};
+		while(p.tuning.slots_per_queue > 1 && bytes() > p.budget) {
+			--p.tuning.slots_per_queue;
+		}
+		p.bytes = bytes();
+
+		p.seconds = profile.frame_seconds(props[i], frame_size)
+			* num_frames;
+		ret.push_back(p);
+	}
+	return ret;
+}
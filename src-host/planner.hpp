@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "engine.hpp"
+#include "tuning.hpp"
+
+// Chooses the coarsest settings expected to meet an accuracy target,
+// and predicts what they cost, before anything is computed.
+
+struct TimestepPlan
+{
+	// Longest interval between sun samples, in seconds.
+	real timestep;
+
+	// Estimated error of the yearly direct energy
+	// on unshaded surfaces, in percent.
+	real error;
+};
+
+// Longest timestep, up to an hour, whose error is estimated to be within
+// the target, in percent. The error of the sun table, sampled at most
+// table_dt apart, is estimated on unshaded surfaces of many orientations,
+// from how much their yearly energy changes when every other sample is
+// left out, and is extrapolated to the other timesteps, assuming the
+// error of the trapezoidal rule, quadratic on the timestep. Shaded points
+// have larger errors, as shadows come and go in steps.
+TimestepPlan plan_timestep(const std::vector<InstantaneousData>& suns,
+	real table_dt, real target,
+	const Vec3& unit_north, const Vec3& unit_up, const Vec3& unit_east);
+
+// The same days, keeping only every stride-th sample of each day, and
+// its last, with the trapezoidal coefficients of the longer intervals.
+std::vector<InstantaneousData> coarsen(
+	const std::vector<InstantaneousData>& suns, unsigned stride);
+
+// Smallest frame size, a power of 2 from 1024 to 8192, whose pixels
+// are no larger than the median edge of the mesh, as the shadow maps
+// cover the unit sphere the models are normalized to.
+uint32_t plan_frame_size(const Mesh& normalized);
+
+struct DevicePlan
+{
+	std::string name;
+	ProcessorTuning tuning;
+
+	// Estimated device memory of the processor, and
+	// what is available to it, in bytes.
+	uint64_t bytes;
+	uint64_t budget;
+
+	// Estimated time to render all the frames, or
+	// 0 if the device is not tuned for the frame size.
+	double seconds;
+};
+
+// Plans the processor of each device it would be created on, with the
+// tuning from the profile, but with fewer slots if needed to fit in the
+// memory budget of the device, per VK_EXT_memory_budget, or in its
+// memory, if not supported. The frame size is reduced to what every
+// device supports.
+std::vector<DevicePlan> plan_devices(VkInstance vk,
+	const Scene& shadow_scene, size_t num_receivers,
+	const StringLayout& strings, const TuningProfile& profile,
+	uint32_t& frame_size, size_t num_frames);
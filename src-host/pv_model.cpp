@@ -0,0 +1,178 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+
+#include "electrical.hpp"
+#include "pv_model.hpp"
+
+Weather load_weather(const std::string& filename)
+{
+	std::ifstream fd(filename);
+	if(!fd) {
+		throw std::runtime_error(
+			"Could not open weather file \"" + filename + "\".\n"
+		);
+	}
+
+	// Find the columns in the header.
+	std::string line;
+	std::getline(fd, line);
+
+	int temp_col = -1;
+	int wind_col = -1;
+	{
+		std::istringstream header(line);
+		std::string name;
+		for(int col = 0; std::getline(header, name, ','); ++col) {
+			name.erase(0, name.find_first_not_of(" \t\r\""));
+			name.erase(name.find_last_not_of(" \t\r\"") + 1);
+			if(name == "temp_air") {
+				temp_col = col;
+			} else if(name == "wind_speed") {
+				wind_col = col;
+			}
+		}
+	}
+
+	if(temp_col < 0) {
+		throw std::runtime_error(
+			"Weather file has no \"temp_air\" column.\n"
+		);
+	}
+
+	Weather ret;
+	ret.temp_air.reserve(HOURS_PER_YEAR);
+	ret.wind_speed.reserve(HOURS_PER_YEAR);
+	while(std::getline(fd, line)) {
+		if(line.find_first_not_of(" \t\r") == std::string::npos) {
+			continue;
+		}
+
+		float temp = 0.0f;
+		float wind = 1.0f;
+		bool has_temp = false;
+
+		std::istringstream row(line);
+		std::string field;
+		for(int col = 0; std::getline(row, field, ','); ++col) {
+			if(col != temp_col && col != wind_col) {
+				continue;
+			}
+
+			char *endptr;
+			const float v = std::strtof(field.c_str(), &endptr);
+			if(endptr == field.c_str()) {
+				throw std::runtime_error(
+					"Invalid number in weather file.\n"
+				);
+			}
+
+			if(col == temp_col) {
+				temp = v;
+				has_temp = true;
+			} else {
+				wind = v;
+			}
+		}
+
+		if(!has_temp) {
+			throw std::runtime_error(
+				"Missing temperature in weather file.\n"
+			);
+		}
+
+		ret.temp_air.push_back(temp);
+		ret.wind_speed.push_back(wind);
+	}
+
+	if(ret.temp_air.size() != HOURS_PER_YEAR) {
+		throw std::runtime_error(
+			"Weather file must have one row per hour of the year.\n"
+		);
+	}
+
+	return ret;
+}
+
+namespace {
+
+// Evaluates a single string over the year. The loop has no
+// branches, so it is vectorized by the compiler.
+double evaluate_string(const PvModel& m, const Weather& weather,
+	const float* poa, uint32_t panels, float* ac)
+{
+	const float* temp_air = weather.temp_air.data();
+	const float* wind_speed = weather.wind_speed.data();
+
+	const float pdc0 = m.pdc0 * panels;
+	const float gamma = m.gamma;
+	const float u0 = m.u0;
+	const float u1 = m.u1;
+
+	// PVWatts inverter, whose efficiency curve
+	// is normalized to a reference of 0.9637.
+	const float eta_nom = m.inverter_efficiency;
+	const float pac0 = pdc0 / m.dc_ac_ratio;
+	const float inv_pdc0 = eta_nom / pac0;
+	const float eta_scale = eta_nom / 0.9637f;
+
+	double total = 0.0;
+	for(uint32_t h = 0; h < HOURS_PER_YEAR; ++h) {
+		const float g = poa[h];
+		const float t_cell = temp_air[h]
+			+ g / (u0 + u1 * wind_speed[h]);
+
+		const float pdc = std::max(0.0f, pdc0 * g * 0.001f
+			* (1.0f + gamma * (t_cell - 25.0f)));
+
+		const float zeta = std::max(1e-6f, pdc * inv_pdc0);
+		const float eta = eta_scale
+			* (-0.0162f * zeta - 0.0059f / zeta + 0.9858f);
+		const float pac = std::clamp(eta * pdc, 0.0f, pac0);
+
+		// A whole hour at this power, in Wh:
+		ac[h] = pac;
+		total += pac;
+	}
+
+	return total * 0.001;
+}
+
+}
+
+PvYield evaluate_pv(const PvModel& model, const Weather& weather,
+	const std::vector<float>& poa,
+	const std::vector<uint32_t>& panel_count, unsigned num_threads)
+{
+	const size_t num_strings = panel_count.size();
+
+	PvYield ret;
+	ret.hourly_ac.resize(num_strings * HOURS_PER_YEAR);
+	ret.annual_ac.resize(num_strings);
+
+	// Each thread takes every num_threads-th string.
+	num_threads = std::max(1u, std::min<unsigned>(num_threads,
+		num_strings));
+
+	std::vector<std::thread> workers;
+	workers.reserve(num_threads);
+	for(unsigned t = 0; t < num_threads; ++t) {
+		workers.emplace_back([&, t] {
+			for(size_t s = t; s < num_strings; s += num_threads) {
+				const size_t offset = s * HOURS_PER_YEAR;
+				ret.annual_ac[s] = evaluate_string(model,
+					weather, &poa[offset], panel_count[s],
+					&ret.hourly_ac[offset]);
+			}
+		});
+	}
+
+	for(auto& w: workers) {
+		w.join();
+	}
+
+	return ret;
+}
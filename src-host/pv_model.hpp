@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "float.hpp"
+
+// Hourly weather over the year, one entry per hour from
+// 2017-01-01 00:00 UTC, the same hours of the sun positions.
+struct Weather
+{
+	// Ambient temperature, in °C.
+	std::vector<float> temp_air;
+
+	// Wind speed, in m/s.
+	std::vector<float> wind_speed;
+};
+
+// Loads a CSV file with a header line naming the columns, where
+// "temp_air" is required and "wind_speed" is optional (1 m/s if
+// missing). Other columns are ignored. It must have 8760 rows.
+Weather load_weather(const std::string& filename);
+
+// PVWatts-like model of the panels and the inverter of a string,
+// with the Faiman model for the cell temperature.
+struct PvModel
+{
+	// DC power of a panel at standard test conditions, in W.
+	real pdc0 = 300.0;
+
+	// Temperature coefficient of the power, per °C.
+	real gamma = -0.0037;
+
+	// Faiman heat loss coefficients, in W/(m²·K) and W·s/(m³·K).
+	real u0 = 25.0;
+	real u1 = 6.84;
+
+	// Nominal efficiency of the inverter.
+	real inverter_efficiency = 0.96;
+
+	// Ratio of the DC power of the string to the inverter AC rating.
+	real dc_ac_ratio = 1.2;
+};
+
+struct PvYield
+{
+	// AC energy of each string at each hour, in Wh,
+	// by string and then by hour of the year.
+	std::vector<float> hourly_ac;
+
+	// Yearly AC energy of each string, in kWh.
+	std::vector<double> annual_ac;
+};
+
+// Evaluates the model over the irradiance on the plane of the panels,
+// in W/m², laid out like PvYield::hourly_ac, for strings with the
+// given number of panels. Strings are split among the threads.
+PvYield evaluate_pv(const PvModel& model, const Weather& weather,
+	const std::vector<float>& poa,
+	const std::vector<uint32_t>& panel_count, unsigned num_threads);
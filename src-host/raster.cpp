@@ -0,0 +1,317 @@
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <limits>
+
+#include "raster.hpp"
+
+float HeightRaster::sample(double x, double y) const
+{
+	// Continuous position in cell units, relative to the
+	// center of the first cell.
+	const double fc = (x - x0) / cell_size - 0.5;
+	const double fr = rows - (y - y0) / cell_size - 0.5;
+
+	if(fc < 0.0 || fr < 0.0 || fc > cols - 1 || fr > rows - 1) {
+		return nodata;
+	}
+
+	const uint32_t c = std::min(uint32_t(fc), cols - 2);
+	const uint32_t r = std::min(uint32_t(fr), rows - 2);
+	const float tc = fc - c;
+	const float tr = fr - r;
+
+	const float h[4] = {
+		at(c, r), at(c + 1, r),
+		at(c, r + 1), at(c + 1, r + 1)
+	};
+	for(float v: h) {
+		if(!is_valid(v)) {
+			return nodata;
+		}
+	}
+
+	return (h[0] * (1.0f - tc) + h[1] * tc) * (1.0f - tr)
+		+ (h[2] * (1.0f - tc) + h[3] * tc) * tr;
+}
+
+HeightRaster load_esri_ascii_grid(const std::string& filename)
+{
+	std::ifstream fd(filename);
+	if(!fd) {
+		throw std::runtime_error(
+			"Could not open raster file \"" + filename + "\".\n"
+		);
+	}
+
+	HeightRaster ret;
+	bool center_registered = false;
+
+	// Read the header, made of key-value pairs, until
+	// the first number of the height data is found.
+	for(;;) {
+		fd >> std::ws;
+		const int next = fd.peek();
+		if(next == EOF || std::isdigit(next) || next == '-'
+			|| next == '+' || next == '.')
+		{
+			break;
+		}
+
+		std::string key;
+		double value;
+		if(!(fd >> key >> value)) {
+			throw std::runtime_error("Malformed raster header.\n");
+		}
+		std::transform(key.begin(), key.end(), key.begin(),
+			[](unsigned char c) { return std::tolower(c); });
+
+		if(key == "ncols") {
+			ret.cols = value;
+		} else if(key == "nrows") {
+			ret.rows = value;
+		} else if(key == "xllcorner") {
+			ret.x0 = value;
+		} else if(key == "yllcorner") {
+			ret.y0 = value;
+		} else if(key == "xllcenter") {
+			ret.x0 = value;
+			center_registered = true;
+		} else if(key == "yllcenter") {
+			ret.y0 = value;
+			center_registered = true;
+		} else if(key == "cellsize") {
+			ret.cell_size = value;
+		} else if(key == "nodata_value") {
+			ret.nodata = value;
+		}
+	}
+
+	if(ret.cols < 2 || ret.rows < 2 || ret.cell_size <= 0.0) {
+		throw std::runtime_error("Invalid raster dimensions.\n");
+	}
+
+	if(center_registered) {
+		ret.x0 -= ret.cell_size * 0.5;
+		ret.y0 -= ret.cell_size * 0.5;
+	}
+
+	ret.heights.resize(size_t(ret.cols) * ret.rows);
+	for(float& h: ret.heights) {
+		if(!(fd >> h)) {
+			throw std::runtime_error(
+				"Raster file has less data than declared.\n"
+			);
+		}
+	}
+
+	return ret;
+}
+
+void save_esri_ascii_grid(const std::string& filename,
+	const HeightRaster& reference, const std::vector<float>& values)
+{
+	std::ofstream fd(filename);
+
+	fd.precision(10);
+	fd <<	"ncols " << reference.cols << "\n"
+		"nrows " << reference.rows << "\n"
+		"xllcorner " << reference.x0 << "\n"
+		"yllcorner " << reference.y0 << "\n"
+		"cellsize " << reference.cell_size << "\n"
+		"NODATA_value " << reference.nodata << "\n";
+
+	fd.precision(7);
+	for(uint32_t r = 0; r < reference.rows; ++r) {
+		for(uint32_t c = 0; c < reference.cols; ++c) {
+			const size_t idx = size_t(r) * reference.cols + c;
+			if(c) {
+				fd << ' ';
+			}
+			fd << (reference.is_valid(reference.heights[idx])
+				? values[idx] : reference.nodata);
+		}
+		fd << '\n';
+	}
+}
+
+namespace {
+
+// TIFF field types.
+enum TiffType: uint16_t {
+	TIFF_ASCII = 2,
+	TIFF_SHORT = 3,
+	TIFF_LONG = 4,
+	TIFF_DOUBLE = 12
+};
+
+// Entry of the image file directory, with its values
+// already encoded, in little endian.
+struct TiffTag
+{
+	uint16_t id;
+	TiffType type;
+	uint32_t count;
+	std::string data;
+};
+
+template<class T>
+TiffTag tiff_tag(uint16_t id, TiffType type, const std::vector<T>& values)
+{
+	TiffTag tag{id, type, uint32_t(values.size()), {}};
+	tag.data.resize(values.size() * sizeof(T));
+	std::memcpy(&tag.data[0], values.data(), tag.data.size());
+	return tag;
+}
+
+template<class T>
+void put(std::ostream& out, const T& v)
+{
+	out.write(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+}
+
+void save_geotiff(const std::string& filename, const HeightRaster& reference,
+	const std::vector<float>& values, double lat, double lon)
+{
+	const uint32_t cols = reference.cols;
+	const uint32_t rows = reference.rows;
+	const uint32_t row_size = cols * sizeof(float);
+
+	// GeoKey directory: version 1.1.0, then each key as
+	// (id, location, count, value or index). Locations
+	// are either 0, for the value inline, or the tag
+	// holding the double parameters.
+	enum: uint16_t { GEO_DOUBLE_PARAMS = 34736 };
+	const std::vector<uint16_t> geo_keys = {
+		1, 1, 0, 12,
+		1024, 0, 1, 1, // GTModelType: projected
+		1025, 0, 1, 1, // GTRasterType: pixel is area
+		2048, 0, 1, 4326, // GeographicType: WGS 84
+		3072, 0, 1, 32767, // ProjectedCSType: user defined
+		3074, 0, 1, 32767, // Projection: user defined
+		3075, 0, 1, 1, // ProjCoordTrans: transverse Mercator
+		3076, 0, 1, 9001, // ProjLinearUnits: meter
+		3080, GEO_DOUBLE_PARAMS, 1, 0, // ProjNatOriginLong
+		3081, GEO_DOUBLE_PARAMS, 1, 1, // ProjNatOriginLat
+		3082, GEO_DOUBLE_PARAMS, 1, 2, // ProjFalseEasting
+		3083, GEO_DOUBLE_PARAMS, 1, 3, // ProjFalseNorthing
+		3092, GEO_DOUBLE_PARAMS, 1, 4 // ProjScaleAtNatOrigin
+	};
+	const std::vector<double> geo_doubles = {lon, lat, 0.0, 0.0, 1.0};
+
+	// The raster coordinates refer to the lower left corner,
+	// but the tie point is the upper left.
+	const double top = reference.y0 + rows * reference.cell_size;
+
+	std::string nodata = std::to_string(reference.nodata);
+	nodata.push_back('\0');
+
+	// One strip per row. Offsets are filled
+	// once the size of the header is known.
+	std::vector<uint32_t> strip_offsets(rows);
+	const std::vector<uint32_t> strip_sizes(rows, row_size);
+
+	// Sorted by id, as required.
+	std::vector<TiffTag> tags = {
+		tiff_tag<uint32_t>(256, TIFF_LONG, {cols}), // ImageWidth
+		tiff_tag<uint32_t>(257, TIFF_LONG, {rows}), // ImageLength
+		tiff_tag<uint16_t>(258, TIFF_SHORT, {32}), // BitsPerSample
+		tiff_tag<uint16_t>(259, TIFF_SHORT, {1}), // Compression: none
+		tiff_tag<uint16_t>(262, TIFF_SHORT, {1}), // Photometric
+		tiff_tag(273, TIFF_LONG, strip_offsets), // StripOffsets
+		tiff_tag<uint16_t>(277, TIFF_SHORT, {1}), // SamplesPerPixel
+		tiff_tag<uint32_t>(278, TIFF_LONG, {1}), // RowsPerStrip
+		tiff_tag(279, TIFF_LONG, strip_sizes), // StripByteCounts
+		tiff_tag<uint16_t>(284, TIFF_SHORT, {1}), // PlanarConfig
+		tiff_tag<uint16_t>(339, TIFF_SHORT, {3}), // SampleFormat: float
+		tiff_tag<double>(33550, TIFF_DOUBLE, { // ModelPixelScale
+			reference.cell_size, reference.cell_size, 0.0}),
+		tiff_tag<double>(33922, TIFF_DOUBLE, { // ModelTiepoint
+			0.0, 0.0, 0.0, reference.x0, top, 0.0}),
+		tiff_tag(34735, TIFF_SHORT, geo_keys), // GeoKeyDirectory
+		tiff_tag(GEO_DOUBLE_PARAMS, TIFF_DOUBLE, geo_doubles),
+		{42113, TIFF_ASCII, uint32_t(nodata.size()), nodata} // GDAL_NODATA
+	};
+	const size_t strip_offsets_tag = 5;
+
+	// Layout: header, directory, values that don't fit in
+	// the directory entries, aligned to 8 bytes, and rows.
+	const uint64_t dir_offset = 8;
+	uint64_t offset = dir_offset + 2 + tags.size() * 12 + 4;
+	std::vector<uint32_t> value_offsets(tags.size(), 0);
+	for(size_t i = 0; i < tags.size(); ++i) {
+		if(tags[i].data.size() > 4) {
+			offset = (offset + 7) / 8 * 8;
+			value_offsets[i] = offset;
+			offset += tags[i].data.size();
+		}
+	}
+	offset = (offset + 7) / 8 * 8;
+
+	if(offset + uint64_t(rows) * row_size
+		> std::numeric_limits<uint32_t>::max())
+	{
+		throw std::runtime_error("Raster is too large for TIFF.\n");
+	}
+
+	for(uint32_t r = 0; r < rows; ++r) {
+		strip_offsets[r] = offset + uint64_t(r) * row_size;
+	}
+	tags[strip_offsets_tag] = tiff_tag(273, TIFF_LONG, strip_offsets);
+
+	std::ofstream out(filename, std::ios::binary);
+	if(!out) {
+		throw std::runtime_error(
+			"Could not open output file \"" + filename + "\".\n"
+		);
+	}
+
+	// Little endian, as the data.
+	out.write("II", 2);
+	put(out, uint16_t(42));
+	put(out, uint32_t(dir_offset));
+
+	put(out, uint16_t(tags.size()));
+	for(size_t i = 0; i < tags.size(); ++i) {
+		const TiffTag& t = tags[i];
+		put(out, t.id);
+		put(out, uint16_t(t.type));
+		put(out, t.count);
+		if(t.data.size() > 4) {
+			put(out, value_offsets[i]);
+		} else {
+			char inline_value[4] = {};
+			std::memcpy(inline_value, t.data.data(), t.data.size());
+			out.write(inline_value, 4);
+		}
+	}
+	put(out, uint32_t(0));
+
+	auto pad_to = [&](uint64_t offset) {
+		static const char zeros[8] = {};
+		out.write(zeros, offset - uint64_t(out.tellp()));
+	};
+
+	for(size_t i = 0; i < tags.size(); ++i) {
+		if(value_offsets[i]) {
+			pad_to(value_offsets[i]);
+			out.write(tags[i].data.data(), tags[i].data.size());
+		}
+	}
+	pad_to(strip_offsets[0]);
+
+	out.write(reinterpret_cast<const char*>(values.data()),
+		uint64_t(rows) * row_size);
+
+	if(!out) {
+		throw std::runtime_error(
+			"Could not write output file \"" + filename + "\".\n"
+		);
+	}
+}
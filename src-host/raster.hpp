@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Regular grid of heights, in meters, as stored in an ESRI ASCII
+// grid file (the plain text raster format every GIS tool exports).
+// Planimetric coordinates are assumed to be in meters, too, with
+// +x pointing east and +y pointing north.
+struct HeightRaster
+{
+	uint32_t cols = 0;
+	uint32_t rows = 0;
+
+	// Coordinates of the lower left corner of the raster.
+	double x0 = 0.0;
+	double y0 = 0.0;
+
+	// Side of the square cell.
+	double cell_size = 1.0;
+
+	// Value used for missing data.
+	float nodata = -9999.0f;
+
+	// Row major heights, first row is the northernmost.
+	std::vector<float> heights;
+
+	bool is_valid(float h) const
+	{
+		return h != nodata;
+	}
+
+	float at(uint32_t col, uint32_t row) const
+	{
+		return heights[size_t(row) * cols + col];
+	}
+
+	double cell_x(uint32_t col) const
+	{
+		return x0 + (col + 0.5) * cell_size;
+	}
+
+	double cell_y(uint32_t row) const
+	{
+		return y0 + (rows - row - 0.5) * cell_size;
+	}
+
+	// Bilinear interpolation of the height at a given position.
+	// Returns nodata if any of the surrounding cells is missing.
+	float sample(double x, double y) const;
+};
+
+HeightRaster load_esri_ascii_grid(const std::string& filename);
+
+// Saves values laid out like the reference raster, with the same
+// georeferencing, and missing data wherever the reference misses it.
+void save_esri_ascii_grid(const std::string& filename,
+	const HeightRaster& reference, const std::vector<float>& values);
+
+// Saves values laid out like the reference raster as a single band,
+// 32-bit float GeoTIFF. The planimetric coordinates of the reference are
+// taken as meters east and north of the given latitude and longitude,
+// in a transverse Mercator projection of WGS 84 centered there, which
+// is how a local tangent frame is expressed with standard GeoKeys.
+// Values are written as they are, nodata included.
+void save_geotiff(const std::string& filename, const HeightRaster& reference,
+	const std::vector<float>& values, double lat, double lon);
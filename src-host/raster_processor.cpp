@@ -0,0 +1,250 @@
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include "raster_processor.hpp"
+
+SweepGrid::SweepGrid(const HeightRaster& dsm, bool transposed):
+	rows{transposed ? dsm.cols : dsm.rows},
+	cols{transposed ? dsm.rows : dsm.cols}
+{
+	const size_t size = size_t(rows) * cols;
+	height.resize(size);
+	nx.resize(size);
+	ny.resize(size);
+	nz.resize(size);
+	incidence.resize(size, 0.0f);
+
+	// Height of a neighbor, if it exists and is valid.
+	auto neighbor = [&](long c, long r, float& h) {
+		if(c < 0 || r < 0 || c >= dsm.cols || r >= dsm.rows) {
+			return false;
+		}
+		h = dsm.at(c, r);
+		return dsm.is_valid(h);
+	};
+
+	// Slope along one axis, by central differences, falling
+	// back to one-sided differences at borders and holes.
+	auto slope = [&](float h, bool has_lo, float lo,
+		bool has_hi, float hi)
+	{
+		if(has_lo && has_hi) {
+			return (hi - lo) / float(2.0 * dsm.cell_size);
+		} else if(has_hi) {
+			return (hi - h) / float(dsm.cell_size);
+		} else if(has_lo) {
+			return (h - lo) / float(dsm.cell_size);
+		}
+		return 0.0f;
+	};
+
+	for(uint32_t r = 0; r < dsm.rows; ++r) {
+		for(uint32_t c = 0; c < dsm.cols; ++c) {
+			const size_t idx = transposed
+				? size_t(c) * cols + r
+				: size_t(r) * cols + c;
+
+			const float h = dsm.at(c, r);
+			if(!dsm.is_valid(h)) {
+				height[idx] = NO_HEIGHT;
+				nx[idx] = ny[idx] = nz[idx] = 0.0f;
+				continue;
+			}
+			height[idx] = h;
+
+			float w, e, n, s;
+			const bool hw = neighbor(long(c) - 1, r, w);
+			const bool he = neighbor(long(c) + 1, r, e);
+			const bool hn = neighbor(c, long(r) - 1, n);
+			const bool hs = neighbor(c, long(r) + 1, s);
+
+			const Vec3 normal = glm::normalize(Vec3{
+				-slope(h, hw, w, he, e),
+				-slope(h, hs, s, hn, n),
+				1.0f
+			});
+			nx[idx] = normal.x;
+			ny[idx] = normal.y;
+			nz[idx] = normal.z;
+		}
+	}
+}
+
+RasterProcessor::RasterProcessor(const HeightRaster& dsm,
+	unsigned num_threads
+):
+	name{"CPU line sweep (" + std::to_string(num_threads) + " threads)"},
+	cell_size(dsm.cell_size),
+	grid(dsm, false),
+	transposed(dsm, true)
+{
+	workers.reserve(num_threads);
+	for(unsigned i = 0; i < num_threads; ++i) {
+		workers.push_back(std::thread(&RasterProcessor::worker, this, i));
+	}
+}
+
+RasterProcessor::~RasterProcessor()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		quit = true;
+	}
+	start_cv.notify_all();
+
+	for(auto &w: workers) {
+		w.join();
+	}
+}
+
+void RasterProcessor::worker(unsigned idx)
+{
+	uint64_t seen = 0;
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			start_cv.wait(lock, [&] {
+				return quit || generation != seen;
+			});
+			if(quit) {
+				return;
+			}
+			seen = generation;
+		}
+
+		sweep(idx);
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			--pending;
+		}
+		done_cv.notify_one();
+	}
+}
+
+void RasterProcessor::sweep(unsigned idx)
+{
+	// Tolerance for the cell to be considered above
+	// the shadow line, in meters.
+	const float tol = 1e-3f;
+
+	const Frame &f = frame;
+	SweepGrid &g = *f.g;
+
+	float shadow[RAY_BLOCK];
+
+	const long num_blocks = f.num_rays / RAY_BLOCK
+		+ (f.num_rays % RAY_BLOCK > 0);
+	for(long b = idx; b < num_blocks; b += workers.size()) {
+		const long j0 = f.first_ray + b * RAY_BLOCK;
+		const long j1 = std::min(j0 + long(RAY_BLOCK),
+			f.first_ray + f.num_rays);
+
+		std::fill_n(shadow, RAY_BLOCK, NO_HEIGHT);
+
+		uint32_t row = f.start_row;
+		for(uint32_t k = 0; k < g.rows; ++k, row += f.row_step) {
+			// In this row, ray j is over column j + s.
+			const long s = std::lround(k * f.shift);
+			const long lo = std::max(j0 + s, 0l);
+			const long hi = std::min(j1 + s, long(g.cols));
+
+			if(lo >= hi) {
+				continue;
+			}
+
+			const size_t offset = size_t(row) * g.cols + lo;
+			const float *h = g.height.data() + offset;
+			const float *nx = g.nx.data() + offset;
+			const float *ny = g.ny.data() + offset;
+			const float *nz = g.nz.data() + offset;
+			float *acc = g.incidence.data() + offset;
+			float *line = shadow + (lo - s - j0);
+
+			// Contiguous and branchless, to be vectorized.
+			const long n = hi - lo;
+			for(long i = 0; i < n; ++i) {
+				const float sline = line[i] - f.drop;
+				const float cosi = nx[i] * f.sun.x
+					+ ny[i] * f.sun.y + nz[i] * f.sun.z;
+				const bool lit = h[i] + tol >= sline;
+
+				line[i] = std::max(sline, h[i]);
+				acc[i] += (lit && cosi > 0.0f)
+					? f.energy * cosi : 0.0f;
+			}
+		}
+	}
+}
+
+Vec3 RasterProcessor::add_to_totals(const Vec3& sun,
+	const InstantaneousData& instant)
+{
+	const Vec3 directional_energy =
+		float(instant.coefficient * instant.direct_power) * sun;
+
+	directional_sum += directional_energy;
+	diffuse_sum += instant.coefficient * instant.indirect_power;
+	time_sum += instant.coefficient;
+
+	return directional_energy;
+}
+
+void RasterProcessor::skip(const Vec3& sun, const InstantaneousData& instant)
+{
+	add_to_totals(sun, instant);
+}
+
+void RasterProcessor::process(const Vec3& sun, const InstantaneousData& instant)
+{
+	add_to_totals(sun, instant);
+	++count;
+
+	frame.sun = sun;
+	frame.energy = instant.coefficient * instant.direct_power;
+	if(sun.z <= 0.0f || frame.energy <= 0.0f) {
+		return;
+	}
+
+	// Sweep along the raster axis closest to sun's azimuth,
+	// so that rays shift at most one column per row.
+	if(std::abs(sun.y) >= std::abs(sun.x)) {
+		// Rows go from north to south.
+		frame.g = &grid;
+		frame.row_step = sun.y > 0.0f ? 1 : -1;
+		frame.start_row = sun.y > 0.0f ? 0 : grid.rows - 1;
+		frame.shift = -sun.x / std::abs(sun.y);
+		frame.drop = cell_size * sun.z / std::abs(sun.y);
+	} else {
+		// Rows go from west to east, columns from north to south.
+		frame.g = &transposed;
+		frame.row_step = sun.x > 0.0f ? -1 : 1;
+		frame.start_row = sun.x > 0.0f ? transposed.rows - 1 : 0;
+		frame.shift = sun.y / std::abs(sun.x);
+		frame.drop = cell_size * sun.z / std::abs(sun.x);
+	}
+
+	// Rays must cover every cell of every row.
+	const long last_shift = std::lround((frame.g->rows - 1) * frame.shift);
+	frame.first_ray = -std::max(last_shift, 0l);
+	frame.num_rays = frame.g->cols + std::abs(last_shift);
+
+	// Run the workers and wait for them to finish.
+	std::unique_lock<std::mutex> lock(mtx);
+	pending = workers.size();
+	++generation;
+	start_cv.notify_all();
+	done_cv.wait(lock, [&] { return pending == 0; });
+}
+
+void RasterProcessor::accumulate_result(float *accum) const
+{
+	for(uint32_t r = 0; r < grid.rows; ++r) {
+		for(uint32_t c = 0; c < grid.cols; ++c) {
+			accum[size_t(r) * grid.cols + c] +=
+				grid.incidence[size_t(r) * grid.cols + c]
+				+ transposed.incidence[size_t(c) * grid.rows + r];
+		}
+	}
+}
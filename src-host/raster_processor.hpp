@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
+
+#include "float.hpp"
+#include "raster.hpp"
+
+extern "C" {
+#include "sun_position.h"
+}
+
+// Height of missing data, and of the shadow line before any cell. Not
+// -infinity, as the build assumes finite math. Lowering it further
+// rounds back to it, so it stays below every real height.
+static const float NO_HEIGHT = std::numeric_limits<float>::lowest();
+
+// Grid data laid out for the sweep along one of the raster axes.
+// In the transposed layout, rows run from west to east, and
+// columns from north to south.
+struct SweepGrid
+{
+	SweepGrid(const HeightRaster& dsm, bool transposed);
+
+	uint32_t rows;
+	uint32_t cols;
+
+	// Heights, with missing data as NO_HEIGHT, so it
+	// never casts shadow.
+	std::vector<float> height;
+
+	// Surface normal components, in the (east, north, up) frame.
+	// Zero for missing data, so it never receives energy.
+	std::vector<float> nx;
+	std::vector<float> ny;
+	std::vector<float> nz;
+
+	// Accumulated direct incidence.
+	std::vector<float> incidence;
+};
+
+// Computes the solar incidence over a digital surface model raster,
+// without meshing it. For every sun position, the shadows are found
+// with a line sweep along the sun's azimuth, in O(cells): each cell
+// is visited by a single ray, so rays are split among threads and
+// write to the same accumulator without synchronization.
+//
+// The sun direction passed must be in (east, north, up) frame.
+//
+// If moved, the only valid operation is destruction.
+class RasterProcessor
+{
+public:
+	RasterProcessor(const HeightRaster& dsm, unsigned num_threads);
+	~RasterProcessor();
+
+	const std::string& get_name()
+	{
+		return name;
+	}
+
+	void process(const Vec3& suns_direction, const InstantaneousData& instant);
+
+	void skip(const Vec3& suns_direction, const InstantaneousData& instant);
+
+	const Vec3& get_directional_sum() const
+	{
+		return directional_sum;
+	}
+
+	double get_diffuse_sum() const
+	{
+		return diffuse_sum;
+	}
+
+	double get_time_sum() const
+	{
+		return time_sum;
+	}
+
+	size_t get_process_count() const
+	{
+		return count;
+	}
+
+	// Adds the direct incidence of every cell, in row major order.
+	void accumulate_result(float *accum) const;
+
+private:
+	// Number of adjacent rays processed together by a thread.
+	static const uint32_t RAY_BLOCK = 512;
+
+	void worker(unsigned idx);
+	void sweep(unsigned idx);
+
+	Vec3 add_to_totals(const Vec3& sun, const InstantaneousData& instant);
+
+	std::string name;
+	float cell_size;
+
+	SweepGrid grid;
+	SweepGrid transposed;
+
+	// Parameters of the current frame:
+	struct Frame {
+		SweepGrid *g;
+		Vec3 sun;
+		float energy;
+		// First row and row increment, starting from sun's side.
+		uint32_t start_row;
+		int row_step;
+		// Column shift per row, away from the sun.
+		float shift;
+		// How much the shadow line lowers per row.
+		float drop;
+		// Ray range, relative to the column of the first row.
+		long first_ray;
+		long num_rays;
+	} frame;
+
+	// Worker pool synchronization:
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	uint64_t generation = 0;
+	unsigned pending = 0;
+	bool quit = false;
+
+	Vec3 directional_sum = {0,0,0};
+	double diffuse_sum = 0.0;
+	double time_sum = 0.0;
+	size_t count = 0;
+};
@@ -0,0 +1,304 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "result_cache.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+template<class T>
+void put(std::ostream& out, const T& v)
+{
+	out.write(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+void put(std::ostream& out, const std::string& s)
+{
+	put(out, uint64_t(s.size()));
+	out.write(s.data(), s.size());
+}
+
+template<class T>
+void put_vector(std::ostream& out, const std::vector<T>& v)
+{
+	put(out, uint64_t(v.size()));
+	out.write(reinterpret_cast<const char*>(v.data()),
+		v.size() * sizeof(T));
+}
+
+template<class T>
+void get(std::istream& in, T& v)
+{
+	in.read(reinterpret_cast<char*>(&v), sizeof v);
+}
+
+uint64_t get_size(std::istream& in, size_t elem_size)
+{
+	uint64_t size = 0;
+	get(in, size);
+	if(!in || size > (uint64_t(1) << 40) / elem_size) {
+		throw std::runtime_error("Malformed cache entry.\n");
+	}
+	return size;
+}
+
+void get(std::istream& in, std::string& s)
+{
+	s.resize(get_size(in, 1));
+	in.read(&s[0], s.size());
+}
+
+template<class T>
+void get_vector(std::istream& in, std::vector<T>& v)
+{
+	v.resize(get_size(in, sizeof(T)));
+	in.read(reinterpret_cast<char*>(v.data()), v.size() * sizeof(T));
+}
+
+// Instances are only assigned to trackers and
+// vegetation after loading, so those are not saved.
+void put_scene(std::ostream& out, const Scene& s)
+{
+	put_vector(out, s.geometry.vertices);
+	put_vector(out, s.geometry.indices);
+	put_vector(out, s.geometry.splat_radius);
+
+	put(out, uint64_t(s.geometry.submeshes.size()));
+	for(const auto& sm: s.geometry.submeshes) {
+		put(out, sm.name);
+		put(out, sm.first_vertex);
+		put(out, sm.num_vertices);
+		put(out, sm.first_index);
+		put(out, sm.num_indices);
+	}
+
+	put(out, uint64_t(s.instances.size()));
+	for(const auto& inst: s.instances) {
+		put(out, inst.submesh);
+		put(out, inst.transform);
+		put(out, inst.name);
+	}
+}
+
+void get_scene(std::istream& in, Scene& s)
+{
+	s = Scene{};
+	get_vector(in, s.geometry.vertices);
+	get_vector(in, s.geometry.indices);
+	get_vector(in, s.geometry.splat_radius);
+
+	s.geometry.submeshes.resize(get_size(in, 20));
+	for(auto& sm: s.geometry.submeshes) {
+		get(in, sm.name);
+		get(in, sm.first_vertex);
+		get(in, sm.num_vertices);
+		get(in, sm.first_index);
+		get(in, sm.num_indices);
+	}
+
+	s.instances.resize(get_size(in, sizeof(Scene::Instance)));
+	for(auto& inst: s.instances) {
+		get(in, inst.submesh);
+		get(in, inst.transform);
+		get(in, inst.name);
+	}
+}
+
+}
+
+void Hasher::add(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for(size_t i = 0; i < size; ++i) {
+		h = (h ^ bytes[i]) * 1099511628211ull;
+	}
+}
+
+void Hasher::add_file(const std::string& fname)
+{
+	std::ifstream in(fname, std::ios::binary);
+	if(!in) {
+		throw std::runtime_error(
+			"Could not open file \"" + fname + "\".\n"
+		);
+	}
+
+	std::vector<char> buf(1 << 20);
+	uint64_t total = 0;
+	while(in) {
+		in.read(buf.data(), buf.size());
+		add(buf.data(), in.gcount());
+		total += in.gcount();
+	}
+	add(total);
+}
+
+std::string default_cache_dir()
+{
+	if(const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+		return std::string(xdg) + "/solmap";
+	}
+	if(const char* home = std::getenv("HOME")) {
+		return std::string(home) + "/.cache/solmap";
+	}
+	return ".solmap-cache";
+}
+
+ResultCache::ResultCache(const std::string& dir, uint64_t max_bytes):
+	dir{dir},
+	max_bytes{max_bytes}
+{
+	std::error_code ec;
+	fs::create_directories(dir, ec);
+}
+
+std::string ResultCache::path(uint64_t key, const char* ext) const
+{
+	std::ostringstream ss;
+	ss << dir << '/' << std::hex << std::setw(16) << std::setfill('0')
+		<< key << ext;
+	return ss.str();
+}
+
+void ResultCache::touch(const std::string& fname)
+{
+	std::error_code ec;
+	fs::last_write_time(fname, fs::file_time_type::clock::now(), ec);
+}
+
+void ResultCache::evict()
+{
+	struct Entry
+	{
+		fs::path path;
+		fs::file_time_type time;
+		uint64_t size;
+	};
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+
+	std::error_code ec;
+	for(const auto& f: fs::directory_iterator(dir, ec)) {
+		const auto ext = f.path().extension();
+		if(ext != ".scene" && ext != ".result") {
+			continue;
+		}
+
+		Entry e{f.path(), f.last_write_time(ec), f.file_size(ec)};
+		if(!ec) {
+			total += e.size;
+			entries.push_back(std::move(e));
+		}
+	}
+
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& a, const Entry& b) {
+			return a.time < b.time;
+		});
+
+	for(const auto& e: entries) {
+		if(total <= max_bytes) {
+			break;
+		}
+		fs::remove(e.path, ec);
+		total -= e.size;
+	}
+}
+
+bool ResultCache::load_scenes(uint64_t key, Scene& receivers, Scene& casters,
+	real& scale)
+{
+	const std::string fname = path(key, ".scene");
+	std::ifstream in(fname, std::ios::binary);
+	if(!in) {
+		return false;
+	}
+
+	try {
+		uint8_t has_casters = 0;
+		get(in, scale);
+		get_scene(in, receivers);
+		get(in, has_casters);
+		if(has_casters) {
+			get_scene(in, casters);
+		} else {
+			casters = receivers;
+		}
+
+		if(!in) {
+			throw std::runtime_error("Truncated cache entry.\n");
+		}
+	} catch(const std::exception& e) {
+		std::cout << "Warning: ignoring cached model: " << e.what();
+		return false;
+	}
+
+	touch(fname);
+	return true;
+}
+
+void ResultCache::save_scenes(uint64_t key, const Scene& receivers,
+	const Scene* casters, real scale)
+{
+	const std::string fname = path(key, ".scene");
+	const std::string tmp_name = fname + ".tmp";
+	{
+		std::ofstream out(tmp_name, std::ios::binary);
+		put(out, scale);
+		put_scene(out, receivers);
+		put(out, uint8_t(casters != nullptr));
+		if(casters) {
+			put_scene(out, *casters);
+		}
+
+		if(!out) {
+			std::cout << "Warning: could not cache the model."
+				<< std::endl;
+			return;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tmp_name, fname, ec);
+	evict();
+}
+
+bool ResultCache::load_result(uint64_t key, PartialResult& r)
+{
+	const std::string fname = path(key, ".result");
+	std::error_code ec;
+	if(!fs::exists(fname, ec)) {
+		return false;
+	}
+
+	try {
+		r = load_partial_result(fname);
+	} catch(const std::exception& e) {
+		std::cout << "Warning: ignoring cached result: " << e.what();
+		return false;
+	}
+
+	touch(fname);
+	return true;
+}
+
+void ResultCache::save_result(uint64_t key, const PartialResult& r)
+{
+	try {
+		save_partial_result(path(key, ".result"), r);
+	} catch(const std::exception& e) {
+		std::cout << "Warning: could not cache the result: "
+			<< e.what();
+		return;
+	}
+	evict();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <type_traits>
+
+#include "float.hpp"
+#include "mesh_tools.hpp"
+#include "partial_result.hpp"
+
+// Bump whenever a change alters the loaded models or the results,
+// so that entries cached by older versions are never used.
+static const uint32_t ENGINE_VERSION = 1;
+
+// Incremental 64-bit FNV-1a hash.
+class Hasher
+{
+public:
+	void add(const void* data, size_t size);
+
+	void add(const std::string& s)
+	{
+		add(uint64_t(s.size()));
+		add(s.data(), s.size());
+	}
+
+	template<class T>
+	void add(const T& v)
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+			"Only plain values can be hashed by their bytes.");
+		add(&v, sizeof v);
+	}
+
+	// Adds the contents of the file.
+	void add_file(const std::string& fname);
+
+	uint64_t get() const
+	{
+		return h;
+	}
+
+private:
+	uint64_t h = 14695981039346656037ull;
+};
+
+// Local cache of loaded models and of computed results, each in
+// a file named after the hash of everything it depends on. When
+// the files are over the maximum size, the least recently used
+// are removed. Failing to use the cache never fails the run.
+class ResultCache
+{
+public:
+	// The directory is created if needed.
+	ResultCache(const std::string& dir, uint64_t max_bytes);
+
+	// Loads the receivers and casters, as returned by the model
+	// loaders, and the updated scale. Returns false if missing.
+	bool load_scenes(uint64_t key, Scene& receivers, Scene& casters,
+		real& scale);
+
+	// Casters may be null if they are the receivers.
+	void save_scenes(uint64_t key, const Scene& receivers,
+		const Scene* casters, real scale);
+
+	bool load_result(uint64_t key, PartialResult& r);
+
+	void save_result(uint64_t key, const PartialResult& r);
+
+private:
+	std::string path(uint64_t key, const char* ext) const;
+
+	// Marks the file as just used.
+	void touch(const std::string& fname);
+
+	void evict();
+
+	std::string dir;
+	uint64_t max_bytes;
+};
+
+// Default location, following the XDG base directories.
+std::string default_cache_dir();
@@ -0,0 +1,198 @@
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstring>
+
+#include <glm/geometric.hpp>
+
+#include "result_store.hpp"
+
+namespace {
+
+size_t type_size(StoreColumn::Type t)
+{
+	return t == StoreColumn::FLOAT64 ? 8 : 4;
+}
+
+uint64_t align(uint64_t offset)
+{
+	return (offset + STORE_ALIGNMENT - 1) / STORE_ALIGNMENT
+		* STORE_ALIGNMENT;
+}
+
+template<class T>
+void put(std::ostream& out, const T& v)
+{
+	out.write(reinterpret_cast<const char*>(&v), sizeof v);
+}
+
+std::string json_string(const std::string& s)
+{
+	std::ostringstream ret;
+	ret << '"';
+	for(unsigned char c: s) {
+		if(c == '"' || c == '\\') {
+			ret << '\\' << c;
+		} else if(c < 0x20) {
+			ret << "\\u" << std::hex << std::setw(4)
+				<< std::setfill('0') << unsigned(c) << std::dec;
+		} else {
+			ret << c;
+		}
+	}
+	ret << '"';
+	return ret.str();
+}
+
+}
+
+void write_store(const std::string& fname,
+	const std::vector<StoreColumn>& columns, const std::string& metadata)
+{
+	static const size_t NAME_SIZE = 32;
+	const uint64_t header_size = 8 + 4 + 4 + 8 + 8;
+	const uint64_t entry_size = NAME_SIZE + 4 + 4 + 8 + 8;
+
+	// Lay out the columns after the directory.
+	std::vector<uint64_t> offsets;
+	uint64_t offset = header_size + entry_size * columns.size();
+	for(const auto& c: columns) {
+		if(c.name.size() >= NAME_SIZE) {
+			throw std::runtime_error("Column name too long.\n");
+		}
+		offset = align(offset);
+		offsets.push_back(offset);
+		offset += c.rows * c.components * type_size(c.type);
+	}
+	const uint64_t metadata_offset = align(offset);
+
+	std::ofstream out(fname, std::ios::binary);
+	if(!out) {
+		throw std::runtime_error(
+			"Could not open output file \"" + fname + "\".\n"
+		);
+	}
+
+	out.write("SOLMAPRS", 8);
+	put(out, STORE_VERSION);
+	put(out, uint32_t(columns.size()));
+	put(out, metadata_offset);
+	put(out, uint64_t(metadata.size()));
+
+	for(size_t i = 0; i < columns.size(); ++i) {
+		const auto& c = columns[i];
+		char name[NAME_SIZE] = {};
+		std::memcpy(name, c.name.data(), c.name.size());
+		out.write(name, NAME_SIZE);
+		put(out, uint32_t(c.type));
+		put(out, c.components);
+		put(out, c.rows);
+		put(out, offsets[i]);
+	}
+
+	auto pad_to = [&](uint64_t offset) {
+		static const char zeros[STORE_ALIGNMENT] = {};
+		out.write(zeros, offset - uint64_t(out.tellp()));
+	};
+
+	for(size_t i = 0; i < columns.size(); ++i) {
+		const auto& c = columns[i];
+		pad_to(offsets[i]);
+		out.write(static_cast<const char*>(c.data),
+			c.rows * c.components * type_size(c.type));
+	}
+
+	pad_to(metadata_offset);
+	out.write(metadata.data(), metadata.size());
+
+	if(!out) {
+		throw std::runtime_error(
+			"Could not write output file \"" + fname + "\".\n"
+		);
+	}
+}
+
+void write_result_store(const std::string& fname, const RunInfo& info,
+	const Mesh& mesh, real scale, double dif_total, double dir_total,
+	const Vec4* directional, const std::vector<InstantaneousData>& suns)
+{
+	const size_t n = mesh.vertices.size();
+
+	std::vector<float> position(3 * n);
+	std::vector<float> normal(3 * n);
+	std::vector<float> incidence(n);
+	std::vector<float> dir_incidence(3 * n);
+	std::vector<float> shadow(n);
+	for(size_t i = 0; i < n; ++i) {
+		const Vec3 p = scale * mesh.vertices[i].position;
+		const Vec3& nm = mesh.vertices[i].normal;
+		for(uint8_t k = 0; k < 3; ++k) {
+			position[3 * i + k] = p[k];
+			normal[3 * i + k] = nm[k];
+			dir_incidence[3 * i + k] = directional[i][k];
+		}
+		incidence[i] = dif_total + directional[i].w;
+		shadow[i] = (1.0 - glm::length(Vec3{directional[i]})
+			/ dir_total) * 100.0;
+	}
+
+	std::vector<double> az, alt, coefficient, direct, indirect;
+	std::vector<int32_t> month, hour;
+	for(const auto& s: suns) {
+		az.push_back(s.pos.az);
+		alt.push_back(s.pos.alt);
+		coefficient.push_back(s.coefficient);
+		direct.push_back(s.direct_power);
+		indirect.push_back(s.indirect_power);
+		month.push_back(s.month);
+		hour.push_back(s.hour);
+	}
+
+	std::vector<StoreColumn> columns = {
+		{"position", StoreColumn::FLOAT32, 3, n, position.data()},
+		{"normal", StoreColumn::FLOAT32, 3, n, normal.data()},
+		{"incidence", StoreColumn::FLOAT32, 1, n, incidence.data()},
+		{"directional_incidence", StoreColumn::FLOAT32, 3, n,
+			dir_incidence.data()},
+		{"shadow_percentage", StoreColumn::FLOAT32, 1, n,
+			shadow.data()},
+		{"triangles", StoreColumn::UINT32, 3, mesh.indices.size() / 3,
+			mesh.indices.data()},
+		{"sun_azimuth", StoreColumn::FLOAT64, 1, suns.size(), az.data()},
+		{"sun_altitude", StoreColumn::FLOAT64, 1, suns.size(),
+			alt.data()},
+		{"sun_coefficient", StoreColumn::FLOAT64, 1, suns.size(),
+			coefficient.data()},
+		{"sun_direct_power", StoreColumn::FLOAT64, 1, suns.size(),
+			direct.data()},
+		{"sun_indirect_power", StoreColumn::FLOAT64, 1, suns.size(),
+			indirect.data()},
+		{"sun_month", StoreColumn::INT32, 1, suns.size(), month.data()},
+		{"sun_hour", StoreColumn::INT32, 1, suns.size(), hour.data()}
+	};
+
+	std::vector<float> splat_radius;
+	if(mesh.is_point_cloud()) {
+		for(float r: mesh.splat_radius) {
+			splat_radius.push_back(scale * r);
+		}
+		columns.push_back({"splat_radius", StoreColumn::FLOAT32, 1, n,
+			splat_radius.data()});
+	}
+
+	std::ostringstream meta;
+	meta << std::setprecision(17) << "{\n"
+		"  \"latitude\": " << info.latitude << ",\n"
+		"  \"longitude\": " << info.longitude << ",\n"
+		"  \"model\": " << json_string(info.model) << ",\n"
+		"  \"scale\": " << scale << ",\n"
+		"  \"incidence_unit\": \"kWh/m2\",\n"
+		"  \"diffuse_total\": " << dif_total << ",\n"
+		"  \"direct_total\": " << dir_total << ",\n"
+		"  \"point_cloud\": "
+			<< (mesh.is_point_cloud() ? "true" : "false") << "\n"
+		"}\n";
+
+	write_store(fname, columns, meta.str());
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "float.hpp"
+#include "mesh_tools.hpp"
+
+extern "C" {
+#include "sun_position.h"
+}
+
+// Columnar binary file of results, meant to be memory mapped. It starts
+// with a header and a directory of columns, followed by the data of each
+// column, little endian and aligned to STORE_ALIGNMENT bytes from the
+// start of the file, and ends with the run metadata in JSON.
+//
+// Header:
+//  char magic[8] = "SOLMAPRS";
+//  uint32_t version;
+//  uint32_t num_columns;
+//  uint64_t metadata_offset;
+//  uint64_t metadata_size;
+//
+// Followed by num_columns entries of:
+//  char name[32]; // null padded
+//  uint32_t type; // StoreColumn::Type
+//  uint32_t components;
+//  uint64_t rows;
+//  uint64_t offset;
+//
+// resources/pylib/result_store.py reads it.
+static const uint32_t STORE_VERSION = 1;
+static const uint64_t STORE_ALIGNMENT = 64;
+
+struct StoreColumn
+{
+	enum Type: uint32_t {
+		FLOAT32 = 0,
+		UINT32 = 1,
+		FLOAT64 = 2,
+		INT32 = 3
+	};
+
+	std::string name;
+	Type type;
+	uint32_t components;
+	uint64_t rows;
+
+	// Row major, rows by components.
+	const void* data;
+};
+
+// Writes the columns as they are.
+void write_store(const std::string& fname,
+	const std::vector<StoreColumn>& columns, const std::string& metadata);
+
+// Description of the run, for the metadata.
+struct RunInfo
+{
+	double latitude;
+	double longitude;
+	std::string model;
+};
+
+// Writes the mesh with the incidence, in the same units of the VTK
+// output, together with the table of sun positions used.
+//
+// Directional incidence has the lit energy vector in xyz, and
+// its projection on the normal of the point in w. Points that were
+// not computed have it zero, so they are stored as always in shadow.
+void write_result_store(const std::string& fname, const RunInfo& info,
+	const Mesh& mesh, real scale, double dif_total, double dir_total,
+	const Vec4* directional, const std::vector<InstantaneousData>& suns);
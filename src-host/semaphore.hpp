@@ -1,176 +0,0 @@
-/*
-Copyright (c) 2015 Jeff Preshing
-
-This software is provided 'as-is', without any express or implied
-warranty. In no event will the authors be held liable for any damages
-arising from the use of this software.
-
-Permission is granted to anyone to use this software for any purpose,
-including commercial applications, and to alter it and redistribute it
-freely, subject to the following restrictions:
-
-1. The origin of this software must not be misrepresented; you must not
-   claim that you wrote the original software. If you use this software
-   in a product, an acknowledgement in the product documentation would be
-   appreciated but is not required.
-2. Altered source versions must be plainly marked as such, and must not be
-   misrepresented as being the original software.
-3. This notice may not be removed or altered from any source distribution.
-*/
-
-// Multiplatform semaphore by Jeff Preshing, adapted from:
-// https://github.com/preshing/cpp11-on-multicore/blob/master/common/sema.h
-
-#pragma once
-
-#include <atomic>
-#include <cassert>
-
-
-#if defined(_WIN32)
-//---------------------------------------------------------
-// Semaphore (Windows)
-//---------------------------------------------------------
-
-#include <windows.h>
-#undef min
-#undef max
-
-class Semaphore
-{
-private:
-    HANDLE m_hSema;
-
-    Semaphore(const Semaphore& other) = delete;
-    Semaphore& operator=(const Semaphore& other) = delete;
-
-public:
-    Semaphore(int initialCount = 0)
-    {
-        assert(initialCount >= 0);
-        m_hSema = CreateSemaphore(NULL, initialCount, MAXLONG, NULL);
-    }
-
-    ~Semaphore()
-    {
-        CloseHandle(m_hSema);
-    }
-
-    void wait()
-    {
-        WaitForSingleObject(m_hSema, INFINITE);
-    }
-
-    void signal(int count = 1)
-    {
-        ReleaseSemaphore(m_hSema, count, NULL);
-    }
-};
-
-
-#elif defined(__MACH__)
-//---------------------------------------------------------
-// Semaphore (Apple iOS and OSX)
-// Can't use POSIX semaphores due to http://lists.apple.com/archives/darwin-kernel/2009/Apr/msg00010.html
-//---------------------------------------------------------
-
-#include <mach/mach.h>
-
-class Semaphore
-{
-private:
-    semaphore_t m_sema;
-
-    Semaphore(const Semaphore& other) = delete;
-    Semaphore& operator=(const Semaphore& other) = delete;
-
-public:
-    Semaphore(int initialCount = 0)
-    {
-        assert(initialCount >= 0);
-        semaphore_create(mach_task_self(), &m_sema, SYNC_POLICY_FIFO, initialCount);
-    }
-
-    ~Semaphore()
-    {
-        semaphore_destroy(mach_task_self(), m_sema);
-    }
-
-    void wait()
-    {
-        semaphore_wait(m_sema);
-    }
-
-    void signal()
-    {
-        semaphore_signal(m_sema);
-    }
-
-    void signal(int count)
-    {
-        while (count-- > 0)
-        {
-            semaphore_signal(m_sema);
-        }
-    }
-};
-
-
-#elif defined(__unix__)
-//---------------------------------------------------------
-// Semaphore (POSIX, Linux)
-//---------------------------------------------------------
-
-#include <semaphore.h>
-
-class Semaphore
-{
-private:
-    sem_t m_sema;
-
-    Semaphore(const Semaphore& other) = delete;
-    Semaphore& operator=(const Semaphore& other) = delete;
-
-public:
-    Semaphore(int initialCount = 0)
-    {
-        assert(initialCount >= 0);
-        sem_init(&m_sema, 0, initialCount);
-    }
-
-    ~Semaphore()
-    {
-        sem_destroy(&m_sema);
-    }
-
-    void wait()
-    {
-        // http://stackoverflow.com/questions/2013181/gdb-causes-sem-wait-to-fail-with-eintr-error
-        int rc;
-        do
-        {
-            rc = sem_wait(&m_sema);
-        }
-        while (rc == -1 && errno == EINTR);
-    }
-
-    void signal()
-    {
-        sem_post(&m_sema);
-    }
-
-    void signal(int count)
-    {
-        while (count-- > 0)
-        {
-            sem_post(&m_sema);
-        }
-    }
-};
-
-
-#else
-
-#error Unsupported platform!
-
-#endif
@@ -1,15 +1,31 @@
 #include <cstddef>
+#include <limits>
+#include <algorithm>
+
+#include <glm/glm.hpp>
 
 #include <assimp/scene.h>
 
 #include "shadow_processor.hpp"
 
-static const uint32_t frame_size = 2048;
+// Vegetation opacity map: the optical depth in r, the optical depth
+// weighted depth in g, and the nearest depth in a. Half float, because
+// blending is not guaranteed for 32-bit float formats.
+static const VkFormat opacity_format = VK_FORMAT_R16G16B16A16_SFLOAT;
 
 struct GlobalInputData
 {
 	Quat orientation;
 	Vec3 dir_energy;
+
+	// Unit vector, for the trackers:
+	alignas(16) Vec3 sun_direction;
+
+	// From 0 to 11, for the vegetation:
+	uint32_t month;
+
+	// From 0 to 8759, for the hourly string energy:
+	uint32_t hour;
 };
 
 template <typename T1, typename T2>
@@ -30,87 +46,306 @@ static Quat rot_from_unit_a_to_unit_b(Vec3 a, Vec3 b)
 	return glm::normalize(ret);
 }
 
-MeshBuffers::MeshBuffers(VkDevice device,
+// Vertex as seen by the shaders. For
+// splats, the radius is in position's w.
+struct GpuVertex
+{
+	Vec3 position;
+	float radius;
+	Vec3 normal;
+	float padding;
+};
+
+// Instance transform as seen by the shaders: the first
+// three rows of the matrix, and of the normal matrix.
+struct GpuInstance
+{
+	Vec4 transform[3];
+	Vec4 normal_transform[3];
+	uint32_t tracker;
+	uint32_t vegetation;
+	uint32_t padding[2];
+};
+
+// Tracker group as seen by the shaders, see tracker.glsl.
+struct GpuTracker
+{
+	Vec4 axis_max_angle;
+	Vec4 rest_normal_gcr;
+	uint32_t type;
+	uint32_t padding[3];
+};
+
+// Vegetation group as seen by the shaders, see opacity-map.frag.
+struct GpuVegetation
+{
+	float optical_depth[12];
+};
+
+// Vertex of the top down rendering, see top-down.vert.
+struct TopDownVertex
+{
+	Vec3 position;
+	float value;
+	float radius;
+};
+
+// Push constants of the top down rendering, see top-down.vert.
+struct TopDownTile
+{
+	Vec2 corner;
+	Vec2 size;
+	float top;
+	float depth_scale;
+	float cell_size;
+};
+
+// Largest tile of the top down rendering, in cells.
+static const uint32_t max_tile_size = 4096;
+
+// Transmittance is clamped, so that the
+// optical depth fits in half floats.
+static const real min_transmittance = 1e-3;
+
+SceneBuffers::SceneBuffers(VkDevice device,
 	const VkPhysicalDeviceMemoryProperties& mem_props,
-	const Mesh& mesh, BufferTransferer& btransf
+	const Scene& scene, BufferTransferer& btransf
 ):
 	vertex(device, mem_props,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		mesh.vertices.size() * sizeof(Vec3),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+		| VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		scene.geometry.vertices.size() * sizeof(GpuVertex),
 		HOST_WILL_WRITE_BIT
 	),
-	index(device, mem_props,
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		mesh.indices.size() * sizeof(uint32_t),
+	instance(device, mem_props,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+		| VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		scene.instances.size() * sizeof(GpuInstance),
+		HOST_WILL_WRITE_BIT
+	),
+	// Never empty, as a buffer can't have size 0.
+	tracker(device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		std::max<size_t>(1, scene.trackers.size()) * sizeof(GpuTracker),
 		HOST_WILL_WRITE_BIT
 	),
-	idx_count(mesh.indices.size())
+	vegetation(device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		std::max<size_t>(1, scene.vegetation.size())
+			* sizeof(GpuVegetation),
+		HOST_WILL_WRITE_BIT
+	)
 {
+	const Mesh& geom = scene.geometry;
+
 	// Copy the vertex data to device memory.
-	btransf.transfer<Vec3*>(vertex, mesh.vertices.size(),
-		HOST_WILL_WRITE_BIT, [&](Vec3* ptr) {
-			for(const auto& v: mesh.vertices) {
-				*ptr++ = v.position;
+	btransf.transfer<GpuVertex*>(vertex, geom.vertices.size(),
+		HOST_WILL_WRITE_BIT, [&](GpuVertex* ptr) {
+			for(size_t i = 0; i < geom.vertices.size(); ++i) {
+				*ptr++ = {
+					geom.vertices[i].position,
+					geom.is_point_cloud()
+						? geom.splat_radius[i] : 0.0f,
+					geom.vertices[i].normal,
+					0.0f
+				};
 			}
 		}
 	);
 
+	write_instances(scene, btransf);
+
+	// Copy the tracker groups to device memory.
+	btransf.transfer<GpuTracker*>(tracker,
+		std::max<size_t>(1, scene.trackers.size()),
+		HOST_WILL_WRITE_BIT, [&](GpuTracker* ptr) {
+			*ptr = {};
+			for(const auto& t: scene.trackers) {
+				*ptr++ = {
+					Vec4{t.axis, t.max_angle},
+					Vec4{t.rest_normal, t.gcr},
+					t.type == TrackerGroup::DUAL_AXIS
+						? 1u : 0u,
+					{}
+				};
+			}
+		}
+	);
+
+	// Copy the vegetation schedules to device memory. Each crossed
+	// surface of the crown gets half of the optical depth.
+	btransf.transfer<GpuVegetation*>(vegetation,
+		std::max<size_t>(1, scene.vegetation.size()),
+		HOST_WILL_WRITE_BIT, [&](GpuVegetation* ptr) {
+			*ptr = {};
+			for(const auto& v: scene.vegetation) {
+				for(uint8_t m = 0; m < 12; ++m) {
+					ptr->optical_depth[m] = -0.5 * std::log(
+						std::max(v.transmittance[m],
+							min_transmittance));
+				}
+				++ptr;
+			}
+		}
+	);
+
+	// Instances of the same mesh are contiguous, so each mesh is
+	// drawn in a single call, unless only some of them are vegetation.
+	for(uint32_t i = 0; i < scene.instances.size();) {
+		const uint32_t sm_idx = scene.instances[i].submesh;
+		const bool is_vegetation = scene.instances[i].vegetation;
+		uint32_t end = i + 1;
+		while(end < scene.instances.size()
+			&& scene.instances[end].submesh == sm_idx
+			&& bool(scene.instances[end].vegetation) == is_vegetation)
+		{
+			++end;
+		}
+
+		auto& out = is_vegetation ? vegetation_draws : draws;
+		const auto& sm = geom.submeshes[sm_idx];
+		if(geom.is_point_cloud()) {
+			out.push_back({sm.first_vertex, sm.num_vertices,
+				i, end - i});
+		} else {
+			out.push_back({sm.first_index, sm.num_indices,
+				i, end - i});
+		}
+		i = end;
+	}
+
+	if(geom.is_point_cloud()) {
+		return;
+	}
+
+	index = std::make_unique<AccessibleBuffer>(device, mem_props,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		geom.indices.size() * sizeof(uint32_t),
+		HOST_WILL_WRITE_BIT
+	);
+
 	// Copy the index data to device memory.
-	btransf.transfer<uint32_t*>(index, mesh.indices.size(),
+	btransf.transfer<uint32_t*>(*index, geom.indices.size(),
 		HOST_WILL_WRITE_BIT, [&](uint32_t *ptr) {
-			std::copy(mesh.indices.begin(), mesh.indices.end(),
+			std::copy(geom.indices.begin(), geom.indices.end(),
 				ptr);
 		}
 	);
 }
 
-TaskSlot::TaskSlot(
-	VkDevice device,
+void SceneBuffers::write_instances(const Scene& scene,
+	BufferTransferer& btransf)
+{
+	// Copy the instance transforms to device memory.
+	btransf.transfer<GpuInstance*>(instance, scene.instances.size(),
+		HOST_WILL_WRITE_BIT, [&](GpuInstance* ptr) {
+			for(const auto& inst: scene.instances) {
+				const Mat4& t = inst.transform;
+				const glm::mat3 n = glm::transpose(
+					glm::inverse(glm::mat3{t}));
+
+				// GLM matrices are column major.
+				for(uint8_t r = 0; r < 3; ++r) {
+					ptr->transform[r] = Vec4{
+						t[0][r], t[1][r], t[2][r], t[3][r]
+					};
+					ptr->normal_transform[r] = Vec4{
+						n[0][r], n[1][r], n[2][r], 0.0f
+					};
+				}
+				ptr->tracker = inst.tracker;
+				ptr->vegetation = inst.vegetation;
+				++ptr;
+			}
+		}
+	);
+}
+
+StringBuffers::StringBuffers(VkDevice device,
 	const VkPhysicalDeviceMemoryProperties& mem_props,
-	uint32_t idx, uint32_t num_points,
-	VkQueue graphic_queue
+	const StringLayout& layout, BufferTransferer& btransf
 ):
-	qf_idx{idx},
-	queue{graphic_queue},
-	global_buf{device, mem_props,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		sizeof(GlobalInputData),
+	// Never empty, as a buffer can't have size 0.
+	substring_receiver(device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		std::max<size_t>(1, layout.substring_receivers.size())
+			* sizeof(uint32_t),
 		HOST_WILL_WRITE_BIT
-	},
-	global_map{device, global_buf.get_visible_mem()},
-	result_buf{device, mem_props,
+	),
+	substring(device, mem_props,
 		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-		static_cast<uint32_t>(num_points * sizeof(Vec4)),
-		BufferAccessDirection(HOST_WILL_WRITE_BIT | HOST_WILL_READ_BIT)
+		std::max<size_t>(1, layout.substrings.size())
+			* sizeof(StringLayout::Range),
+		HOST_WILL_WRITE_BIT
+	),
+	string(device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		std::max<size_t>(1, layout.strings.size())
+			* sizeof(StringLayout::Range),
+		HOST_WILL_WRITE_BIT
+	)
+{
+	if(layout.empty()) {
+		return;
 	}
+
+	btransf.transfer<uint32_t*>(substring_receiver,
+		layout.substring_receivers.size(), HOST_WILL_WRITE_BIT,
+		[&](uint32_t* ptr) {
+			std::copy(layout.substring_receivers.begin(),
+				layout.substring_receivers.end(), ptr);
+		}
+	);
+
+	btransf.transfer<StringLayout::Range*>(substring,
+		layout.substrings.size(), HOST_WILL_WRITE_BIT,
+		[&](StringLayout::Range* ptr) {
+			std::copy(layout.substrings.begin(),
+				layout.substrings.end(), ptr);
+		}
+	);
+
+	btransf.transfer<StringLayout::Range*>(string,
+		layout.strings.size(), HOST_WILL_WRITE_BIT,
+		[&](StringLayout::Range* ptr) {
+			std::copy(layout.strings.begin(),
+				layout.strings.end(), ptr);
+		}
+	);
+}
+
+// Creates an image to be rendered and then sampled, with its memory and view.
+static void create_attachment(VkDevice device,
+	const VkPhysicalDeviceMemoryProperties& mem_props,
+	VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+	uint32_t size, UVkImage& image, UVkDeviceMemory& mem,
+	UVkImageView& view)
 {
-	// Create the depth image, used rendering destination and output.
-	depth_image = UVkImage{VkImageCreateInfo{
+	image = UVkImage{VkImageCreateInfo{
 		VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
 		nullptr,
 		0,
 		VK_IMAGE_TYPE_2D, // imageType
-		VK_FORMAT_D32_SFLOAT, // format
+		format, // format
 		{
-			frame_size, // width
-			frame_size, // height
+			size, // width
+			size, // height
 			1 // depth
 		}, // extent
 		1, // mipLevels
 		1, // arrayLayers
 		VK_SAMPLE_COUNT_1_BIT, // samples
 		VK_IMAGE_TILING_OPTIMAL, // tiling
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
-		| VK_IMAGE_USAGE_SAMPLED_BIT, // usage
+		usage | VK_IMAGE_USAGE_SAMPLED_BIT, // usage
 		VK_SHARING_MODE_EXCLUSIVE, // sharing
 		0, // queueFamilyIndexCount
 		nullptr, // pQueueFamilyIndices
 		VK_IMAGE_LAYOUT_UNDEFINED // initialLayout
 	}, device};
 
-	// Allocate depth image memory.
+	// Allocate image memory.
 	VkMemoryRequirements reqs;
-	vkGetImageMemoryRequirements(device, depth_image.get(), &reqs);
+	vkGetImageMemoryRequirements(device, image.get(), &reqs);
 
 	// Find a suitable heap. No specific needs, but prefer it to be local.
 	uint32_t mtype = find_memory_heap(
@@ -121,7 +356,7 @@ TaskSlot::TaskSlot(
 	);
 
 	// Allocate the image memory
-	depth_image_mem = UVkDeviceMemory(VkMemoryAllocateInfo{
+	mem = UVkDeviceMemory(VkMemoryAllocateInfo{
 		VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
 		nullptr,
 		reqs.size,
@@ -129,16 +364,16 @@ TaskSlot::TaskSlot(
 	}, device);
 
 	// Bind the memory to the image
-	vkBindImageMemory(device, depth_image.get(), depth_image_mem.get(), 0);
+	vkBindImageMemory(device, image.get(), mem.get(), 0);
 
 	// Create the image view:
-	depth_image_view = UVkImageView{VkImageViewCreateInfo{
+	view = UVkImageView{VkImageViewCreateInfo{
 		VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
 		nullptr,
 		0,
-		depth_image.get(),
+		image.get(),
 		VK_IMAGE_VIEW_TYPE_2D,
-		VK_FORMAT_D32_SFLOAT,
+		format,
 		{
 			VK_COMPONENT_SWIZZLE_IDENTITY,
 			VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -146,10 +381,63 @@ TaskSlot::TaskSlot(
 			VK_COMPONENT_SWIZZLE_IDENTITY
 		},
 		{
-			VK_IMAGE_ASPECT_DEPTH_BIT,
+			aspect,
 			0, 1, 0, 1
 		}
 	}, device};
+}
+
+TaskSlot::TaskSlot(
+	VkDevice device,
+	const VkPhysicalDeviceMemoryProperties& mem_props,
+	uint32_t idx, uint32_t num_points,
+	VkQueue graphic_queue, bool has_vegetation,
+	uint32_t num_strings, uint32_t frame_size
+):
+	qf_idx{idx},
+	queue{graphic_queue},
+	global_buf{device, mem_props,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		sizeof(GlobalInputData),
+		HOST_WILL_WRITE_BIT
+	},
+	global_map{device, global_buf.get_visible_mem()},
+	result_buf{device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		static_cast<uint32_t>(num_points * sizeof(Vec4)),
+		BufferAccessDirection(HOST_WILL_WRITE_BIT | HOST_WILL_READ_BIT)
+	},
+	// Only written and read by the device:
+	irradiance_buf{device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		static_cast<uint32_t>((num_strings ? num_points : 1)
+			* sizeof(float)),
+		BufferAccessDirection(0)
+	},
+	string_energy_buf{device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		static_cast<uint32_t>(std::max(1u, num_strings) * sizeof(Vec2)),
+		BufferAccessDirection(HOST_WILL_WRITE_BIT | HOST_WILL_READ_BIT)
+	},
+	string_hourly_buf{device, mem_props,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		static_cast<uint32_t>(std::max(1u, num_strings * HOURS_PER_YEAR)
+			* sizeof(float)),
+		BufferAccessDirection(HOST_WILL_WRITE_BIT | HOST_WILL_READ_BIT)
+	}
+{
+	// Create the depth image, used rendering destination and output.
+	create_attachment(device, mem_props, VK_FORMAT_D32_SFLOAT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		VK_IMAGE_ASPECT_DEPTH_BIT, frame_size,
+		depth_image, depth_image_mem, depth_image_view);
+
+	// Create the opacity map of the vegetation. Without vegetation
+	// it is not rendered, but the compute shader still needs one.
+	create_attachment(device, mem_props, opacity_format,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT, has_vegetation ? frame_size : 1,
+		opacity_image, opacity_image_mem, opacity_image_view);
 
 	// Create the frame fence
 	frame_fence = UVkFence(VkFenceCreateInfo{
@@ -161,26 +449,31 @@ TaskSlot::TaskSlot(
 
 void TaskSlot::create_command_buffer(
 	const ShadowProcessor& sp, VkCommandPool command_pool,
-	VkBuffer test_buffer, BufferTransferer &btransf)
+	const SceneBuffers &scene, VkBuffer receivers,
+	const StringBuffers &strings, BufferTransferer &btransf)
 {
 	// Create the framebuffer:
-	auto at = depth_image_view.get();
+	const VkImageView ats[] = {
+		depth_image_view.get(),
+		opacity_image_view.get()
+	};
 	framebuffer = UVkFramebuffer{VkFramebufferCreateInfo{
 		VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
 		nullptr,
 		0,
 		sp.render_pass.get(),
-		1,
-		&at,
-		frame_size,
-		frame_size,
+		sp.has_vegetation ? 2u : 1u,
+		ats,
+		sp.frame_size,
+		sp.frame_size,
 		1
 	}, sp.d.get()};
 
 	// Create descriptor set, for uniform variable
 	const VkDescriptorSetLayout dset_layouts[] = {
 		sp.uniform_desc_set_layout.get(),
-		sp.comp_sampler_dset_layout.get()
+		sp.comp_sampler_dset_layout.get(),
+		sp.mismatch_dset_layout.get()
 	};
 	const VkDescriptorSetAllocateInfo dsai {
 		VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -190,10 +483,11 @@ void TaskSlot::create_command_buffer(
 		dset_layouts
 	};
 
-	VkDescriptorSet dsets[2];
+	VkDescriptorSet dsets[3];
 	chk_vk(vkAllocateDescriptorSets(sp.d.get(), &dsai, dsets));
 	global_desc_set = dsets[0];
 	compute_desc_set = dsets[1];
+	mismatch_desc_set = dsets[2];
 
 	const VkDescriptorBufferInfo buffer_info {
 		global_buf.buf.get(),
@@ -208,8 +502,38 @@ void TaskSlot::create_command_buffer(
 		VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL
 	};
 
+	const VkDescriptorImageInfo opacity_info {
+		sp.depth_sampler.get(),
+		opacity_image_view.get(),
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	};
+
 	const VkDescriptorBufferInfo input_points_binfo {
-		test_buffer,
+		scene.vertex.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo receivers_binfo {
+		receivers,
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo instances_binfo {
+		scene.instance.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo trackers_binfo {
+		scene.tracker.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo vegetation_binfo {
+		scene.vegetation.buf.get(),
 		0,
 		VK_WHOLE_SIZE
 	};
@@ -220,6 +544,42 @@ void TaskSlot::create_command_buffer(
 		VK_WHOLE_SIZE
 	};
 
+	const VkDescriptorBufferInfo irradiance_binfo {
+		irradiance_buf.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo substring_receiver_binfo {
+		strings.substring_receiver.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo substring_binfo {
+		strings.substring.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo string_binfo {
+		strings.string.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo string_energy_binfo {
+		string_energy_buf.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	const VkDescriptorBufferInfo string_hourly_binfo {
+		string_hourly_buf.buf.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
 	const VkWriteDescriptorSet wds[] = {
 	       	{
 			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -233,6 +593,30 @@ void TaskSlot::create_command_buffer(
 			&buffer_info,
 			nullptr
 		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			global_desc_set,
+			1,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&trackers_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			global_desc_set,
+			2,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&vegetation_binfo,
+			nullptr
+		},
 		{
 			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 			nullptr,
@@ -268,74 +652,250 @@ void TaskSlot::create_command_buffer(
 			nullptr,
 			&result_binfo,
 			nullptr
-		}
-	};
-
-	vkUpdateDescriptorSets(sp.d.get(),
-		(sizeof wds) / (sizeof wds[0]), wds, 0, nullptr);
-
-	// Allocate a single command buffer:
-	cmd_bufs = UVkCommandBuffers(sp.d.get(), VkCommandBufferAllocateInfo{
-		VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		nullptr,
-		command_pool,
-		VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		1
-	});
-
-	// Zero the result buffer
-	btransf.transfer<Vec4*>(result_buf, sp.num_points,
-		HOST_WILL_WRITE_BIT, [&](Vec4* ptr) {
-			std::fill_n(ptr, sp.num_points, Vec4{0.0f, 0.0f, 0.0f, 0.0f});
-		}
-	);
-}
-
-void TaskSlot::fill_command_buffer(const ShadowProcessor& sp,
-		const MeshBuffers &scene_mesh)
-{
-	// Start recording the commands in the command buffer.
-	VkCommandBufferBeginInfo cbbi{
-		VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		nullptr,
-		0,
-		nullptr
-	};
-	chk_vk(vkBeginCommandBuffer(cmd_bufs[0], &cbbi));
-
-	// If using staging buffer, issue the transfer:
-	if(global_buf.staging_buf) {
-		const VkBufferCopy region {
-			0, 0, sizeof(GlobalInputData)
-		};
-		vkCmdCopyBuffer(cmd_bufs[0],
-			global_buf.staging_buf->buf.get(),
-			global_buf.buf.get(),
-			1, &region
-		);
-	}
-
-	// Draw the depth buffer command:
-	VkClearValue cv;
-	cv.depthStencil = {1.0, 0};
-
-	VkRenderPassBeginInfo rpbi {
-		VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		nullptr,
-		sp.render_pass.get(),
-		framebuffer.get(),
+		},
 		{
-			{0, 0},
-			{frame_size, frame_size}
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			compute_desc_set,
+			3,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&receivers_binfo,
+			nullptr
 		},
-		1,
-		&cv
-	};
-	vkCmdBeginRenderPass(cmd_bufs[0], &rpbi, VK_SUBPASS_CONTENTS_INLINE);
-
-	// Bind the pipeline:
-	vkCmdBindPipeline(cmd_bufs[0], VK_PIPELINE_BIND_POINT_GRAPHICS,
-		sp.graphic_pipeline.get());
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			compute_desc_set,
+			4,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&instances_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			compute_desc_set,
+			5,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			&opacity_info,
+			nullptr,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			compute_desc_set,
+			6,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&irradiance_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			mismatch_desc_set,
+			0,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&irradiance_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			mismatch_desc_set,
+			1,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&substring_receiver_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			mismatch_desc_set,
+			2,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&substring_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			mismatch_desc_set,
+			3,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&string_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			mismatch_desc_set,
+			4,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&string_energy_binfo,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			mismatch_desc_set,
+			5,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			nullptr,
+			&buffer_info,
+			nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			nullptr,
+			mismatch_desc_set,
+			6,
+			0,
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			nullptr,
+			&string_hourly_binfo,
+			nullptr
+		}
+	};
+
+	vkUpdateDescriptorSets(sp.d.get(),
+		(sizeof wds) / (sizeof wds[0]), wds, 0, nullptr);
+
+	// Allocate a single command buffer:
+	cmd_bufs = UVkCommandBuffers(sp.d.get(), VkCommandBufferAllocateInfo{
+		VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		nullptr,
+		command_pool,
+		VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		1
+	});
+
+	clear_result(btransf, sp.num_points, sp.num_strings);
+}
+
+void TaskSlot::clear_result(BufferTransferer& btransf, uint32_t count,
+	uint32_t num_strings)
+{
+	// Zero the result buffer
+	btransf.transfer<Vec4*>(result_buf, count,
+		HOST_WILL_WRITE_BIT, [&](Vec4* ptr) {
+			std::fill_n(ptr, count, Vec4{0.0f, 0.0f, 0.0f, 0.0f});
+		}
+	);
+
+	if(num_strings) {
+		btransf.transfer<Vec2*>(string_energy_buf, num_strings,
+			HOST_WILL_WRITE_BIT, [&](Vec2* ptr) {
+				std::fill_n(ptr, num_strings, Vec2{0.0f, 0.0f});
+			}
+		);
+
+		const uint32_t hourly_count = num_strings * HOURS_PER_YEAR;
+		btransf.transfer<float*>(string_hourly_buf, hourly_count,
+			HOST_WILL_WRITE_BIT, [&](float* ptr) {
+				std::fill_n(ptr, hourly_count, 0.0f);
+			}
+		);
+	}
+}
+
+void TaskSlot::fill_command_buffer(const ShadowProcessor& sp,
+		const SceneBuffers &scene)
+{
+	// Start recording the commands in the command buffer.
+	VkCommandBufferBeginInfo cbbi{
+		VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		nullptr,
+		0,
+		nullptr
+	};
+	chk_vk(vkBeginCommandBuffer(cmd_bufs[0], &cbbi));
+
+	// If using staging buffer, issue the transfer:
+	if(global_buf.staging_buf) {
+		const VkBufferCopy region {
+			0, 0, sizeof(GlobalInputData)
+		};
+		vkCmdCopyBuffer(cmd_bufs[0],
+			global_buf.staging_buf->buf.get(),
+			global_buf.buf.get(),
+			1, &region
+		);
+	}
+
+	// Without vegetation, the opacity map is never rendered, so it
+	// must be put in the layout expected by the compute shader.
+	if(!sp.has_vegetation) {
+		const VkImageMemoryBarrier imb {
+			VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			nullptr,
+			0,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_QUEUE_FAMILY_IGNORED,
+			VK_QUEUE_FAMILY_IGNORED,
+			opacity_image.get(),
+			{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+		};
+		vkCmdPipelineBarrier(cmd_bufs[0],
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &imb);
+	}
+
+	// Draw the depth buffer command. The opacity map starts
+	// with no optical depth, and nearest depth at the far end:
+	VkClearValue cv[2];
+	cv[0].depthStencil = {1.0, 0};
+	cv[1].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+	VkRenderPassBeginInfo rpbi {
+		VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		nullptr,
+		sp.render_pass.get(),
+		framebuffer.get(),
+		{
+			{0, 0},
+			{sp.frame_size, sp.frame_size}
+		},
+		sp.has_vegetation ? 2u : 1u,
+		cv
+	};
+	vkCmdBeginRenderPass(cmd_bufs[0], &rpbi, VK_SUBPASS_CONTENTS_INLINE);
+
+	// Bind the pipeline:
+	vkCmdBindPipeline(cmd_bufs[0], VK_PIPELINE_BIND_POINT_GRAPHICS,
+		sp.graphic_pipeline.get());
 
 	// Bind the uniform variable.
 	vkCmdBindDescriptorSets(cmd_bufs[0],
@@ -344,18 +904,48 @@ void TaskSlot::fill_command_buffer(const ShadowProcessor& sp,
 		&global_desc_set, 0, nullptr);
 
 	// Draw things:
-	const VkDeviceSize zero_offset = 0;
-
-	// Bind vertex buffer.
-	vkCmdBindVertexBuffers(cmd_bufs[0], 0, 1,
-		&scene_mesh.vertex.buf.get(), &zero_offset);
+	const VkDeviceSize zero_offsets[] = {0, 0};
 
-	// Bind index buffer.
-	vkCmdBindIndexBuffer(cmd_bufs[0],
-		scene_mesh.index.buf.get(), 0, VK_INDEX_TYPE_UINT32);
+	// Bind vertex and instance buffers.
+	const VkBuffer vbufs[] = {
+		scene.vertex.buf.get(),
+		scene.instance.buf.get()
+	};
+	vkCmdBindVertexBuffers(cmd_bufs[0], 0, 2, vbufs, zero_offsets);
+
+	if(scene.index) {
+		// Bind index buffer.
+		vkCmdBindIndexBuffer(cmd_bufs[0],
+			scene.index->buf.get(), 0, VK_INDEX_TYPE_UINT32);
+
+		// Draw every instance of every mesh:
+		for(const auto& dr: scene.draws) {
+			vkCmdDrawIndexed(cmd_bufs[0], dr.count,
+				dr.instance_count, dr.first, 0,
+				dr.first_instance);
+		}
 
-	// Draw the object:
-	vkCmdDrawIndexed(cmd_bufs[0], scene_mesh.idx_count, 1, 0, 0, 0);
+		// Vegetation goes after the opaque casters, to be depth
+		// tested against them, and only writes the opacity map.
+		if(!scene.vegetation_draws.empty()) {
+			vkCmdBindPipeline(cmd_bufs[0],
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				sp.vegetation_pipeline.get());
+
+			for(const auto& dr: scene.vegetation_draws) {
+				vkCmdDrawIndexed(cmd_bufs[0], dr.count,
+					dr.instance_count, dr.first, 0,
+					dr.first_instance);
+			}
+		}
+	} else {
+		// Draw the splats:
+		for(const auto& dr: scene.draws) {
+			vkCmdDraw(cmd_bufs[0], dr.count,
+				dr.instance_count, dr.first,
+				dr.first_instance);
+		}
+	}
 
 	// End drawing stuff.
 	vkCmdEndRenderPass(cmd_bufs[0]);
@@ -382,13 +972,37 @@ void TaskSlot::fill_command_buffer(const ShadowProcessor& sp,
 	// Perform the compute:
 	vkCmdDispatch(cmd_bufs[0], sp.wsplit.num_groups, 1, 1);
 
+	// Reduce the irradiance of the frame per string, once it is written.
+	if(sp.has_strings) {
+		const VkMemoryBarrier mb {
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			nullptr,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT
+		};
+		vkCmdPipelineBarrier(cmd_bufs[0],
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &mb, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(cmd_bufs[0], VK_PIPELINE_BIND_POINT_COMPUTE,
+			sp.mismatch_pipeline.get());
+		vkCmdBindDescriptorSets(cmd_bufs[0],
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			sp.mismatch_pipeline_layout.get(),
+			0, 1, &mismatch_desc_set, 0, nullptr
+		);
+		vkCmdDispatch(cmd_bufs[0], sp.num_strings, 1, 1);
+	}
+
 	// End compute phase.
 
 	// End command buffer.
 	chk_vk(vkEndCommandBuffer(cmd_bufs[0]));
 }
 
-void TaskSlot::compute_frame(const Vec3& sun_direction, const Vec3& denergy)
+void TaskSlot::compute_frame(const Vec3& sun_direction, const Vec3& denergy,
+	int month, int hour)
 {
 	// Get pointer to device memory:
 	auto params = global_map.get<GlobalInputData*>();
@@ -400,6 +1014,9 @@ void TaskSlot::compute_frame(const Vec3& sun_direction, const Vec3& denergy)
 
 	// Sets scaled sun's direction:
 	params->dir_energy = denergy;
+	params->sun_direction = sun_direction;
+	params->month = month - 1;
+	params->hour = hour;
 
 	// Flush the copy.
 	global_map.flush();
@@ -420,43 +1037,123 @@ void TaskSlot::compute_frame(const Vec3& sun_direction, const Vec3& denergy)
 }
 
 void TaskSlot::accumulate_result(BufferTransferer& btransf,
-	uint32_t count, Vec3* accum)
+	uint32_t count, Vec4* accum)
 {
 	btransf.transfer<Vec4*>(result_buf, count,
 		HOST_WILL_READ_BIT, [&](Vec4* ptr) {
 			for(uint32_t i = 0; i < count; ++i) {
-				accum[i].x += ptr[i].x;
-				accum[i].y += ptr[i].y;
-				accum[i].z += ptr[i].z;
+				accum[i] += ptr[i];
+			}
+		}
+	);
+}
+
+void TaskSlot::accumulate_strings(BufferTransferer& btransf,
+	uint32_t num_strings, Vec2* accum, float* hourly)
+{
+	btransf.transfer<Vec2*>(string_energy_buf, num_strings,
+		HOST_WILL_READ_BIT, [&](Vec2* ptr) {
+			for(uint32_t i = 0; i < num_strings; ++i) {
+				accum[i] += ptr[i];
+			}
+		}
+	);
+
+	const uint32_t hourly_count = num_strings * HOURS_PER_YEAR;
+	btransf.transfer<float*>(string_hourly_buf, hourly_count,
+		HOST_WILL_READ_BIT, [&](float* ptr) {
+			for(uint32_t i = 0; i < hourly_count; ++i) {
+				hourly[i] += ptr[i];
 			}
 		}
 	);
 }
 
 WorkGroupSplit::WorkGroupSplit(const VkPhysicalDeviceLimits &dlimits,
-	uint32_t work_size)
+	uint32_t work_size, uint32_t max_group_size)
 {
-	const uint32_t limit = std::max(
+	uint32_t limit = std::max(
 		dlimits.maxComputeWorkGroupInvocations,
 		dlimits.maxComputeWorkGroupSize[0]
 	);
+	if(max_group_size) {
+		limit = std::min(limit, max_group_size);
+	}
 
 	num_groups = work_size / limit + (work_size % limit > 0);
 	group_x_size = work_size / num_groups + (work_size % num_groups > 0);
 }
 
+ShadowProcessor::MemoryEstimate ShadowProcessor::estimate_memory(
+	const Scene& shadow_scene, size_t num_receivers,
+	const StringLayout& strings, uint32_t frame_size)
+{
+	const uint64_t num_strings = strings.strings.size();
+	const uint64_t frame = uint64_t(frame_size) * frame_size;
+
+	MemoryEstimate ret;
+	ret.fixed = shadow_scene.geometry.vertices.size() * sizeof(GpuVertex)
+		+ shadow_scene.geometry.indices.size() * sizeof(uint32_t)
+		+ shadow_scene.instances.size() * sizeof(GpuInstance)
+		+ num_receivers * sizeof(Receiver)
+		+ strings.substring_receivers.size() * sizeof(uint32_t)
+		+ (strings.substrings.size() + num_strings)
+			* sizeof(StringLayout::Range);
+
+	// Depth and opacity maps, with 4 half floats
+	// per pixel, and the per frame buffers.
+	ret.per_slot = frame * sizeof(float)
+		+ (shadow_scene.vegetation.empty() ? 0 : frame * 8)
+		+ num_receivers * sizeof(Vec4)
+		+ (num_strings ? num_receivers * sizeof(float) : 0)
+		+ num_strings * (sizeof(Vec2) + HOURS_PER_YEAR * sizeof(float))
+		+ sizeof(GlobalInputData);
+	return ret;
+}
+
 ShadowProcessor::ShadowProcessor(
 	VkPhysicalDevice pdevice,
 	const VkPhysicalDeviceProperties &pd_props,
 	UVkDevice&& device,
 	std::vector<std::pair<uint32_t, std::vector<VkQueue>>>&& qfamilies,
-	const Mesh &shadow_mesh, const std::vector<VertexData>& test_set
+	const Scene &shadow_scene, const std::vector<Receiver>& receivers,
+	const StringLayout& string_layout, const ProcessorTuning& tuning
 ):
 	device_name{pd_props.deviceName},
-	num_points{static_cast<uint32_t>(test_set.size())},
-	wsplit{pd_props.limits, num_points},
+	properties(pd_props),
+	slots_per_queue{std::max(1u, tuning.slots_per_queue)},
+	frame_size{tuning.frame_size},
+	num_points{static_cast<uint32_t>(receivers.size())},
+	wsplit{pd_props.limits, num_points, tuning.max_group_size},
+	point_cloud{shadow_scene.geometry.is_point_cloud()},
+	max_point_size{pd_props.limits.pointSizeRange[1]},
+	max_image_size{pd_props.limits.maxImageDimension2D},
+	has_vegetation{!shadow_scene.vegetation.empty()},
+	num_strings{static_cast<uint32_t>(string_layout.strings.size())},
+	has_strings{num_strings > 0},
 	d{std::move(device)}
 {
+	if(frame_size == 0
+		|| frame_size > pd_props.limits.maxFramebufferWidth
+		|| frame_size > pd_props.limits.maxFramebufferHeight)
+	{
+		throw std::runtime_error(
+			"Frame size not supported by the device.\n"
+		);
+	}
+
+	if(point_cloud) {
+		// Without large points, only 1 pixel sized
+		// points can be drawn, which are useless.
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures(pdevice, &features);
+		if(!features.largePoints) {
+			throw std::runtime_error(
+				"Device can't draw point cloud splats.\n"
+			);
+		}
+	}
+
 	// Create depth buffer rendering pipeline:
 	create_render_pipeline();
 
@@ -465,7 +1162,7 @@ ShadowProcessor::ShadowProcessor(
 
 	unsigned num_slots = 0;
 	for(auto &qf: qfamilies) {
-		num_slots += qf.second.size() * SLOTS_PER_QUEUE;
+		num_slots += qf.second.size() * slots_per_queue;
 	}
 
 	// Create the allocation pools.
@@ -473,22 +1170,22 @@ ShadowProcessor::ShadowProcessor(
 	const VkDescriptorPoolSize dps[] = {
 	       	{
 			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			num_slots
+			2 * num_slots
 		},
 		{
 			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-			2 * num_slots
+			13 * num_slots
 		},
 	       	{
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			num_slots
+			2 * num_slots
 		}
 	};
 	desc_pool = UVkDescriptorPool(VkDescriptorPoolCreateInfo{
 		VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 		nullptr,
 		0,
-		2 * num_slots,
+		3 * num_slots,
 		(sizeof dps) / (sizeof dps[0]),
 		dps
 	}, d.get());
@@ -509,21 +1206,26 @@ ShadowProcessor::ShadowProcessor(
 
 		BufferTransferer btransf{d.get(), mem_props,
 			command_pool.back().get(), qf.second[0]};
+		family_index.push_back(qf.first);
+		transfer_queue.push_back(qf.second[0]);
 
 		// Allocate constant buffers for this queue family:
-		mesh.emplace_back(d.get(), mem_props, shadow_mesh, btransf);
-		test_buffer.emplace_back(d.get(), mem_props,
+		scene.emplace_back(d.get(), mem_props, shadow_scene, btransf);
+		receiver_buffer.emplace_back(d.get(), mem_props,
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			test_set.size() * sizeof(VertexData),
+			receivers.size() * sizeof(Receiver),
 			HOST_WILL_WRITE_BIT
 		);
 
-		// Fill the test buffer with the test points.
-		btransf.transfer<VertexData*>(test_buffer.back(),
-			test_set.size(), HOST_WILL_WRITE_BIT,
-			[&](VertexData* ptr) {
-				std::copy(test_set.begin(),
-					test_set.end(),
+		strings.emplace_back(d.get(), mem_props, string_layout,
+			btransf);
+
+		// Fill the receiver buffer with the test points.
+		btransf.transfer<Receiver*>(receiver_buffer.back(),
+			receivers.size(), HOST_WILL_WRITE_BIT,
+			[&](Receiver* ptr) {
+				std::copy(receivers.begin(),
+					receivers.end(),
 					ptr
 				);
 			}
@@ -533,16 +1235,20 @@ ShadowProcessor::ShadowProcessor(
 		// written buffers will be local to it.
 		// TODO: remove support for multiple queues here...
 		for(auto& q: qf.second) {
-			for(unsigned i = 0; i < SLOTS_PER_QUEUE; ++i) {
+			for(unsigned i = 0; i < slots_per_queue; ++i) {
 				task_pool.emplace_back(d.get(),	mem_props,
-					qf.first, num_points, q);
+					qf.first, num_points, q,
+					has_vegetation, num_strings,
+					frame_size);
 
 				task_pool.back().create_command_buffer(
 					*this, command_pool.back().get(),
-					test_buffer.back().buf.get(), btransf
+					scene.back(),
+					receiver_buffer.back().buf.get(),
+					strings.back(), btransf
 				);
 				task_pool.back().fill_command_buffer(*this,
-					mesh.back()
+					scene.back()
 				);
 
 				fence_set.push_back(task_pool.back().get_fence());
@@ -559,65 +1265,196 @@ void ShadowProcessor::create_render_pipeline()
 		#include "depth-map.vert.inc"
 	;
 
-	vert_shader = UVkShaderModule(VkShaderModuleCreateInfo {
-		VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-		nullptr,
-		0,
-		sizeof vert_shader_data,
-		vert_shader_data
-	}, d.get());
+	// Point clouds use a vertex and fragment shader
+	// pair to draw each point as an oriented disk:
+	static const uint32_t splat_vert_shader_data[] =
+		#include "depth-splat.vert.inc"
+	;
 
-	const VkPipelineShaderStageCreateInfo pss {
-		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		nullptr,
-		0,
-		VK_SHADER_STAGE_VERTEX_BIT,
-		vert_shader.get(),
-		"main",
-		nullptr
-	};
+	static const uint32_t splat_frag_shader_data[] =
+		#include "depth-splat.frag.inc"
+	;
 
-	// Vertex data description:
-	const VkVertexInputBindingDescription vibd {
-		0,
-		sizeof(Vec3),
-		VK_VERTEX_INPUT_RATE_VERTEX
-	};
+	// Vegetation is drawn into the opacity map:
+	static const uint32_t opacity_frag_shader_data[] =
+		#include "opacity-map.frag.inc"
+	;
 
-	// Position attribute in vertex data:
-	const VkVertexInputAttributeDescription viad {
-		0,
-		0,
-		VK_FORMAT_R32G32B32_SFLOAT,
-		0,
+	if(point_cloud) {
+		vert_shader = UVkShaderModule(VkShaderModuleCreateInfo {
+			VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			nullptr,
+			0,
+			sizeof splat_vert_shader_data,
+			splat_vert_shader_data
+		}, d.get());
+
+		frag_shader = UVkShaderModule(VkShaderModuleCreateInfo {
+			VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			nullptr,
+			0,
+			sizeof splat_frag_shader_data,
+			splat_frag_shader_data
+		}, d.get());
+	} else {
+		vert_shader = UVkShaderModule(VkShaderModuleCreateInfo {
+			VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			nullptr,
+			0,
+			sizeof vert_shader_data,
+			vert_shader_data
+		}, d.get());
+	}
+
+	if(has_vegetation) {
+		opacity_shader = UVkShaderModule(VkShaderModuleCreateInfo {
+			VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			nullptr,
+			0,
+			sizeof opacity_frag_shader_data,
+			opacity_frag_shader_data
+		}, d.get());
+	}
+
+	// Frame size and maximum point size are
+	// specialization constants of the splat shader.
+	const float splat_consts[] = {
+		float(frame_size),
+		max_point_size
 	};
 
-	// Vertex input description:
-	const VkPipelineVertexInputStateCreateInfo pvis {
-		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		nullptr,
-		0,
-		1,
-		&vibd,
-		1,
-		&viad
+	const VkSpecializationMapEntry splat_specializations[] = {
+		{0, 0, sizeof(float)},
+		{1, sizeof(float), sizeof(float)}
 	};
 
-	// Primitive assembly description
-	const VkPipelineInputAssemblyStateCreateInfo pias {
-		VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-		nullptr,
-		0,
-		VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-		VK_FALSE
+	const VkSpecializationInfo splat_sinfo {
+		(sizeof splat_specializations)
+			/ (sizeof splat_specializations[0]),
+		splat_specializations,
+		sizeof splat_consts,
+		splat_consts
 	};
 
-	// Viweport creation:
+	const VkPipelineShaderStageCreateInfo pss[] = {
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_SHADER_STAGE_VERTEX_BIT,
+			vert_shader.get(),
+			"main",
+			point_cloud ? &splat_sinfo : nullptr
+		},
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			frag_shader.get(),
+			"main",
+			nullptr
+		}
+	};
+
+	// Vertex data description, both per vertex and per instance:
+	const VkVertexInputBindingDescription vibds[] = {
+		{
+			0,
+			sizeof(GpuVertex),
+			VK_VERTEX_INPUT_RATE_VERTEX
+		},
+		{
+			1,
+			sizeof(GpuInstance),
+			VK_VERTEX_INPUT_RATE_INSTANCE
+		}
+	};
+
+	std::vector<VkVertexInputAttributeDescription> viads {
+		// Position attribute in vertex data
+		// (with the radius, for splats):
+		{
+			0,
+			0,
+			point_cloud ? VK_FORMAT_R32G32B32A32_SFLOAT
+				: VK_FORMAT_R32G32B32_SFLOAT,
+			0,
+		}
+	};
+
+	// Instance transform rows:
+	for(uint32_t i = 0; i < 3; ++i) {
+		viads.push_back({
+			2 + i,
+			1,
+			VK_FORMAT_R32G32B32A32_SFLOAT,
+			uint32_t(offsetof(GpuInstance, transform)
+				+ i * sizeof(Vec4))
+		});
+	}
+
+	// Tracker and vegetation groups of the instance:
+	viads.push_back({
+		8,
+		1,
+		VK_FORMAT_R32_UINT,
+		offsetof(GpuInstance, tracker)
+	});
+	viads.push_back({
+		9,
+		1,
+		VK_FORMAT_R32_UINT,
+		offsetof(GpuInstance, vegetation)
+	});
+
+	// Splats are oriented, so they also need the normals:
+	if(point_cloud) {
+		viads.push_back({
+			1,
+			0,
+			VK_FORMAT_R32G32B32_SFLOAT,
+			offsetof(GpuVertex, normal)
+		});
+
+		for(uint32_t i = 0; i < 3; ++i) {
+			viads.push_back({
+				5 + i,
+				1,
+				VK_FORMAT_R32G32B32A32_SFLOAT,
+				uint32_t(offsetof(GpuInstance, normal_transform)
+					+ i * sizeof(Vec4))
+			});
+		}
+	}
+
+	// Vertex input description:
+	const VkPipelineVertexInputStateCreateInfo pvis {
+		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		(sizeof vibds) / (sizeof vibds[0]),
+		vibds,
+		uint32_t(viads.size()),
+		viads.data()
+	};
+
+	// Primitive assembly description
+	const VkPipelineInputAssemblyStateCreateInfo pias {
+		VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		point_cloud ? VK_PRIMITIVE_TOPOLOGY_POINT_LIST
+			: VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		VK_FALSE
+	};
+
+	// Viweport creation:
 	const VkViewport viewport {
 		0.0,
 		0.0,
-		frame_size,
-		frame_size,
+		float(frame_size),
+		float(frame_size),
 		0.0,
 		1.0
 	};
@@ -645,7 +1482,9 @@ void ShadowProcessor::create_render_pipeline()
 		VK_FALSE,
 		VK_FALSE,
 		VK_POLYGON_MODE_FILL,
-		VK_CULL_MODE_BACK_BIT,
+		// Points have no facing, and instances with mirrored
+		// transforms have their triangles wound the other way:
+		VK_CULL_MODE_NONE,
 		VK_FRONT_FACE_COUNTER_CLOCKWISE,
 		VK_FALSE,
 		0.0,
@@ -683,6 +1522,29 @@ void ShadowProcessor::create_render_pipeline()
 		1.0
 	};
 
+	// Opaque casters don't touch the opacity map:
+	const VkPipelineColorBlendAttachmentState opaque_blend {
+		VK_FALSE,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_FACTOR_ZERO,
+		VK_BLEND_OP_ADD,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_FACTOR_ZERO,
+		VK_BLEND_OP_ADD,
+		0
+	};
+
+	const VkPipelineColorBlendStateCreateInfo pcbs {
+		VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		VK_FALSE,
+		VK_LOGIC_OP_COPY,
+		has_vegetation ? 1u : 0u,
+		&opaque_blend,
+		{0.0f, 0.0f, 0.0f, 0.0f}
+	};
+
 	// Push constant used to push the orientation
 	// quaternion into the vertex shader.
 	/*const VkPushConstantRange pcr {
@@ -691,14 +1553,34 @@ void ShadowProcessor::create_render_pipeline()
 		sizeof(Vec4)
 	};*/
 
-	// Uniform variable setting.
-	const VkDescriptorSetLayoutBinding dslb {
-		0,
-		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-		1,
-		VK_SHADER_STAGE_VERTEX_BIT |
-		VK_SHADER_STAGE_COMPUTE_BIT,
-		nullptr
+	// Uniform variable setting, the tracker groups, which are
+	// needed wherever the instances are placed, and the
+	// vegetation groups, for drawing the opacity map.
+	const VkDescriptorSetLayoutBinding dslbs[] = {
+		{
+			0,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			1,
+			VK_SHADER_STAGE_VERTEX_BIT |
+			VK_SHADER_STAGE_FRAGMENT_BIT |
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			nullptr
+		},
+		{
+			1,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_VERTEX_BIT |
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			nullptr
+		},
+		{
+			2,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			nullptr
+		}
 	};
 
 	uniform_desc_set_layout = UVkDescriptorSetLayout(
@@ -706,8 +1588,8 @@ void ShadowProcessor::create_render_pipeline()
 			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
 			nullptr,
 			0,
-			1,
-			&dslb
+			(sizeof dslbs) / (sizeof dslbs[0]),
+			dslbs
 		}, d.get()
 	);
 
@@ -724,16 +1606,31 @@ void ShadowProcessor::create_render_pipeline()
 	// Depth buffer attachment.
 	// After the render pass, the image should be in
 	// a layout to be sampled by the compute shader.
-	const VkAttachmentDescription dbad {
-		0,
-		VK_FORMAT_D32_SFLOAT,
-		VK_SAMPLE_COUNT_1_BIT,
-		VK_ATTACHMENT_LOAD_OP_CLEAR,
-		VK_ATTACHMENT_STORE_OP_STORE,
-		VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-		VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL
+	// The vegetation opacity map, only attached if there
+	// is vegetation, is also sampled by the compute shader.
+	const VkAttachmentDescription ads[] = {
+		{
+			0,
+			VK_FORMAT_D32_SFLOAT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_ATTACHMENT_LOAD_OP_CLEAR,
+			VK_ATTACHMENT_STORE_OP_STORE,
+			VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL
+		},
+		{
+			0,
+			opacity_format,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_ATTACHMENT_LOAD_OP_CLEAR,
+			VK_ATTACHMENT_STORE_OP_STORE,
+			VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		}
 	};
 
 	// Depth buffer attachment reference:
@@ -742,14 +1639,20 @@ void ShadowProcessor::create_render_pipeline()
 		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
 	};
 
+	// Opacity map attachment reference:
+	const VkAttachmentReference omar {
+		1,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+	};
+
 	// Only subpass in our render pass:
 	const VkSubpassDescription sd {
 		0,
 		VK_PIPELINE_BIND_POINT_GRAPHICS,
 		0,
 		nullptr,
-		0,
-		nullptr,
+		has_vegetation ? 1u : 0u,
+		&omar,
 		nullptr,
 		&dbar,
 		0,
@@ -766,20 +1669,23 @@ void ShadowProcessor::create_render_pipeline()
 			VK_SUBPASS_EXTERNAL, // srcSubpass
 			0, // dstSubpass
 			VK_PIPELINE_STAGE_TRANSFER_BIT, // srcStageMask
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, // dstStageMask
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+			| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask
 			VK_ACCESS_TRANSFER_WRITE_BIT, // srcAccessMask
 			VK_ACCESS_UNIFORM_READ_BIT, // dstAccessMask
 			0 // dependencyFlags
 		},
-		// Set the compute shader read of the depth buffer
-		// to be dependant on the graphics pipeline having finished
-		// writing it.
+		// Set the compute shader read of the depth buffer and
+		// opacity map to be dependant on the graphics pipeline
+		// having finished writing them.
 		{
 			0, // srcSubpass
 			VK_SUBPASS_EXTERNAL, // dstSubpass
-			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, // srcStageMask
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+			| VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // srcStageMask
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // dstStageMask
-			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, // srcAccessMask
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+			| VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // srcAccessMask
 			VK_ACCESS_SHADER_READ_BIT, // dstAccessMask
 			0 // dependencyFlags
 		}
@@ -789,8 +1695,8 @@ void ShadowProcessor::create_render_pipeline()
 		VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
 		nullptr,
 		0,
-		1,
-		&dbad,
+		has_vegetation ? 2u : 1u,
+		ads,
 		1,
 		&sd,
 		2,
@@ -801,8 +1707,8 @@ void ShadowProcessor::create_render_pipeline()
 		VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
 		nullptr,
 		0,
-		1,       // stageCount
-		&pss, // pStages
+		point_cloud ? 2u : 1u, // stageCount
+		pss,     // pStages
 		&pvis,   // pVertexInputState
 		&pias,   // pInputAssemblyState
 		nullptr, // pTessellationState
@@ -810,7 +1716,70 @@ void ShadowProcessor::create_render_pipeline()
 		&prs,    // pRasterizationState
 		&pms,    // pMultisampleState
 		&pdss,   // pDepthStencilState
-		nullptr, // pColorBlendState
+		&pcbs,   // pColorBlendState
+		nullptr, // pDynamicState
+		graphic_pipeline_layout.get(), // layout
+		render_pass.get(),     // renderPass
+		0,                     // subpass
+		VK_NULL_HANDLE, // basePipelineHandle
+		-1              // basePipelineIndex
+	}, d.get(), nullptr, 1);
+
+	if(!has_vegetation) {
+		return;
+	}
+
+	// Vegetation pipeline: both sides of the crown are drawn,
+	// without writing depth, accumulating the optical depth,
+	// and keeping the nearest depth in alpha.
+	const VkPipelineShaderStageCreateInfo vegetation_pss[] = {
+		pss[0],
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			opacity_shader.get(),
+			"main",
+			nullptr
+		}
+	};
+
+	VkPipelineRasterizationStateCreateInfo vegetation_prs = prs;
+	vegetation_prs.cullMode = VK_CULL_MODE_NONE;
+
+	VkPipelineDepthStencilStateCreateInfo vegetation_pdss = pdss;
+	vegetation_pdss.depthWriteEnable = VK_FALSE;
+
+	const VkPipelineColorBlendAttachmentState vegetation_blend {
+		VK_TRUE,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_OP_ADD,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_OP_MIN,
+		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+	};
+
+	VkPipelineColorBlendStateCreateInfo vegetation_pcbs = pcbs;
+	vegetation_pcbs.pAttachments = &vegetation_blend;
+
+	vegetation_pipeline = UVkGraphicsPipeline(VkGraphicsPipelineCreateInfo{
+		VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		nullptr,
+		0,
+		2,       // stageCount
+		vegetation_pss, // pStages
+		&pvis,   // pVertexInputState
+		&pias,   // pInputAssemblyState
+		nullptr, // pTessellationState
+		&pvs,    // pViewportState
+		&vegetation_prs,  // pRasterizationState
+		&pms,    // pMultisampleState
+		&vegetation_pdss, // pDepthStencilState
+		&vegetation_pcbs, // pColorBlendState
 		nullptr, // pDynamicState
 		graphic_pipeline_layout.get(), // layout
 		render_pass.get(),     // renderPass
@@ -883,6 +1852,42 @@ void ShadowProcessor::create_compute_pipeline()
 			1,
 			VK_SHADER_STAGE_COMPUTE_BIT,
 			nullptr
+		},
+
+		// Vertex and instance of each input point:
+		{
+			3,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			nullptr
+		},
+
+		// Instance transforms (same buffer as graphics attributes):
+		{
+			4,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			nullptr
+		},
+
+		// Vegetation opacity map sampler:
+		{
+			5,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			1,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			&depth_sampler.get()
+		},
+
+		// Irradiance of each input point in the frame:
+		{
+			6,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			nullptr
 		}
 	};
 
@@ -926,6 +1931,16 @@ void ShadowProcessor::create_compute_pipeline()
 			1,
 			ptr_delta(this, &wsplit.group_x_size),
 			sizeof wsplit.group_x_size
+		},
+		{
+			2,
+			ptr_delta(this, &has_vegetation),
+			sizeof has_vegetation
+		},
+		{
+			3,
+			ptr_delta(this, &has_strings),
+			sizeof has_strings
 		}
 	};
 
@@ -954,9 +1969,80 @@ void ShadowProcessor::create_compute_pipeline()
 		VK_NULL_HANDLE,
 		-1
 	}, d.get(), nullptr, 1};
+
+	create_mismatch_pipeline();
 }
 
-void ShadowProcessor::process(const Vec3& sun, const InstantaneousData& instant)
+void ShadowProcessor::create_mismatch_pipeline()
+{
+	static const uint32_t mismatch_shader_data[] =
+		#include "mismatch.comp.inc"
+	;
+
+	mismatch_shader = UVkShaderModule(VkShaderModuleCreateInfo {
+		VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		nullptr,
+		0,
+		sizeof mismatch_shader_data,
+		mismatch_shader_data
+	}, d.get());
+
+	// Frame irradiance, substring receivers, substrings, strings,
+	// accumulated string energy, the global uniform and the
+	// hourly string energy, in this order:
+	VkDescriptorSetLayoutBinding dslbs[7];
+	for(uint32_t i = 0; i < 7; ++i) {
+		dslbs[i] = {
+			i,
+			i == 5 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+				: VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			1,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			nullptr
+		};
+	}
+
+	mismatch_dset_layout = UVkDescriptorSetLayout{
+		VkDescriptorSetLayoutCreateInfo{
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			nullptr,
+			0,
+			(sizeof dslbs) / (sizeof dslbs[0]),
+			dslbs
+		}, d.get()
+	};
+
+	mismatch_pipeline_layout = UVkPipelineLayout(VkPipelineLayoutCreateInfo{
+		VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		nullptr,
+		0,
+		1,
+		&mismatch_dset_layout.get(),
+		0,
+		nullptr
+	}, d.get());
+
+	mismatch_pipeline = UVkComputePipeline{VkComputePipelineCreateInfo{
+		VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		nullptr,
+		0,
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			mismatch_shader.get(),
+			"main",
+			nullptr
+		},
+		mismatch_pipeline_layout.get(),
+		VK_NULL_HANDLE,
+		-1
+	}, d.get(), nullptr, 1};
+}
+
+Vec3 ShadowProcessor::add_to_totals(const Vec3& sun,
+	const InstantaneousData& instant)
 {
 	const Vec3 directional_energy =
 		float(instant.coefficient * instant.direct_power) * sun;
@@ -966,6 +2052,20 @@ void ShadowProcessor::process(const Vec3& sun, const InstantaneousData& instant)
 
 	// For some reason, the sum of integration coefficients adds to total time:
 	time_sum += instant.coefficient;
+
+	return directional_energy;
+}
+
+void ShadowProcessor::skip(const Vec3& sun, const InstantaneousData& instant)
+{
+	// The directional energy still counts in the total, so the
+	// occlusion shows up in the shadow percentage of the points.
+	add_to_totals(sun, instant);
+}
+
+void ShadowProcessor::process(const Vec3& sun, const InstantaneousData& instant)
+{
+	const Vec3 directional_energy = add_to_totals(sun, instant);
 	++count;
 
 	if(available_slots.empty()) {
@@ -994,10 +2094,47 @@ void ShadowProcessor::process(const Vec3& sun, const InstantaneousData& instant)
 
 	// Send the processing to that slot.
 	vkResetFences(d.get(), 1, &fence_set[task_idx]);
-	task_pool[task_idx].compute_frame(sun, directional_energy);
+	task_pool[task_idx].compute_frame(sun, directional_energy,
+		instant.month, instant.hour);
+}
+
+void ShadowProcessor::restart(const Scene& shadow_scene)
+{
+	chk_vk(vkDeviceWaitIdle(d.get()));
+
+	// The command buffers refer to the same buffers, so
+	// they are still valid after the buffers are rewritten.
+	for(size_t i = 0; i < scene.size(); ++i) {
+		BufferTransferer btransf{d.get(), mem_props,
+			command_pool[i].get(), transfer_queue[i]};
+		scene[i].write_instances(shadow_scene, btransf);
+	}
+
+	clear();
 }
 
-void ShadowProcessor::accumulate_result(Vec3 *accum)
+void ShadowProcessor::clear()
+{
+	chk_vk(vkDeviceWaitIdle(d.get()));
+
+	for(size_t i = 0; i < scene.size(); ++i) {
+		BufferTransferer btransf{d.get(), mem_props,
+			command_pool[i].get(), transfer_queue[i]};
+		for(auto& t: task_pool) {
+			if(t.get_queue_family() == family_index[i]) {
+				t.clear_result(btransf, num_points,
+					num_strings);
+			}
+		}
+	}
+
+	directional_sum = {0,0,0};
+	diffuse_sum = 0.0;
+	time_sum = 0.0;
+	count = 0;
+}
+
+void ShadowProcessor::accumulate_result(Vec4 *accum)
 {
 	chk_vk(vkDeviceWaitIdle(d.get()));
 	// TODO: this is wrong: must separate btransf by queue family.
@@ -1009,3 +2146,571 @@ void ShadowProcessor::accumulate_result(Vec3 *accum)
 	chk_vk(vkDeviceWaitIdle(d.get()));
 }
 
+void ShadowProcessor::accumulate_strings(Vec2 *accum, float *hourly)
+{
+	chk_vk(vkDeviceWaitIdle(d.get()));
+	BufferTransferer btransf{d.get(), mem_props,
+		command_pool[0].get(), task_pool[0].get_queue()};
+	for(auto& t: task_pool) {
+		t.accumulate_strings(btransf, num_strings, accum, hourly);
+	}
+	chk_vk(vkDeviceWaitIdle(d.get()));
+}
+
+std::vector<float> ShadowProcessor::render_top_down(const Mesh& mesh,
+	real scale, const std::vector<float>& values, const TopDownGrid& grid,
+	float nodata)
+{
+	static const uint32_t vert_shader_data[] =
+		#include "top-down.vert.inc"
+	;
+
+	static const uint32_t frag_shader_data[] =
+		#include "top-down.frag.inc"
+	;
+
+	chk_vk(vkDeviceWaitIdle(d.get()));
+
+	const VkDevice device = d.get();
+	const VkQueue queue = transfer_queue[0];
+	const uint32_t tile_size = std::min(max_tile_size, max_image_size);
+	const bool points = mesh.is_point_cloud();
+
+	// Vertices in the output frame, and the vertical
+	// extent of the model, mapped to the depth range.
+	const uint32_t num_vertices = mesh.vertices.size();
+	real bottom = std::numeric_limits<real>::infinity();
+	real top = -bottom;
+	for(const auto& v: mesh.vertices) {
+		const real y = scale * v.position.y;
+		bottom = std::min(bottom, y);
+		top = std::max(top, y);
+	}
+
+	// The depth range is slightly larger, so that the
+	// lowest point is not clipped by the far plane.
+	const float depth_scale = 1.0f / ((top - bottom) * 1.01f + 1e-6f);
+
+	BufferTransferer btransf{device, mem_props,
+		command_pool[0].get(), queue};
+
+	AccessibleBuffer vertex_buf{device, mem_props,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		uint32_t(num_vertices * sizeof(TopDownVertex)),
+		HOST_WILL_WRITE_BIT
+	};
+	btransf.transfer<TopDownVertex*>(vertex_buf, num_vertices,
+		HOST_WILL_WRITE_BIT, [&](TopDownVertex* ptr) {
+			for(uint32_t i = 0; i < num_vertices; ++i) {
+				ptr[i] = {
+					scale * mesh.vertices[i].position,
+					values[i],
+					points ? scale * mesh.splat_radius[i]
+						: 0.0f
+				};
+			}
+		}
+	);
+
+	std::unique_ptr<AccessibleBuffer> index_buf;
+	if(!points) {
+		index_buf = std::make_unique<AccessibleBuffer>(device,
+			mem_props, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			uint32_t(mesh.indices.size() * sizeof(uint32_t)),
+			HOST_WILL_WRITE_BIT
+		);
+		btransf.transfer<uint32_t*>(*index_buf, mesh.indices.size(),
+			HOST_WILL_WRITE_BIT, [&](uint32_t* ptr) {
+				std::copy(mesh.indices.begin(),
+					mesh.indices.end(), ptr);
+			}
+		);
+	}
+
+	// The value is rendered over a depth buffer, and copied
+	// from the image to a host readable buffer, tile by tile.
+	UVkImage depth_image, value_image;
+	UVkDeviceMemory depth_image_mem, value_image_mem;
+	UVkImageView depth_image_view, value_image_view;
+	create_attachment(device, mem_props, VK_FORMAT_D32_SFLOAT,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		VK_IMAGE_ASPECT_DEPTH_BIT, tile_size,
+		depth_image, depth_image_mem, depth_image_view);
+	create_attachment(device, mem_props, VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT, tile_size,
+		value_image, value_image_mem, value_image_view);
+
+	const uint32_t tile_bytes = tile_size * tile_size * sizeof(float);
+	Buffer readback{device, mem_props,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT, tile_bytes,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 0
+	};
+
+	const VkAttachmentDescription ads[] = {
+		{
+			0,
+			VK_FORMAT_R32_SFLOAT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_ATTACHMENT_LOAD_OP_CLEAR,
+			VK_ATTACHMENT_STORE_OP_STORE,
+			VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+		},
+		{
+			0,
+			VK_FORMAT_D32_SFLOAT,
+			VK_SAMPLE_COUNT_1_BIT,
+			VK_ATTACHMENT_LOAD_OP_CLEAR,
+			VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		}
+	};
+
+	const VkAttachmentReference var {
+		0,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+	};
+
+	const VkAttachmentReference dbar {
+		1,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	};
+
+	const VkSubpassDescription sd {
+		0,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		0,
+		nullptr,
+		1,
+		&var,
+		nullptr,
+		&dbar,
+		0,
+		nullptr
+	};
+
+	// The copy of the value image to the buffer
+	// waits for the rendering to finish.
+	const VkSubpassDependency sdep {
+		0, // srcSubpass
+		VK_SUBPASS_EXTERNAL, // dstSubpass
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // srcStageMask
+		VK_PIPELINE_STAGE_TRANSFER_BIT, // dstStageMask
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, // srcAccessMask
+		VK_ACCESS_TRANSFER_READ_BIT, // dstAccessMask
+		0 // dependencyFlags
+	};
+
+	UVkRenderPass rpass{VkRenderPassCreateInfo {
+		VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		nullptr,
+		0,
+		2,
+		ads,
+		1,
+		&sd,
+		1,
+		&sdep
+	}, device};
+
+	const VkImageView ats[] = {
+		value_image_view.get(),
+		depth_image_view.get()
+	};
+	UVkFramebuffer fb{VkFramebufferCreateInfo{
+		VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+		nullptr,
+		0,
+		rpass.get(),
+		2,
+		ats,
+		tile_size,
+		tile_size,
+		1
+	}, device};
+
+	UVkShaderModule vert{VkShaderModuleCreateInfo {
+		VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		nullptr,
+		0,
+		sizeof vert_shader_data,
+		vert_shader_data
+	}, device};
+
+	UVkShaderModule frag{VkShaderModuleCreateInfo {
+		VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		nullptr,
+		0,
+		sizeof frag_shader_data,
+		frag_shader_data
+	}, device};
+
+	// Maximum point size in the vertex shader,
+	// and whether to cut disks in the fragment shader.
+	const VkSpecializationMapEntry vert_specialization {
+		0, 0, sizeof(float)
+	};
+	const VkSpecializationInfo vert_sinfo {
+		1,
+		&vert_specialization,
+		sizeof max_point_size,
+		&max_point_size
+	};
+
+	const VkBool32 is_point_cloud = points;
+	const VkSpecializationMapEntry frag_specialization {
+		0, 0, sizeof(VkBool32)
+	};
+	const VkSpecializationInfo frag_sinfo {
+		1,
+		&frag_specialization,
+		sizeof is_point_cloud,
+		&is_point_cloud
+	};
+
+	const VkPipelineShaderStageCreateInfo pss[] = {
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_SHADER_STAGE_VERTEX_BIT,
+			vert.get(),
+			"main",
+			&vert_sinfo
+		},
+		{
+			VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			nullptr,
+			0,
+			VK_SHADER_STAGE_FRAGMENT_BIT,
+			frag.get(),
+			"main",
+			&frag_sinfo
+		}
+	};
+
+	const VkVertexInputBindingDescription vibd {
+		0,
+		sizeof(TopDownVertex),
+		VK_VERTEX_INPUT_RATE_VERTEX
+	};
+
+	const VkVertexInputAttributeDescription viads[] = {
+		{
+			0,
+			0,
+			VK_FORMAT_R32G32B32_SFLOAT,
+			offsetof(TopDownVertex, position)
+		},
+		{
+			1,
+			0,
+			VK_FORMAT_R32_SFLOAT,
+			offsetof(TopDownVertex, value)
+		},
+		{
+			2,
+			0,
+			VK_FORMAT_R32_SFLOAT,
+			offsetof(TopDownVertex, radius)
+		}
+	};
+
+	const VkPipelineVertexInputStateCreateInfo pvis {
+		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		1,
+		&vibd,
+		(sizeof viads) / (sizeof viads[0]),
+		viads
+	};
+
+	const VkPipelineInputAssemblyStateCreateInfo pias {
+		VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		points ? VK_PRIMITIVE_TOPOLOGY_POINT_LIST
+			: VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		VK_FALSE
+	};
+
+	const VkViewport viewport {
+		0.0,
+		0.0,
+		float(tile_size),
+		float(tile_size),
+		0.0,
+		1.0
+	};
+
+	const VkRect2D scissor = {
+		{0, 0},
+		{tile_size, tile_size}
+	};
+
+	const VkPipelineViewportStateCreateInfo pvs {
+		VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		1,
+		&viewport,
+		1,
+		&scissor
+	};
+
+	// Seen from above, surfaces facing down are still
+	// drawn, in case there is nothing over them.
+	const VkPipelineRasterizationStateCreateInfo prs {
+		VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		VK_FALSE,
+		VK_FALSE,
+		VK_POLYGON_MODE_FILL,
+		VK_CULL_MODE_NONE,
+		VK_FRONT_FACE_COUNTER_CLOCKWISE,
+		VK_FALSE,
+		0.0,
+		0.0,
+		0.0,
+		1.0
+	};
+
+	const VkPipelineMultisampleStateCreateInfo pms {
+		VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		VK_SAMPLE_COUNT_1_BIT,
+		VK_FALSE,
+		1.0,
+		nullptr,
+		VK_FALSE,
+		VK_FALSE
+	};
+
+	const VkPipelineDepthStencilStateCreateInfo pdss {
+		VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		VK_TRUE,
+		VK_TRUE,
+		VK_COMPARE_OP_LESS,
+		VK_FALSE,
+		VK_FALSE,
+		{},
+		{},
+		0.0,
+		1.0
+	};
+
+	const VkPipelineColorBlendAttachmentState value_blend {
+		VK_FALSE,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_FACTOR_ZERO,
+		VK_BLEND_OP_ADD,
+		VK_BLEND_FACTOR_ONE,
+		VK_BLEND_FACTOR_ZERO,
+		VK_BLEND_OP_ADD,
+		VK_COLOR_COMPONENT_R_BIT
+	};
+
+	const VkPipelineColorBlendStateCreateInfo pcbs {
+		VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		nullptr,
+		0,
+		VK_FALSE,
+		VK_LOGIC_OP_COPY,
+		1,
+		&value_blend,
+		{0.0f, 0.0f, 0.0f, 0.0f}
+	};
+
+	// The area of each tile is pushed before drawing it.
+	const VkPushConstantRange pcr {
+		VK_SHADER_STAGE_VERTEX_BIT,
+		0,
+		sizeof(TopDownTile)
+	};
+
+	UVkPipelineLayout playout{VkPipelineLayoutCreateInfo{
+		VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		nullptr,
+		0,
+		0,
+		nullptr,
+		1,
+		&pcr
+	}, device};
+
+	UVkGraphicsPipeline pipeline{VkGraphicsPipelineCreateInfo{
+		VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		nullptr,
+		0,
+		2,       // stageCount
+		pss,     // pStages
+		&pvis,   // pVertexInputState
+		&pias,   // pInputAssemblyState
+		nullptr, // pTessellationState
+		&pvs,    // pViewportState
+		&prs,    // pRasterizationState
+		&pms,    // pMultisampleState
+		&pdss,   // pDepthStencilState
+		&pcbs,   // pColorBlendState
+		nullptr, // pDynamicState
+		playout.get(), // layout
+		rpass.get(),   // renderPass
+		0,             // subpass
+		VK_NULL_HANDLE, // basePipelineHandle
+		-1              // basePipelineIndex
+	}, device, nullptr, 1};
+
+	UVkCommandBuffers cb{device, VkCommandBufferAllocateInfo{
+		VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		nullptr,
+		command_pool[0].get(),
+		VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		1
+	}};
+
+	const VkCommandBufferBeginInfo cbbi {
+		VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		nullptr,
+		VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		nullptr
+	};
+
+	const VkSubmitInfo si{
+		VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		nullptr,
+		0,
+		nullptr,
+		nullptr,
+		1,
+		&cb[0],
+		0,
+		nullptr
+	};
+
+	const VkMappedMemoryRange range {
+		VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		nullptr,
+		readback.mem.get(),
+		0,
+		VK_WHOLE_SIZE
+	};
+
+	VkClearValue cv[2];
+	cv[0].color.float32[0] = nodata;
+	cv[1].depthStencil = {1.0, 0};
+
+	std::vector<float> ret(size_t(grid.cols) * grid.rows);
+	MemMapper map{device, readback.mem.get()};
+	const float* tile_values = map.get<const float*>();
+
+	for(uint32_t row0 = 0; row0 < grid.rows; row0 += tile_size) {
+		for(uint32_t col0 = 0; col0 < grid.cols; col0 += tile_size) {
+			const uint32_t w = std::min(tile_size, grid.cols - col0);
+			const uint32_t h = std::min(tile_size, grid.rows - row0);
+
+			const TopDownTile tile {
+				{
+					grid.west + col0 * grid.cell_size,
+					grid.north + row0 * grid.cell_size
+				},
+				Vec2{tile_size * grid.cell_size},
+				top,
+				depth_scale,
+				grid.cell_size
+			};
+
+			chk_vk(vkBeginCommandBuffer(cb[0], &cbbi));
+
+			const VkRenderPassBeginInfo rpbi {
+				VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				nullptr,
+				rpass.get(),
+				fb.get(),
+				{
+					{0, 0},
+					{tile_size, tile_size}
+				},
+				2,
+				cv
+			};
+			vkCmdBeginRenderPass(cb[0], &rpbi,
+				VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(cb[0],
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipeline.get());
+			vkCmdPushConstants(cb[0], playout.get(),
+				VK_SHADER_STAGE_VERTEX_BIT, 0,
+				sizeof tile, &tile);
+
+			const VkDeviceSize zero_offset = 0;
+			vkCmdBindVertexBuffers(cb[0], 0, 1,
+				&vertex_buf.buf.get(), &zero_offset);
+			if(index_buf) {
+				vkCmdBindIndexBuffer(cb[0],
+					index_buf->buf.get(), 0,
+					VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(cb[0], mesh.indices.size(),
+					1, 0, 0, 0);
+			} else {
+				vkCmdDraw(cb[0], num_vertices, 1, 0, 0);
+			}
+			vkCmdEndRenderPass(cb[0]);
+
+			// Only the part of the tile inside the grid.
+			const VkBufferImageCopy region {
+				0, // bufferOffset
+				0, // bufferRowLength
+				0, // bufferImageHeight
+				{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+				{0, 0, 0},
+				{w, h, 1}
+			};
+			vkCmdCopyImageToBuffer(cb[0], value_image.get(),
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				readback.buf.get(), 1, &region);
+
+			const VkBufferMemoryBarrier bmb {
+				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				nullptr,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_HOST_READ_BIT,
+				VK_QUEUE_FAMILY_IGNORED,
+				VK_QUEUE_FAMILY_IGNORED,
+				readback.buf.get(),
+				0,
+				VK_WHOLE_SIZE
+			};
+			vkCmdPipelineBarrier(cb[0],
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_HOST_BIT,
+				0, 0, nullptr, 1, &bmb, 0, nullptr);
+
+			chk_vk(vkEndCommandBuffer(cb[0]));
+			chk_vk(vkQueueSubmit(queue, 1, &si, nullptr));
+			chk_vk(vkQueueWaitIdle(queue));
+			chk_vk(vkInvalidateMappedMemoryRanges(device,
+				1, &range));
+
+			for(uint32_t r = 0; r < h; ++r) {
+				std::copy(tile_values + size_t(r) * w,
+					tile_values + size_t(r + 1) * w,
+					ret.begin() + size_t(row0 + r)
+						* grid.cols + col0);
+			}
+		}
+	}
+
+	return ret;
+}
@@ -9,20 +9,65 @@
 #include "vk_manager.hpp"
 #include "mesh_tools.hpp"
 #include "buffer.hpp"
+#include "electrical.hpp"
 
 extern "C" {
 #include "sun_position.h"
 }
 
-struct MeshBuffers
+struct SceneBuffers
 {
-	MeshBuffers(VkDevice device,
+	SceneBuffers(VkDevice device,
 		const VkPhysicalDeviceMemoryProperties& mem_props,
-		const Mesh& mesh,  BufferTransferer& btransf);
+		const Scene& scene,  BufferTransferer& btransf);
 
+	// Vertices of the unique geometry, also
+	// read by the compute shader.
 	AccessibleBuffer vertex;
-	AccessibleBuffer index;
-	uint32_t idx_count;
+
+	// Point clouds are not indexed.
+	std::unique_ptr<AccessibleBuffer> index;
+
+	// Transforms of the instances, also
+	// read by the compute shader.
+	AccessibleBuffer instance;
+
+	// Tracker groups the instances may belong to.
+	AccessibleBuffer tracker;
+
+	// Transmittance schedules of the vegetation groups.
+	AccessibleBuffer vegetation;
+
+	// One draw per unique mesh, with all its instances.
+	struct Draw
+	{
+		// Of indices, or of vertices for point clouds:
+		uint32_t first;
+		uint32_t count;
+
+		uint32_t first_instance;
+		uint32_t instance_count;
+	};
+	std::vector<Draw> draws;
+
+	// Draws of the instances that are vegetation.
+	std::vector<Draw> vegetation_draws;
+
+	// Rewrites the instance buffer. The scene must have
+	// the same instances, only placed differently.
+	void write_instances(const Scene& scene, BufferTransferer& btransf);
+};
+
+// Receivers of each substring and string, see electrical.hpp.
+struct StringBuffers
+{
+	StringBuffers(VkDevice device,
+		const VkPhysicalDeviceMemoryProperties& mem_props,
+		const StringLayout& layout, BufferTransferer& btransf);
+
+	AccessibleBuffer substring_receiver;
+	AccessibleBuffer substring;
+	AccessibleBuffer string;
 };
 
 class TaskSlot
@@ -31,18 +76,22 @@ public:
 	TaskSlot(VkDevice device,
 		const VkPhysicalDeviceMemoryProperties& mem_props,
 		uint32_t idx, uint32_t num_points,
-		VkQueue graphic_queue);
+		VkQueue graphic_queue, bool has_vegetation,
+		uint32_t num_strings, uint32_t frame_size);
 
 	void create_command_buffer(
 		const class ShadowProcessor& sp,
 		VkCommandPool command_pool,
-		VkBuffer test_set,
+		const SceneBuffers &scene,
+		VkBuffer receivers,
+		const StringBuffers &strings,
 		BufferTransferer &btransf);
 
 	void fill_command_buffer(const ShadowProcessor& sp,
-		const MeshBuffers &mesh);
+		const SceneBuffers &scene);
 
-	void compute_frame(const Vec3& sun_direction, const Vec3& denergy);
+	void compute_frame(const Vec3& sun_direction, const Vec3& denergy,
+		int month, int hour);
 
 	VkFence get_fence()
 	{
@@ -54,8 +103,19 @@ public:
 		return queue;
 	}
 
+	uint32_t get_queue_family() const
+	{
+		return qf_idx;
+	}
+
+	void clear_result(BufferTransferer& btransf, uint32_t count,
+		uint32_t num_strings);
+
 	void accumulate_result(BufferTransferer& btransf,
-		uint32_t count, Vec3* accum);
+		uint32_t count, Vec4* accum);
+
+	void accumulate_strings(BufferTransferer& btransf,
+		uint32_t num_strings, Vec2* accum, float* hourly);
 
 private:
 	uint32_t qf_idx;
@@ -70,24 +130,52 @@ private:
 
 	AccessibleBuffer result_buf;
 
+	// Irradiance of the current frame, reduced per string
+	// into the accumulated string energy, also by hour.
+	AccessibleBuffer irradiance_buf;
+	AccessibleBuffer string_energy_buf;
+	AccessibleBuffer string_hourly_buf;
+
 	VkDescriptorSet global_desc_set;
 
 	UVkImage depth_image;
 	UVkDeviceMemory depth_image_mem;
 	UVkImageView depth_image_view;
+	UVkImage opacity_image;
+	UVkDeviceMemory opacity_image_mem;
+	UVkImageView opacity_image_view;
 	UVkFramebuffer framebuffer;
 	VkDescriptorSet compute_desc_set;
+	VkDescriptorSet mismatch_desc_set;
 
 	UVkCommandBuffers cmd_bufs;
 	UVkFence frame_fence;
 };
 
+// Settings that only change how fast a device works, and how much
+// memory it takes, except for the frame size, which also changes the
+// resolution of the shadows. Their best values depend on the device,
+// see tuning.hpp.
+struct ProcessorTuning
+{
+	// Frames in flight per queue. Empirically, 5 seems to
+	// be the optimal number in a GeForce GTX 760.
+	uint32_t slots_per_queue = 5;
+
+	// Largest work group size to use, or 0 for the device limit.
+	uint32_t max_group_size = 0;
+
+	// Side of the shadow map, in pixels.
+	uint32_t frame_size = 2048;
+};
+
 // Optimizes the split of work groups
 // for a given total work size.
 struct WorkGroupSplit
 {
+	// The group size is at most max_group_size, if not 0.
 	WorkGroupSplit(const VkPhysicalDeviceLimits &dlimits,
-		uint32_t work_size);
+		uint32_t work_size, uint32_t max_group_size = 0);
 
 	// Size of the local group (only x dimension used):
 	uint32_t group_x_size;
@@ -96,6 +184,19 @@ struct WorkGroupSplit
 	uint32_t num_groups;
 };
 
+// Grid of square cells over the horizontal plane of the output
+// model, whose first row is the northernmost, as in HeightRaster.
+struct TopDownGrid
+{
+	// x and z of the north west corner.
+	real west;
+	real north;
+
+	real cell_size;
+	uint32_t cols;
+	uint32_t rows;
+};
+
 // If moved, the only valid operation is destruction.
 class ShadowProcessor
 {
@@ -106,8 +207,10 @@ public:
 		UVkDevice&& device,
 		std::vector<std::pair<uint32_t,
 			std::vector<VkQueue>>>&& queues,
-		const Mesh &mesh,
-		const std::vector<VertexData>& test_set);
+		const Scene &scene,
+		const std::vector<Receiver>& receivers,
+		const StringLayout& strings,
+		const ProcessorTuning& tuning = ProcessorTuning{});
 
 	ShadowProcessor(ShadowProcessor&& other) = default;
 	ShadowProcessor &operator=(ShadowProcessor&& other) = default;
@@ -124,8 +227,28 @@ public:
 		return device_name;
 	}
 
+	const VkPhysicalDeviceProperties& get_properties() const
+	{
+		return properties;
+	}
+
+	uint32_t get_frame_size() const
+	{
+		return frame_size;
+	}
+
+	// Task slots, over every queue.
+	size_t get_num_slots() const
+	{
+		return task_pool.size();
+	}
+
 	void process(const Vec3& suns_direction, const InstantaneousData& instant);
 
+	// Accounts for an instant where the sun is known to be
+	// occluded from every point, without rendering it.
+	void skip(const Vec3& suns_direction, const InstantaneousData& instant);
+
 	const Vec3& get_directional_sum() const
 	{
 		return directional_sum;
@@ -146,25 +269,79 @@ public:
 		return count;
 	}
 
-	void accumulate_result(Vec3 *accum);
+	// Adds, for each receiver, the lit directional energy vector
+	// in xyz, and its projection on the receiver's normal in w.
+	void accumulate_result(Vec4 *accum);
+
+	// Adds, for each string, the energy with mismatch in x, and the
+	// energy without it in y, both as the sum over the substrings.
+	// The energy with mismatch is also added to hourly, by string
+	// and then by hour of the year.
+	void accumulate_strings(Vec2 *accum, float *hourly);
+
+	// Replaces the instance transforms with the ones from the given
+	// scene, which must differ only on them, and clears the results,
+	// so that a new computation can start without recreating
+	// any of the device state.
+	void restart(const Scene& shadow_scene);
+
+	// Clears the results, keeping the scene as it is.
+	void clear();
+
+	// Device memory a processor takes, with one queue family:
+	// what is uploaded once, and what each task slot adds.
+	struct MemoryEstimate
+	{
+		uint64_t fixed;
+		uint64_t per_slot;
+	};
+	static MemoryEstimate estimate_memory(const Scene& shadow_scene,
+		size_t num_receivers, const StringLayout& strings,
+		uint32_t frame_size);
+
+	// Renders the mesh seen from above into the grid, with the value
+	// of each vertex interpolated over the triangles, or over the
+	// splats of a point cloud, keeping the highest surface in each
+	// cell. Cells where there is no surface are set to nodata.
+	std::vector<float> render_top_down(const Mesh& mesh, real scale,
+		const std::vector<float>& values, const TopDownGrid& grid,
+		float nodata);
 
 private:
 	friend class TaskSlot;
 
-	// Empirically, 5 seems to be the optimal number
-	// in a GeForce GTX 760. Maybe this number should
-	// be dynamically optimized between runs.
-	static const unsigned SLOTS_PER_QUEUE = 5;
-
 	std::string device_name;
+	VkPhysicalDeviceProperties properties;
+
+	uint32_t slots_per_queue;
+	uint32_t frame_size;
 
 	// Number of points to compute:
 	uint32_t num_points;
 
 	const WorkGroupSplit wsplit;
 
+	// Point clouds are rendered as splats instead of triangles.
+	bool point_cloud;
+	float max_point_size;
+
+	// For the top down rendering, done in tiles.
+	uint32_t max_image_size;
+
+	// Semi-transparent casters are drawn into an opacity map,
+	// in the same render pass. Also a specialization constant.
+	VkBool32 has_vegetation;
+
+	// Strings of panels whose mismatch is computed after every
+	// frame. has_strings is also a specialization constant.
+	uint32_t num_strings;
+	VkBool32 has_strings;
+
 	void create_render_pipeline();
 	void create_compute_pipeline();
+	void create_mismatch_pipeline();
+
+	Vec3 add_to_totals(const Vec3& sun, const InstantaneousData& instant);
 
 	UVkDevice d;
 	VkPhysicalDeviceMemoryProperties mem_props;
@@ -174,9 +351,12 @@ private:
 
 	// Graphics pipeline stuff:
 	UVkShaderModule vert_shader;
+	UVkShaderModule frag_shader;
 	UVkRenderPass render_pass;
 	UVkPipelineLayout graphic_pipeline_layout;
 	UVkGraphicsPipeline graphic_pipeline;
+	UVkShaderModule opacity_shader;
+	UVkGraphicsPipeline vegetation_pipeline;
 
 	// Compute pipeline stuff:
 	UVkShaderModule compute_shader;
@@ -185,9 +365,16 @@ private:
 	UVkPipelineLayout compute_pipeline_layout;
 	UVkComputePipeline compute_pipeline;
 
+	// Mismatch pipeline stuff:
+	UVkShaderModule mismatch_shader;
+	UVkDescriptorSetLayout mismatch_dset_layout;
+	UVkPipelineLayout mismatch_pipeline_layout;
+	UVkComputePipeline mismatch_pipeline;
+
 	// Const data, one per queue family:
-	std::vector<MeshBuffers> mesh;
-	std::vector<AccessibleBuffer> test_buffer;
+	std::vector<SceneBuffers> scene;
+	std::vector<AccessibleBuffer> receiver_buffer;
+	std::vector<StringBuffers> strings;
 
 	// Memory pools:
 	UVkDescriptorPool desc_pool;
@@ -196,6 +383,11 @@ private:
 	// maybe with SLI/Crossfire?)
 	std::vector<UVkCommandPool> command_pool;
 
+	// Queue family index, and the queue used
+	// for buffer transfers, one per queue family.
+	std::vector<uint32_t> family_index;
+	std::vector<VkQueue> transfer_queue;
+
 	std::vector<TaskSlot> task_pool;
 	std::queue<uint32_t> available_slots;
 	std::vector<VkFence> fence_set;
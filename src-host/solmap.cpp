@@ -0,0 +1,254 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/geometric.hpp>
+
+#include "solmap.h"
+#include "engine.hpp"
+#include "sun_seq.hpp"
+#include "culling.hpp"
+#include "electrical.hpp"
+#include "tuning.hpp"
+
+struct solmap
+{
+	UVkInstance vk;
+
+	// Normalized, as the processors expect it.
+	Scene scene;
+	real scale = 1.0;
+	size_t num_vertices = 0;
+
+	double latitude = 0.0;
+	double longitude = 0.0;
+	bool has_site = false;
+
+	// Valid while neither the mesh nor the site change.
+	ReceiverSelection selection;
+	std::vector<std::unique_ptr<ShadowProcessor>> ps;
+
+	PartialResult result;
+	bool has_result = false;
+
+	std::string error;
+};
+
+namespace {
+
+const Vec3 unit_north{0, 0, -1};
+const Vec3 unit_up{0, 1, 0};
+const Vec3 unit_east{1, 0, 0};
+
+// Convert from j/m² to kWh/m²
+const double j2kwh = 1.0 / 3600.0 / 1000.0;
+
+// Runs the function, turning exceptions into the error code.
+template<class F>
+int guarded(solmap *s, const F& func)
+{
+	try {
+		func();
+		return 0;
+	} catch(const std::exception& e) {
+		s->error = e.what();
+		if(!s->error.empty() && s->error.back() == '\n') {
+			s->error.pop_back();
+		}
+		return -1;
+	}
+}
+
+void require_result(const solmap *s)
+{
+	if(!s->has_result) {
+		throw std::runtime_error("Nothing was computed yet.\n");
+	}
+}
+
+}
+
+solmap *solmap_create(void)
+{
+	try {
+		auto s = std::make_unique<solmap>();
+		s->vk = initialize_vulkan();
+		return s.release();
+	} catch(const std::exception&) {
+		return nullptr;
+	}
+}
+
+void solmap_destroy(solmap *s)
+{
+	delete s;
+}
+
+const char *solmap_last_error(const solmap *s)
+{
+	return s->error.c_str();
+}
+
+int solmap_set_mesh(solmap *s, size_t num_vertices,
+	const float *positions, const float *normals,
+	size_t num_indices, const uint32_t *indices)
+{
+	return guarded(s, [&] {
+		if((num_vertices && (!positions || !normals))
+			|| (num_indices && !indices) || num_indices % 3)
+		{
+			throw std::runtime_error("Invalid mesh arrays.\n");
+		}
+
+		Mesh mesh;
+		mesh.vertices.reserve(num_vertices);
+		for(size_t i = 0; i < num_vertices; ++i) {
+			const float *p = positions + 3 * i;
+			const Vec3 n{normals[3 * i], normals[3 * i + 1],
+				normals[3 * i + 2]};
+
+			// Zero normals are kept, as they would become NaN.
+			const float len = glm::length(n);
+			mesh.vertices.emplace_back(Vec3{p[0], p[1], p[2]},
+				len > 0.0f ? n / len : Vec3{0.0f});
+		}
+
+		for(size_t i = 0; i < num_indices; ++i) {
+			if(indices[i] >= num_vertices) {
+				throw std::runtime_error(
+					"Index out of the vertices.\n");
+			}
+		}
+		mesh.indices.assign(indices, indices + num_indices);
+
+		real scale = 1.0;
+		Scene scene = make_scene(std::move(mesh),
+			Quat{1.0, 0.0, 0.0, 0.0}, scale);
+
+		s->scene = std::move(scene);
+		s->scale = scale;
+		s->num_vertices = num_vertices;
+		s->ps.clear();
+		s->has_result = false;
+	});
+}
+
+int solmap_set_site(solmap *s, double latitude, double longitude)
+{
+	return guarded(s, [&] {
+		if(latitude < -90.0 || latitude > 90.0
+			|| longitude < -180.0 || longitude > 180.0)
+		{
+			throw std::runtime_error("Invalid site.\n");
+		}
+
+		if(!s->has_site || latitude != s->latitude
+			|| longitude != s->longitude)
+		{
+			s->ps.clear();
+			s->has_result = false;
+		}
+		s->latitude = latitude;
+		s->longitude = longitude;
+		s->has_site = true;
+	});
+}
+
+int solmap_run(solmap *s)
+{
+	return guarded(s, [&] {
+		if(!s->num_vertices || !s->has_site) {
+			throw std::runtime_error("Mesh and site must be set.\n");
+		}
+
+		const auto suns = sun_table(s->latitude, s->longitude);
+
+		if(s->ps.empty()) {
+			std::vector<Vec3> sun_dirs;
+			for(const auto& val: suns) {
+				if(val.direct_power > 0.0) {
+					sun_dirs.push_back(to_vec(val.pos,
+						unit_north, unit_up, unit_east));
+				}
+			}
+
+			s->selection = select_receivers(s->scene, s->scale,
+				unit_up, RegionOfInterest{}, SunCone{sun_dirs});
+			if(s->selection.receivers.empty()) {
+				throw std::runtime_error(
+					"No receivers to compute.\n");
+			}
+
+			s->ps = create_procs_from_devices(s->vk.get(), s->scene,
+				s->selection.receivers, StringLayout{},
+				TuningProfile(default_tuning_profile())
+					.tuning_for(ProcessorTuning{}.frame_size));
+		} else {
+			for(auto& p: s->ps) {
+				p->clear();
+			}
+		}
+
+		PartialResult base;
+		base.latitude = s->latitude;
+		base.longitude = s->longitude;
+		base.num_suns = suns.size();
+		base.energy.resize(s->selection.indices.size(),
+			Vec4{0.0f, 0.0f, 0.0f, 0.0f});
+
+		s->has_result = false;
+		s->result = compute_from(base, suns,
+			unit_north, unit_up, unit_east, s->ps, nullptr, false,
+			0.0, suns.size(),
+			[](const PartialResult&) { return true; });
+		s->has_result = true;
+	});
+}
+
+int solmap_get_incidence(solmap *s, float *incidence)
+{
+	return guarded(s, [&] {
+		require_result(s);
+
+		const double diffuse = s->result.diffuse_sum * j2kwh;
+		std::fill(incidence, incidence + s->num_vertices,
+			float(diffuse));
+
+		const auto& indices = s->selection.indices;
+		for(size_t i = 0; i < indices.size(); ++i) {
+			incidence[indices[i]] = diffuse
+				+ s->result.energy[i].w * j2kwh;
+		}
+	});
+}
+
+int solmap_get_directional(solmap *s, float *directional)
+{
+	return guarded(s, [&] {
+		require_result(s);
+
+		std::fill(directional, directional + 4 * s->num_vertices,
+			0.0f);
+
+		const auto& indices = s->selection.indices;
+		for(size_t i = 0; i < indices.size(); ++i) {
+			const Vec4 e = s->result.energy[i] * float(j2kwh);
+			float *dst = directional + 4 * size_t(indices[i]);
+			for(uint8_t k = 0; k < 4; ++k) {
+				dst[k] = e[k];
+			}
+		}
+	});
+}
+
+int solmap_get_totals(solmap *s, double *diffuse, double *direct)
+{
+	return guarded(s, [&] {
+		require_result(s);
+
+		*diffuse = s->result.diffuse_sum * j2kwh;
+		*direct = glm::length(s->result.directional_sum) * j2kwh;
+	});
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C interface of libsolmap.so, for computing the yearly incidence on
+// a mesh given in memory. Functions returning int return 0 on success,
+// or -1 on failure, when solmap_last_error() tells why. Arrays are
+// owned by the caller, and are not referred to after the call returns.
+//
+// resources/pylib/solmap.py binds it to numpy arrays.
+
+typedef struct solmap solmap;
+
+// Creates the Vulkan instance. Returns null on failure.
+solmap *solmap_create(void);
+
+void solmap_destroy(solmap *s);
+
+// Message of the last failure.
+const char *solmap_last_error(const solmap *s);
+
+// Sets the mesh where to compute the incidence, in meters, with +y up,
+// -z north and +x east. Positions and normals have 3 floats per vertex,
+// and indices have 3 per triangle. Vertices with zero normals never
+// face the sun. Fails if an array is null or an index is out of range.
+int solmap_set_mesh(solmap *s, size_t num_vertices,
+	const float *positions, const float *normals,
+	size_t num_indices, const uint32_t *indices);
+
+// Sets the site, in degrees.
+int solmap_set_site(solmap *s, double latitude, double longitude);
+
+// Computes the incidence over a year. The mesh stays on the devices
+// until it or the site changes, so runs after the first are faster.
+int solmap_run(solmap *s);
+
+// The results of the last run, for each vertex of the mesh, in kWh/m².
+// incidence has 1 float per vertex, the total incidence. directional
+// has 4: the lit direct energy vector, and its projection on the normal.
+int solmap_get_incidence(solmap *s, float *incidence);
+int solmap_get_directional(solmap *s, float *directional);
+
+// The yearly diffuse energy, and the norm of the direct energy vector,
+// received by an unobstructed point, in kWh/m².
+int solmap_get_totals(solmap *s, double *diffuse, double *direct);
+
+#ifdef __cplusplus
+}
+#endif
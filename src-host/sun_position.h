@@ -12,6 +12,12 @@ typedef struct {
 	double coefficient;
 	double direct_power;
 	double indirect_power;
+
+	// From 1 to 12, in local calendar.
+	int month;
+
+	// Hour of the year, from 0 to 8759, in UTC.
+	int hour;
 } InstantaneousData;
 
 void *create_pos_over_year(
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 #include "float.hpp"
 extern "C" {
 #include "sun_position.h"
@@ -27,3 +32,101 @@ private:
 	void *poy;
 };
 
+
+// All the sun positions over the year, in order.
+inline std::vector<InstantaneousData>
+sun_table(real latitude, real longitude, real elevation=0, real max_dt=300)
+{
+	std::vector<InstantaneousData> ret;
+	ret.reserve(60000);
+
+	SunSequence ss{latitude, longitude, elevation, max_dt};
+	InstantaneousData val;
+	while(ss.next(val)) {
+		ret.push_back(val);
+	}
+
+	ret.shrink_to_fit();
+	return ret;
+}
+
+// The bits of v, of the given width, in reverse order.
+inline uint32_t reverse_bits(uint32_t v, unsigned bits)
+{
+	uint32_t ret = 0;
+	for(unsigned i = 0; i < bits; ++i) {
+		ret = (ret << 1) | (v & 1u);
+		v >>= 1;
+	}
+	return ret;
+}
+
+// Bits needed to count up to n.
+inline unsigned bit_width(size_t n)
+{
+	unsigned bits = 0;
+	while((size_t(1) << bits) < n) {
+		++bits;
+	}
+	return bits;
+}
+
+// The same sun positions, reordered so that any prefix is spread
+// over the whole year and over the hours of the day, and the sums
+// over a prefix are an estimate of the sums over everything.
+//
+// The samples are taken in rounds, one of each day per round, days
+// in bit reversed order. Within each day, samples are also taken in
+// bit reversed order, starting at an offset that goes around the
+// day by the golden ratio from one day to the next, so that the
+// first rounds don't all fall on the same time of the day.
+inline std::vector<InstantaneousData>
+stratified(const std::vector<InstantaneousData>& suns)
+{
+	// The samples are in order, so each day is a range.
+	std::vector<size_t> day_begin;
+	for(size_t i = 0; i < suns.size(); ++i) {
+		if(i == 0 || suns[i].hour / 24 != suns[i - 1].hour / 24) {
+			day_begin.push_back(i);
+		}
+	}
+	day_begin.push_back(suns.size());
+
+	struct Key
+	{
+		double round;
+		uint32_t day;
+		size_t idx;
+	};
+	std::vector<Key> keys;
+	keys.reserve(suns.size());
+
+	const size_t num_days = day_begin.size() - 1;
+	const unsigned day_bits = bit_width(num_days);
+	const double golden = 0.6180339887498949;
+	for(size_t d = 0; d < num_days; ++d) {
+		const size_t n = day_begin[d + 1] - day_begin[d];
+		const unsigned bits = bit_width(n);
+		const size_t offset = size_t(n * std::fmod(d * golden, 1.0));
+		for(size_t j = 0; j < n; ++j) {
+			const uint32_t rotated = uint32_t((j + n - offset) % n);
+			keys.push_back({
+				std::ldexp(double(reverse_bits(rotated, bits)),
+					-int(bits)),
+				reverse_bits(uint32_t(d), day_bits),
+				day_begin[d] + j
+			});
+		}
+	}
+
+	std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+		return a.round != b.round ? a.round < b.round : a.day < b.day;
+	});
+
+	std::vector<InstantaneousData> ret;
+	ret.reserve(suns.size());
+	for(const Key& k: keys) {
+		ret.push_back(suns[k.idx]);
+	}
+	return ret;
+}
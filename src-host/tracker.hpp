@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "float.hpp"
+
+// Group of instances that rotate to follow the sun, around their
+// origin. Rotations are computed on GPU for every sun position.
+struct TrackerGroup
+{
+	enum Type {
+		// Rotates around the axis, to face the sun as
+		// much as possible (e.g. horizontal N-S axis).
+		SINGLE_AXIS,
+
+		// Points the rest normal directly to the sun.
+		DUAL_AXIS
+	};
+	Type type;
+
+	// Instances whose names start with this belong to the group.
+	std::string prefix;
+
+	// Rotation axis of single axis trackers, in model frame.
+	Vec3 axis;
+
+	// Normal of the tracker at rest (i.e. at zero rotation). For single
+	// axis, it is up made perpendicular to the axis, otherwise it is up.
+	Vec3 rest_normal;
+
+	// Maximum rotation from rest, in radians.
+	real max_angle;
+
+	// Ground coverage ratio, i.e. collector width over the row spacing,
+	// for backtracking of single axis trackers. Disabled if 0.
+	real gcr = 0.0;
+};
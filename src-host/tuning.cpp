@@ -0,0 +1,339 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <glm/geometric.hpp>
+
+#include "tuning.hpp"
+#include "sun_seq.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Side of the synthetic terrain, in vertices.
+const uint32_t GRID_SIZE = 256;
+
+// Frames rendered before, and during, each measurement.
+const size_t WARMUP_FRAMES = 16;
+const size_t MEASURED_FRAMES = 128;
+
+const uint32_t SLOT_CANDIDATES[] = {1, 2, 3, 4, 5, 6, 8};
+const uint32_t GROUP_CANDIDATES[] = {32, 64, 128, 256, 512};
+
+// Rolling hills, so that there are shadows to render.
+Scene synthetic_scene(real& scale)
+{
+	Mesh mesh;
+	mesh.vertices.reserve(GRID_SIZE * GRID_SIZE);
+	for(uint32_t z = 0; z < GRID_SIZE; ++z) {
+		for(uint32_t x = 0; x < GRID_SIZE; ++x) {
+			const float a = 0.1f * x;
+			const float b = 0.07f * z;
+			const float y = 2.0f * std::sin(a) * std::cos(b);
+
+			// Minus the partial derivatives of y.
+			const float dx = -0.2f * std::cos(a) * std::cos(b);
+			const float dz = 0.14f * std::sin(a) * std::sin(b);
+
+			mesh.vertices.emplace_back(Vec3{float(x), y, float(z)},
+				glm::normalize(Vec3{dx, 1.0f, dz}));
+		}
+	}
+
+	mesh.indices.reserve(6 * (GRID_SIZE - 1) * (GRID_SIZE - 1));
+	for(uint32_t z = 0; z + 1 < GRID_SIZE; ++z) {
+		for(uint32_t x = 0; x + 1 < GRID_SIZE; ++x) {
+			const uint32_t i = z * GRID_SIZE + x;
+			const uint32_t quad[] = {
+				i, i + GRID_SIZE, i + 1,
+				i + 1, i + GRID_SIZE, i + GRID_SIZE + 1
+			};
+			mesh.indices.insert(mesh.indices.end(),
+				std::begin(quad), std::end(quad));
+		}
+	}
+
+	return make_scene(std::move(mesh), Quat{1.0, 0.0, 0.0, 0.0}, scale);
+}
+
+// Seconds per frame of the processor, waiting for every frame.
+double measure(ShadowProcessor& p, const std::vector<InstantaneousData>& suns,
+	const std::vector<Vec3>& dirs, Vec4* accum)
+{
+	size_t i = 0;
+	for(; i < WARMUP_FRAMES; ++i) {
+		p.process(dirs[i], suns[i]);
+	}
+	p.accumulate_result(accum);
+
+	const auto start = std::chrono::steady_clock::now();
+	for(; i < suns.size(); ++i) {
+		p.process(dirs[i], suns[i]);
+	}
+	p.accumulate_result(accum);
+
+	return std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count()
+		/ (suns.size() - WARMUP_FRAMES);
+}
+
+bool same_device(const VkPhysicalDeviceProperties& a,
+	const VkPhysicalDeviceProperties& b)
+{
+	return a.vendorID == b.vendorID && a.deviceID == b.deviceID
+		&& a.driverVersion == b.driverVersion
+		&& std::string(a.deviceName) == b.deviceName;
+}
+
+}
+
+TuningProfile::TuningProfile(std::string fname):
+	fname{std::move(fname)}
+{
+	// Lines that can't be read are ignored, so
+	// that the profile never fails a run.
+	std::ifstream in(this->fname);
+	std::string line;
+	while(std::getline(in, line)) {
+		if(line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		std::istringstream ss(line);
+		Entry e;
+		if(ss >> e.vendor_id >> e.device_id >> e.driver_version
+			>> e.tuning.frame_size >> e.tuning.slots_per_queue
+			>> e.tuning.max_group_size >> e.frame_seconds
+			>> std::quoted(e.name))
+		{
+			entries.push_back(e);
+		}
+	}
+}
+
+const TuningProfile::Entry*
+TuningProfile::find_entry(const VkPhysicalDeviceProperties& props,
+	uint32_t frame_size) const
+{
+	for(const auto& e: entries) {
+		if(e.vendor_id == props.vendorID
+			&& e.device_id == props.deviceID
+			&& e.driver_version == props.driverVersion
+			&& e.name == props.deviceName
+			&& e.tuning.frame_size == frame_size)
+		{
+			return &e;
+		}
+	}
+	return nullptr;
+}
+
+ProcessorTuning TuningProfile::find(const VkPhysicalDeviceProperties& props,
+	uint32_t frame_size) const
+{
+	if(const Entry* e = find_entry(props, frame_size)) {
+		return e->tuning;
+	}
+
+	ProcessorTuning t;
+	t.frame_size = frame_size;
+	return t;
+}
+
+double TuningProfile::frame_seconds(const VkPhysicalDeviceProperties& props,
+	uint32_t frame_size) const
+{
+	const Entry* e = find_entry(props, frame_size);
+	return e ? e->frame_seconds : 0.0;
+}
+
+void TuningProfile::set(const VkPhysicalDeviceProperties& props,
+	const ProcessorTuning& tuning, double frame_seconds)
+{
+	const Entry e{props.vendorID, props.deviceID, props.driverVersion,
+		tuning, frame_seconds, props.deviceName};
+
+	if(const Entry* old = find_entry(props, tuning.frame_size)) {
+		entries[old - entries.data()] = e;
+	} else {
+		entries.push_back(e);
+	}
+}
+
+void TuningProfile::save() const
+{
+	std::error_code ec;
+	fs::create_directories(fs::path(fname).parent_path(), ec);
+
+	std::ofstream out(fname);
+	out << "# vendor device driver frame_size slots_per_queue "
+		"max_group_size seconds_per_frame name\n";
+	for(const auto& e: entries) {
+		out << e.vendor_id << ' ' << e.device_id << ' '
+			<< e.driver_version << ' ' << e.tuning.frame_size << ' '
+			<< e.tuning.slots_per_queue << ' '
+			<< e.tuning.max_group_size << ' '
+			<< std::setprecision(6) << e.frame_seconds << ' '
+			<< std::quoted(e.name) << '\n';
+	}
+
+	if(!out) {
+		throw std::runtime_error(
+			"Could not write tuning profile \"" + fname + "\".\n"
+		);
+	}
+}
+
+TuningFor TuningProfile::tuning_for(uint32_t frame_size) const
+{
+	const TuningProfile profile = *this;
+	return [profile, frame_size](const VkPhysicalDeviceProperties& props) {
+		return profile.find(props, frame_size);
+	};
+}
+
+std::string default_tuning_profile()
+{
+	if(const char* xdg = std::getenv("XDG_CONFIG_HOME")) {
+		return std::string(xdg) + "/solmap/tuning";
+	}
+	if(const char* home = std::getenv("HOME")) {
+		return std::string(home) + "/.config/solmap/tuning";
+	}
+	return "solmap.tuning";
+}
+
+void autotune(VkInstance vk, uint32_t frame_size, TuningProfile& profile)
+{
+	real scale = 1.0;
+	const Scene scene = synthetic_scene(scale);
+
+	std::vector<Receiver> receivers;
+	receivers.reserve(scene.geometry.vertices.size());
+	for(uint32_t v = 0; v < scene.geometry.vertices.size(); ++v) {
+		receivers.push_back({v, 0});
+	}
+
+	// Daytime samples, spread over the year.
+	const Vec3 unit_north{0, 0, -1};
+	const Vec3 unit_up{0, 1, 0};
+	const Vec3 unit_east{1, 0, 0};
+	std::vector<InstantaneousData> suns;
+	std::vector<Vec3> dirs;
+	for(const auto& val: stratified(sun_table(45.0, 0.0))) {
+		if(suns.size() == WARMUP_FRAMES + MEASURED_FRAMES) {
+			break;
+		}
+		if(val.direct_power > 0.0) {
+			suns.push_back(val);
+			dirs.push_back(to_vec(val.pos,
+				unit_north, unit_up, unit_east));
+		}
+	}
+	std::vector<Vec4> accum(receivers.size());
+
+	struct Best
+	{
+		VkPhysicalDeviceProperties props;
+		ProcessorTuning tuning;
+		double seconds;
+	};
+	std::vector<Best> best;
+
+	auto find_best = [&](const VkPhysicalDeviceProperties& props) {
+		for(auto& b: best) {
+			if(same_device(b.props, props)) {
+				return &b;
+			}
+		}
+		return static_cast<Best*>(nullptr);
+	};
+
+	// Measures every device with the tuning given by the candidate,
+	// from its best so far, if any, and keeps it if faster.
+	auto try_candidate = [&](
+		const std::function<ProcessorTuning(const Best*)>& candidate)
+	{
+		std::vector<std::unique_ptr<ShadowProcessor>> ps;
+		try {
+			ps = create_procs_from_devices(vk, scene, receivers,
+				StringLayout{},
+				[&](const VkPhysicalDeviceProperties& props) {
+					return candidate(find_best(props));
+				});
+		} catch(const std::runtime_error&) {
+			// No device can take this candidate.
+			return;
+		}
+
+		for(auto& p: ps) {
+			const auto& props = p->get_properties();
+			const ProcessorTuning t = candidate(find_best(props));
+			const double s = measure(*p, suns, dirs, accum.data());
+
+			std::cout << " - " << p->get_name() << ": "
+				<< t.slots_per_queue << " slots, work groups of "
+				<< (t.max_group_size
+					? std::to_string(t.max_group_size)
+					: std::string("up to the limit"))
+				<< ": " << s * 1000.0 << " ms/frame" << std::endl;
+
+			Best* b = find_best(props);
+			if(!b) {
+				best.push_back({props, t, s});
+			} else if(s < b->seconds) {
+				b->tuning = t;
+				b->seconds = s;
+			}
+		}
+	};
+
+	// Each parameter is optimized in turn, the work
+	// group size with the best number of slots.
+	std::cout << "Tuning frames in flight, with frames of "
+		<< frame_size << " pixels:" << std::endl;
+	for(uint32_t slots: SLOT_CANDIDATES) {
+		try_candidate([=](const Best*) {
+			ProcessorTuning t;
+			t.slots_per_queue = slots;
+			t.frame_size = frame_size;
+			return t;
+		});
+	}
+
+	std::cout << "Tuning work group size:" << std::endl;
+	for(uint32_t group: GROUP_CANDIDATES) {
+		try_candidate([=](const Best* b) {
+			ProcessorTuning t;
+			if(b) {
+				t = b->tuning;
+			}
+			t.max_group_size = group;
+			t.frame_size = frame_size;
+			return t;
+		});
+	}
+
+	if(best.empty()) {
+		throw std::runtime_error("No device could be tuned.\n");
+	}
+
+	std::cout << "Best tuning:\n";
+	for(const auto& b: best) {
+		profile.set(b.props, b.tuning, b.seconds);
+		std::cout << " - " << b.props.deviceName << ": "
+			<< b.tuning.slots_per_queue << " slots, work groups of "
+			<< (b.tuning.max_group_size
+				? std::to_string(b.tuning.max_group_size)
+				: std::string("up to the limit"))
+			<< ": " << b.seconds * 1000.0 << " ms/frame\n";
+	}
+	std::cout.flush();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "engine.hpp"
+
+// Best tuning found for each device, driver version and frame size, as
+// measured by autotune(), kept in a text file with one line for each.
+// Devices not in the profile use the default tuning.
+class TuningProfile
+{
+public:
+	// Loads the profile from the file, if it exists.
+	explicit TuningProfile(std::string fname);
+
+	// Tuning of the device, for the given frame size.
+	ProcessorTuning find(const VkPhysicalDeviceProperties& props,
+		uint32_t frame_size) const;
+
+	// Seconds per frame measured with the tuning of the
+	// device, for the given frame size, or 0 if not tuned.
+	double frame_seconds(const VkPhysicalDeviceProperties& props,
+		uint32_t frame_size) const;
+
+	// Adds or replaces the tuning of the device, for its frame size.
+	void set(const VkPhysicalDeviceProperties& props,
+		const ProcessorTuning& tuning, double frame_seconds);
+
+	// Also creates the directory, if needed.
+	void save() const;
+
+	// Tuning of each device in this profile, for the given frame size.
+	TuningFor tuning_for(uint32_t frame_size) const;
+
+private:
+	struct Entry
+	{
+		uint32_t vendor_id;
+		uint32_t device_id;
+		uint32_t driver_version;
+		ProcessorTuning tuning;
+		double frame_seconds;
+		std::string name;
+	};
+
+	const Entry* find_entry(const VkPhysicalDeviceProperties& props,
+		uint32_t frame_size) const;
+
+	std::string fname;
+	std::vector<Entry> entries;
+};
+
+// Default location, following the XDG base directories.
+std::string default_tuning_profile();
+
+// Benchmarks each device with short runs over a synthetic scene, for each
+// candidate number of frames in flight and work group size, with the given
+// frame size, and keeps the fastest of each device in the profile.
+void autotune(VkInstance vk, uint32_t frame_size, TuningProfile& profile);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "float.hpp"
+
+// Group of instances that cast partial shadows, like tree crowns,
+// whose transmittance changes over the year. The meshes are expected
+// to be closed, so that a ray through the crown crosses two surfaces.
+struct VegetationGroup
+{
+	// Instances whose names start with this belong to the group.
+	std::string prefix;
+
+	// Fraction of the direct light crossing the crown,
+	// for each month, starting from January.
+	std::array<real, 12> transmittance;
+};
@@ -0,0 +1,234 @@
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <glm/geometric.hpp>
+
+#include "vtk_writer.hpp"
+
+namespace {
+
+// Elements encoded at a time by a thread.
+const size_t RANGE_SIZE = 1 << 16;
+
+// Legacy VTK binary data is big endian.
+inline void put_be(char* dst, uint32_t v)
+{
+	v = __builtin_bswap32(v);
+	std::memcpy(dst, &v, sizeof v);
+}
+
+inline void put_be(char* dst, float f)
+{
+	uint32_t v;
+	std::memcpy(&v, &f, sizeof v);
+	put_be(dst, v);
+}
+
+// Part of the file: either text, or a binary array of elements
+// with a fixed encoded size, encoded by ranges of elements.
+struct Piece
+{
+	std::string text;
+
+	size_t count = 0;
+	size_t elem_size = 0;
+	std::function<void(char* dst, size_t begin, size_t end)> encode;
+
+	size_t size() const
+	{
+		return text.size() + count * elem_size;
+	}
+};
+
+Piece text(std::string t)
+{
+	Piece p;
+	p.text = std::move(t);
+	return p;
+}
+
+Piece binary(size_t count, size_t elem_size,
+	std::function<void(char*, size_t, size_t)> encode)
+{
+	Piece p;
+	p.count = count;
+	p.elem_size = elem_size;
+	p.encode = std::move(encode);
+	return p;
+}
+
+}
+
+void write_vtk(const std::string& fname, const Mesh& mesh, real scale,
+	double dif_total, double dir_total, const Vec4* directional,
+	unsigned num_threads)
+{
+	const size_t num_vertices = mesh.vertices.size();
+	const size_t face_count = mesh.indices.size() / 3;
+
+	std::vector<Piece> pieces;
+
+	pieces.push_back(text("# vtk DataFile Version 3.0\n"
+		"Daylight solar incidence\n"
+		"BINARY\n"
+		"DATASET POLYDATA\n"
+		"POINTS " + std::to_string(num_vertices) + " float\n"));
+	pieces.push_back(binary(num_vertices, 3 * sizeof(float),
+		[&](char* dst, size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i, dst += 12) {
+				const Vec3 pos = scale * mesh.vertices[i].position;
+				put_be(dst, pos.x);
+				put_be(dst + 4, pos.y);
+				put_be(dst + 8, pos.z);
+			}
+		}
+	));
+
+	if(mesh.is_point_cloud()) {
+		pieces.push_back(text("\nVERTICES "
+			+ std::to_string(num_vertices) + ' '
+			+ std::to_string(num_vertices * 2) + '\n'));
+		pieces.push_back(binary(num_vertices, 2 * sizeof(uint32_t),
+			[&](char* dst, size_t begin, size_t end) {
+				for(size_t i = begin; i < end; ++i, dst += 8) {
+					put_be(dst, uint32_t(1));
+					put_be(dst + 4, uint32_t(i));
+				}
+			}
+		));
+	}
+
+	pieces.push_back(text("\nPOLYGONS " + std::to_string(face_count)
+		+ ' ' + std::to_string(face_count * 4) + '\n'));
+	pieces.push_back(binary(face_count, 4 * sizeof(uint32_t),
+		[&](char* dst, size_t begin, size_t end) {
+			const uint32_t* idx = &mesh.indices[begin * 3];
+			for(size_t i = begin; i < end; ++i, dst += 16) {
+				put_be(dst, uint32_t(3));
+				for(uint8_t j = 0; j < 3; ++j) {
+					put_be(dst + 4 * (j + 1), *idx++);
+				}
+			}
+		}
+	));
+
+	pieces.push_back(text("\nPOINT_DATA " + std::to_string(num_vertices)
+		+ "\nSCALARS incidence float 1\n"
+		"LOOKUP_TABLE default\n"));
+	pieces.push_back(binary(num_vertices, sizeof(float),
+		[&](char* dst, size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i, dst += 4) {
+				put_be(dst, float(dif_total + directional[i].w));
+			}
+		}
+	));
+
+	pieces.push_back(text("\nVECTORS directional_incidence float\n"));
+	pieces.push_back(binary(num_vertices, 3 * sizeof(float),
+		[&](char* dst, size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i, dst += 12) {
+				put_be(dst, directional[i].x);
+				put_be(dst + 4, directional[i].y);
+				put_be(dst + 8, directional[i].z);
+			}
+		}
+	));
+
+	pieces.push_back(text("\nSCALARS shadow_percentage float 1\n"
+		"LOOKUP_TABLE default\n"));
+	pieces.push_back(binary(num_vertices, sizeof(float),
+		[&](char* dst, size_t begin, size_t end) {
+			for(size_t i = begin; i < end; ++i, dst += 4) {
+				const double result = (1.0 - glm::length(
+					Vec3{directional[i]}) / dir_total) * 100.0;
+
+				// Assert the values are within reasonable ranges,
+				// but give leeway for floating point errors.
+				assert(result >= -1.0);
+				assert(result <= 101.0);
+
+				put_be(dst, float(result));
+			}
+		}
+	));
+	pieces.push_back(text("\n"));
+
+	size_t total = 0;
+	for(const Piece& p: pieces) {
+		total += p.size();
+	}
+
+	const int fd = open(fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		throw std::runtime_error(
+			"Could not open output file \"" + fname + "\".\n"
+		);
+	}
+
+	// The blocks are allocated now, so that a full disk fails here,
+	// instead of raising SIGBUS while writing through the mapping.
+	if(posix_fallocate(fd, 0, total) != 0) {
+		close(fd);
+		throw std::runtime_error(
+			"Could not write output file \"" + fname + "\".\n"
+		);
+	}
+
+	void* map = mmap(nullptr, total, PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		throw std::runtime_error(
+			"Could not map output file \"" + fname + "\".\n"
+		);
+	}
+
+	// The text is copied as it goes, and the binary arrays are split
+	// in ranges of elements, taken by the threads in order.
+	struct Range
+	{
+		const Piece* piece;
+		char* dst;
+		size_t begin, end;
+	};
+	std::vector<Range> ranges;
+
+	char* out = static_cast<char*>(map);
+	for(const Piece& p: pieces) {
+		std::memcpy(out, p.text.data(), p.text.size());
+		out += p.text.size();
+
+		for(size_t begin = 0; begin < p.count; begin += RANGE_SIZE) {
+			ranges.push_back({&p, out + begin * p.elem_size, begin,
+				std::min(p.count, begin + RANGE_SIZE)});
+		}
+		out += p.count * p.elem_size;
+	}
+
+	std::atomic<size_t> next{0};
+	std::vector<std::thread> workers;
+	num_threads = std::max(1u, num_threads);
+	for(unsigned t = 0; t < num_threads; ++t) {
+		workers.emplace_back([&] {
+			for(size_t r; (r = next++) < ranges.size();) {
+				const Range& rg = ranges[r];
+				rg.piece->encode(rg.dst, rg.begin, rg.end);
+			}
+		});
+	}
+
+	for(auto& w: workers) {
+		w.join();
+	}
+
+	munmap(map, total);
+}
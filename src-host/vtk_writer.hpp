@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include "float.hpp"
+#include "mesh_tools.hpp"
+
+// Writes the mesh and its incidence in the legacy VTK format, binary
+// encoded. The file is sized upfront and mapped in memory, so that the
+// sections are encoded directly into it by the given number of threads.
+//
+// Directional incidence has the lit energy vector in xyz, and
+// its projection on the normal of the point in w. Points that were
+// not computed have it zero, so they are written as always in shadow.
+void write_vtk(const std::string& fname, const Mesh& mesh, real scale,
+	double dif_total, double dir_total, const Vec4* directional,
+	unsigned num_threads);
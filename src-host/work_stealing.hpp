@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstddef>
+
+// Hands out the indices [0, size) in chunks to a fixed set of workers.
+// Each worker starts with an even share of the indices, taken in chunks
+// from its front. Once done, it steals the back half of what is left to
+// the worker with the most left, so faster workers end up taking more.
+class WorkStealingRanges
+{
+public:
+	WorkStealingRanges(size_t size, size_t num_workers, size_t chunk):
+		ranges(std::max(size_t(1), num_workers)),
+		chunk{std::max(size_t(1), chunk)}
+	{
+		const size_t share = size / ranges.size();
+		const size_t extra = size % ranges.size();
+		size_t begin = 0;
+		for(size_t i = 0; i < ranges.size(); ++i) {
+			ranges[i].begin = begin;
+			begin += share + (i < extra);
+			ranges[i].end = begin;
+		}
+	}
+
+	// Gets the next chunk [begin, end) of the worker. Returns
+	// false once there is nothing left to any worker.
+	bool next(size_t worker, size_t& begin, size_t& end)
+	{
+		Range& own = ranges[worker];
+		for(;;) {
+			{
+				std::lock_guard<std::mutex> lock(own.m);
+				if(own.begin < own.end) {
+					begin = own.begin;
+					end = std::min(own.end, own.begin + chunk);
+					own.begin = end;
+					return true;
+				}
+			}
+
+			if(!steal(worker)) {
+				return false;
+			}
+		}
+	}
+
+private:
+	// Each in its own cache line, as each is mostly
+	// used by a single worker.
+	struct alignas(64) Range
+	{
+		std::mutex m;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+
+	// Returns false if there is nothing left to steal.
+	bool steal(size_t worker)
+	{
+		size_t victim = worker;
+		size_t most = 0;
+		for(size_t i = 0; i < ranges.size(); ++i) {
+			if(i == worker) {
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(ranges[i].m);
+			const size_t left = ranges[i].end - ranges[i].begin;
+			if(left > most) {
+				most = left;
+				victim = i;
+			}
+		}
+		if(victim == worker) {
+			return false;
+		}
+
+		// The victim may have taken some meanwhile,
+		// but it still has a valid range.
+		size_t begin, end;
+		{
+			Range& v = ranges[victim];
+			std::lock_guard<std::mutex> lock(v.m);
+			begin = v.begin + (v.end - v.begin) / 2;
+			end = v.end;
+			v.end = begin;
+		}
+
+		Range& own = ranges[worker];
+		std::lock_guard<std::mutex> lock(own.m);
+		own.begin = begin;
+		own.end = end;
+		return true;
+	}
+
+	std::vector<Range> ranges;
+	size_t chunk;
+};